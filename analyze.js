@@ -4,7 +4,6 @@ var fs = require("fs");
 
 // {{{ config
 var WAIT_SECONDS = 7; // for jobs to complete
-var KEEP_CLOSEST = 100; // nodes
 var RANDOM_ARTICLES = 0; // Randomly sample X nodes, put 0 for all nodes
 var RANDOM_CATEGORIES = 0; // Randomly sample X nodes, put 0 for all nodes
 // }}}
@@ -147,14 +146,15 @@ function GraphInfo(type) {
   this.num_nodes = 0;
   this.num_links = 0;
   this.largest_scc = 0;  // cut-off point for closeness calculation
+  this.diameter = null;  // of the largest scc, {diameter, size, bfs}
+  this.hubs = [];  // [score, node, name]
+  this.authorities = [];
   this.nodes_done = 0;
   this.nodes_done_proper = 0; // without error
   this.sample_size = 0;
   this.reachable_sum = 0;
   this.distance_sum = 0;
-  this.closest = new Heap();
   this.onevent = {all_done:function(){}};
-  this.keep_closest = KEEP_CLOSEST;
   this.dist_spectrum = [];
   this.num_canreachscc = 0;
 }
@@ -174,6 +174,10 @@ GraphInfo.prototype.SetSCC = function(components) {
 GraphInfo.prototype.SetPageRanks = function(ranks) {
   this.pageranks = ranks;
 };
+GraphInfo.prototype.SetHits = function(hubs, authorities) {
+  this.hubs = hubs;
+  this.authorities = authorities;
+};
 GraphInfo.prototype.CalcAvgDistReachable = function(count_dist) {
   var distances = 0;
   var reachable = 0;
@@ -230,11 +234,8 @@ GraphInfo.prototype.AddNodeDist = function(node, count_dist) {
 
   // Only nodes that can reach largest SCC or more have right to be included
   // in computation of closeness centrality.
+  // Closest of them are found by the worker, see gen_centr_articles.
   if (obj.reachable + 1 >= this.largest_scc) {  // +1 is for node itself.
-    this.closest.insert(-obj.closeness, node);
-    if(this.closest.size() > this.keep_closest) {
-      this.closest.remove();
-    }
     this.num_canreachscc += 1;
   }
 
@@ -322,6 +323,30 @@ JobMonitor.prototype._job_pop = function(err, result) {
 };
 // }}}
 
+// {{{ class NameStore
+// Reads names.bin written by gen_graph, layout is:
+//  [titles][offset list: num_nodes+2 x uint32][num_bytes][num_nodes]
+function NameStore(file) {
+  this._buf = fs.readFileSync(file);
+  var len = this._buf.length;
+  this.num_nodes = this._uint32(len - 4);
+  var num_bytes = this._uint32(len - 8);
+  this._list = Math.ceil(num_bytes / 4) * 4;  // titles are padded
+}
+NameStore.prototype._uint32 = function(pos) {
+  var b = this._buf;
+  return (b[pos] | (b[pos+1] << 8) | (b[pos+2] << 16)) + b[pos+3] * 0x1000000;
+};
+NameStore.prototype.get = function(node) {
+  if (node < 1 || node > this.num_nodes) {
+    return null;
+  }
+  var start = this._uint32(this._list + 4 * node);
+  var end = this._uint32(this._list + 4 * (node + 1));
+  return this._buf.toString('utf8', start, end);
+};
+// }}}
+
 // {{{ interface ExtDb
 // Interface for external storage
 // function ExtDb() {}
@@ -338,6 +363,7 @@ function Controller(redis, redis_pubsub) {
   this.onevent = {};
   this.explore = false;
   this.extdb = null;
+  this.names = null;
 }
 Controller.prototype.on = function(name, cb) {
   this.onevent[name] = cb;
@@ -348,6 +374,9 @@ Controller.prototype.setExplore = function(explore) {
 Controller.prototype.setExtDb = function(db) {
   this.extdb = db;
 }
+Controller.prototype.setNames = function(names) {
+  this.names = names;
+};
 Controller.prototype._RunJob = function(job, callback) {
   var self = this;
   if (!self.explore) {
@@ -447,10 +476,18 @@ Controller.prototype.ResolveNames = function(total, cb_get_node, cb_set_name, cb
     cb_done();
   }
   var resolved = 0;
+  var names = this.names;
   // Resolve names of articles given list of nodes
   for (var i = 0; i < total; i++) {
     var node = cb_get_node(i);
-    this.redis.get("n:" + node, (function(){
+    var get_name = function(key, callback) {
+      // Local names.bin does not need redis
+      callback(null, names.get(parseInt(key.substr(2), 10)));
+    };
+    if (!names) {
+      get_name = this.redis.get.bind(this.redis);
+    }
+    get_name("n:" + node, (function(){
       var _i = i; 
       return function(err, name) {
         if (err) throw err;
@@ -728,6 +765,9 @@ function main(opts) {
   var data = new ReportData();
   var mutex = new Mutex(redis);
   var control = new Controller(redis, redis_pubsub);  // pubsub can't be mixed with regular ops
+  if (opts.names) {
+    control.setNames(new NameStore(opts.names));
+  }
   var monitor = new JobMonitor(redis, redis_block);  // blpop is blocking operation
 
   var init_mutex = function(callback) {
@@ -797,6 +837,20 @@ function main(opts) {
     });
   };
 
+  // Exact diameter of the largest component
+  monitor.waittime_job['aX'] = 300*1000;
+  monitor.waittime_job['cX'] = 300*1000;
+
+  var gen_compute_diameter = function(type, member_name) {
+    return function(callback) {
+      control.RunJob(type+'X', function(job, result) {
+        data[member_name].diameter = result;
+        console.log('Diameter complete.');
+        callback();
+      });
+    }
+  }
+
   // Get PageRanks
   monitor.waittime_job['aR'] = 150*1000;
   monitor.waittime_job['cR'] = 150*1000;
@@ -825,6 +879,30 @@ function main(opts) {
     }
   }
 
+  // Get hubs and authorities
+  monitor.waittime_job['aH'] = 150*1000;
+
+  /**
+   * @param type        'a' or 'c'
+   * @param member_name 'art' or 'cat'
+   */
+  var gen_compute_hits = function(type, member_name) {
+    return function(callback) {
+      control.RunJob(type+'H', function(job, result) {
+        var both = result.hubs.concat(result.authorities);
+        control.ResolveNames(both.length,
+          function get(i) { return both[i][1]; },
+          function set(i, name) { both[i][2] = name; },
+          function done() {
+            data[member_name].SetHits(result.hubs, result.authorities);
+            console.log('HITS complete.');
+            callback();
+          }
+        );
+      });
+    }
+  }
+
   /**
    * @param type         'a' or 'c'
    * @param member_name  'art' or 'cat'
@@ -909,31 +987,36 @@ function main(opts) {
     };
   }
 
+  // Exact closest nodes, worker prunes BFS of nodes which can not be
+  // among them
+  monitor.waittime_job['aT'] = 600*1000;
+  monitor.waittime_job['cT'] = 600*1000;
+
   var gen_centr_articles = function(type, member_name) {
     return function(callback) {
       var graph_info = data[member_name];
-      // Prepare article distance centers for report
-      var pos = graph_info.closest.size();
-      graph_info.close_centr = [];
-      while(pos) {
-        var heapnode = graph_info.closest.remove();
-        pos -= 1;
-        data.interesting_nodes.push({node:heapnode.value});
-        graph_info.close_centr[pos] = {
-          node:heapnode.value,
-          avg_dist: - heapnode.key
-        };
-      }
+      control.RunJob(type+'T', function(job, result) {
+        // Prepare article distance centers for report
+        graph_info.close_centr = [];
+        for (var i = 0; i < result.closeness.length; i++) {
+          var node = result.closeness[i][1];
+          data.interesting_nodes.push({node:node});
+          graph_info.close_centr[i] = {
+            node:node,
+            avg_dist:result.closeness[i][0]
+          };
+        }
 
-      control.ResolveNames(graph_info.close_centr.length,
-        function get(i) {
-          return graph_info.close_centr[i].node;
-        },
-        function set(i, name) {
-          graph_info.close_centr[i].name = name;
-        },
-        callback
-      );
+        control.ResolveNames(graph_info.close_centr.length,
+          function get(i) {
+            return graph_info.close_centr[i].node;
+          },
+          function set(i, name) {
+            graph_info.close_centr[i].name = name;
+          },
+          callback
+        );
+      });
     };
   };
 
@@ -1070,6 +1153,8 @@ function main(opts) {
       [init_monitor],
 
       [gen_compute_pageranks('a','art'), init_get_counts, init_compute_art_scc, init_compute_cat_scc],
+      [gen_compute_diameter('a','art'), gen_compute_diameter('c','cat')],
+      [gen_compute_hits('a','art')],
 
       [gen_compute_distances('a','art', RANDOM_ARTICLES)],
       [gen_compute_distances('c','cat', RANDOM_CATEGORIES)],
@@ -1249,6 +1334,10 @@ var opts = tav.set({
   aof: {
     node: 'Load results from redis AOF file',
     value: false
+  },
+  names: {
+    note: 'Resolve names from names.bin instead of redis',
+    value: false
   }
 });
 
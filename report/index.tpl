@@ -134,6 +134,26 @@
       </table>
     </div>
 
+    <h2>Article hubs and authorities</h2>
+
+    <p>
+      <a href="http://en.wikipedia.org/wiki/HITS_algorithm">HITS</a> gives each article two scores: good authorities are linked from good hubs, good hubs link to good authorities.
+    </p>
+
+    <table border="0" width="100%">
+      <tr><th width="50%">Hubs</th><th>Authorities</th></tr>
+    </table>
+    <div class="scrollbox" style="height:300px;">
+      <table width="100%" border="0">
+        <% for ( var i = 0; i != art.hubs.length; i++ ) { var h=art.hubs[i], a=art.authorities[i]; %>
+          <tr>
+            <td width="50%"><a href="<%=enwiki+h[2]%>"><%=h[2]%></a> (<%=(100*h[0]).toFixed(3)%>%)</td>
+            <td><a href="<%=enwiki+a[2]%>"><%=a[2]%></a> (<%=(100*a[0]).toFixed(3)%>%)</td>
+          </tr>
+        <% } %>
+      </table>
+    </div>
+
     <h2>Strongly connected components (AL)</h2>
 
     <table border="0" width="100%">
@@ -149,6 +169,13 @@
           <% } %>
       </table>
     </div>
+
+    <% if(art.diameter) { %>
+      <p>
+        Diameter of the largest component (<%=art.diameter.size%> articles) is exactly <%=art.diameter.diameter%>,
+        found with <%=art.diameter.bfs%> breadth-first searches.
+      </p>
+    <% } %>
     
     <p>
       Compared to reports from <a mirrorhref="2007.html" href="http://www.netsoc.tcd.ie/~mu/wiki/">2007</a>, now we see more a lot more of non-trivial small components.
@@ -278,6 +305,13 @@
       </table>
     </div>
 
+    <% if(cat.diameter) { %>
+      <p>
+        Diameter of the largest component (<%=cat.diameter.size%> nodes) is exactly <%=cat.diameter.diameter%>,
+        found with <%=cat.diameter.bfs%> breadth-first searches.
+      </p>
+    <% } %>
+
     <p>
       These results are a bit distorted, since
       <a href="http://en.wikipedia.org/wiki/Category:Hidden_categories">hidden categories</a>
@@ -0,0 +1,262 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_AGGREGATE_H_
+#define SRC_AGGREGATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+
+#include "wikigraph_stubs_internal.h"
+#include "file_io.h"
+#include "parallel.h"
+#include "result_builder.h"
+
+namespace wikigraph {
+
+// Receives records read from files with results of workers
+class ResultVisitor {
+ public:
+  virtual ~ResultVisitor() { }
+  // Redis key and value, results of jobs have keys result:<job>
+  virtual void Set(const string &key, const string &value) = 0;
+};
+
+// Bytes of a file, read in large blocks
+class ByteReader {
+ public:
+  explicit ByteReader(File *file)
+  : file_(file), buffer_(kBufferSize), pos_(0), size_(0) { }
+
+  bool Peek(char *c) {
+    if (pos_ == size_ && !Fill())
+      return false;
+    *c = buffer_[pos_];
+    return true;
+  }
+
+  // Bytes up to delimiter, which is skipped
+  bool ReadUntil(char delimiter, string *out) {
+    out->clear();
+    while (true) {
+      if (pos_ == size_ && !Fill())
+        return false;
+      const char *start = &buffer_[pos_];
+      const char *found = static_cast<const char *>(
+          memchr(start, delimiter, size_ - pos_));
+      size_t length = found ? found - start : size_ - pos_;
+      out->append(start, length);
+      pos_ += length;
+      if (found) {
+        pos_++;
+        return true;
+      }
+    }
+  }
+
+  bool Read(size_t length, string *out) {
+    out->clear();
+    while (out->size() < length) {
+      if (pos_ == size_ && !Fill())
+        return false;
+      size_t part = std::min(length - out->size(), size_ - pos_);
+      out->append(&buffer_[pos_], part);
+      pos_ += part;
+    }
+    return true;
+  }
+
+ private:
+  static const size_t kBufferSize = 1 << 20;
+
+  bool Fill() {
+    pos_ = 0;
+    size_ = file_->read(&buffer_[0], 1, kBufferSize);
+    return size_ > 0;
+  }
+
+  File *file_;
+  vector<char> buffer_;
+  size_t pos_;
+  size_t size_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ByteReader);
+};
+
+// Redis append-only file: every command is
+//
+//   *<arguments>\r\n  and for each argument  $<length>\r\n<bytes>\r\n
+//
+// SET commands are given to visitor. Returns false if the file is damaged
+// (commands before the damage are still given).
+inline bool ReadAof(File *file, ResultVisitor *visitor) {
+  ByteReader reader(file);
+  string line, command, key, value;
+  char c;
+  while (reader.Peek(&c)) {
+    if (!reader.ReadUntil('\n', &line) || line.empty() || line[0] != '*')
+      return false;
+    int num_args = atoi(line.c_str() + 1);
+    for (int i = 0; i < num_args; i++) {
+      if (!reader.ReadUntil('\n', &line) || line.empty() || line[0] != '$')
+        return false;
+      string *arg = i == 0 ? &command : i == 1 ? &key : &value;
+      if (!reader.Read(atol(line.c_str() + 1), arg)
+          || !reader.ReadUntil('\n', &line))
+        return false;
+    }
+    if (num_args == 3 && strcasecmp(command.c_str(), "SET") == 0)
+      visitor->Set(key, value);
+  }
+  return true;
+}
+
+// Output of process_graph -l, "job<TAB>json<NEWLINE>" or for binary
+// results "job<TAB>size<NEWLINE>" and size bytes. Results are given to
+// visitor with key result:<job>.
+inline bool ReadLocalResults(File *file, ResultVisitor *visitor) {
+  ByteReader reader(file);
+  string job, size, value;
+  char c;
+  while (reader.Peek(&c)) {
+    if (!reader.ReadUntil('\t', &job) || !reader.Peek(&c))
+      return false;
+    if (c == '{') {
+      if (!reader.ReadUntil('\n', &value))
+        return false;
+    } else {
+      if (!reader.ReadUntil('\n', &size)
+          || !reader.Read(atol(size.c_str()), &value))
+        return false;
+    }
+    visitor->Set("result:" + job, value);
+  }
+  return true;
+}
+
+// Average distance to reachable nodes, from count_dist of a node (count of
+// nodes at each distance, the node itself is at 0)
+struct DistanceStat {
+  explicit DistanceStat(const vector<uint32_t> &count_dist)
+  : distances(0), reachable(0) {
+    for (size_t dist = 1; dist < count_dist.size(); dist++) {
+      reachable += count_dist[dist];
+      distances += uint64_t(count_dist[dist]) * dist;
+    }
+  }
+
+  double closeness() const {
+    return static_cast<double>(distances) / std::max<uint64_t>(reachable, 1);
+  }
+
+  uint64_t distances;
+  uint64_t reachable;
+};
+
+// Sums over count_dist results (xD jobs) of many nodes, as in the report
+struct DistanceSummary {
+  DistanceSummary()
+  : nodes_done(0), nodes_done_proper(0), reachable_sum(0), distance_sum(0),
+    num_canreachscc(0), num_damaged(0) { }
+
+  void Add(const vector<uint32_t> &count_dist, uint32_t largest_scc) {
+    if (spectrum.size() < count_dist.size())
+      spectrum.resize(count_dist.size(), 0);
+    for (size_t dist = 0; dist < count_dist.size(); dist++)
+      spectrum[dist] += count_dist[dist];
+    DistanceStat stat(count_dist);
+    nodes_done++;
+    nodes_done_proper++;
+    distance_sum += stat.distances;
+    reachable_sum += stat.reachable;
+    // Only nodes which reach the largest component count for closeness
+    if (stat.reachable + 1 >= largest_scc)
+      num_canreachscc++;
+  }
+
+  // Node with an error result (for example a category in articles graph)
+  void AddInvalid() {
+    nodes_done++;
+  }
+
+  void Merge(const DistanceSummary &other) {
+    if (spectrum.size() < other.spectrum.size())
+      spectrum.resize(other.spectrum.size(), 0);
+    for (size_t dist = 0; dist < other.spectrum.size(); dist++)
+      spectrum[dist] += other.spectrum[dist];
+    nodes_done += other.nodes_done;
+    nodes_done_proper += other.nodes_done_proper;
+    reachable_sum += other.reachable_sum;
+    distance_sum += other.distance_sum;
+    num_canreachscc += other.num_canreachscc;
+    num_damaged += other.num_damaged;
+  }
+
+  uint64_t nodes_done;
+  uint64_t nodes_done_proper;  // without error
+  uint64_t reachable_sum;
+  uint64_t distance_sum;
+  uint64_t num_canreachscc;
+  uint64_t num_damaged;  // results which could not be read, also invalid
+  vector<uint64_t> spectrum;  // number of pairs at each distance
+};
+
+// Results of xD jobs (JSON or binary) summed by all threads
+class DistanceAggregator {
+ public:
+  DistanceAggregator(const vector<const string *> *results,
+      uint32_t largest_scc)
+  : results_(results), largest_scc_(largest_scc) { }
+
+  void Run(DistanceSummary *summary) {
+    SumBody body;
+    body.s = this;
+    body.sums.resize(NumThreads());
+    ParallelFor(0, results_->size(), 1024, &body);
+    *summary = DistanceSummary();
+    for (size_t t = 0; t < body.sums.size(); t++)
+      summary->Merge(body.sums[t]);
+  }
+
+ private:
+  struct SumBody {
+    DistanceAggregator *s;
+    vector<DistanceSummary> sums;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      string binary;
+      DistanceSummary *sum = &sums[thread];
+      for (uint32_t i = begin; i < end; i++) {
+        if (!ResultToBinary(*(*s->results_)[i], &binary)) {
+          sum->num_damaged++;
+          sum->AddInvalid();
+          continue;
+        }
+        ResultReader reader(binary);
+        bool found = false;
+        while (!found && reader.Next()) {
+          if (reader.key() == "count_dist" && reader.type() == kResultList) {
+            sum->Add(reader.list(), s->largest_scc_);
+            found = true;
+          }
+        }
+        if (!found) {  // error result
+          sum->num_damaged += !reader.ok();
+          sum->AddInvalid();
+        }
+      }
+    }
+  };
+
+  const vector<const string *> *results_;
+  uint32_t largest_scc_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DistanceAggregator);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_AGGREGATE_H_
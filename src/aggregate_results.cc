@@ -0,0 +1,577 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <getopt.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "wikigraph_stubs_internal.h"
+#include "aggregate.h"
+#include "file_io.h"
+#include "name_store.h"
+#include "parallel.h"
+#include "result_builder.h"
+
+namespace wikigraph {
+
+void print_help(char *prg) {
+  printf("Usage: %s [options]\n", prg);
+  printf("\n");
+  printf("Computes report data from results of workers, like analyze.js\n");
+  printf("\n");
+  printf("-a FILE\tRedis append-only file with results (repeatable)\n");
+  printf("-l FILE\tOutput of process_graph -l (repeatable)\n");
+  printf("-n FILE\tNames of nodes, default: n:<node> keys of the AOF\n");
+  printf("-o FILE\tReport state, default:report/state.json\n");
+  printf("-t N\tThreads, default: one per core\n");
+  printf("-h\tShow this help\n");
+  printf("\n");
+  printf("Report is then written by: node analyze.js --load\n");
+}
+
+typedef vector<pair<node_t, const string *> > NodeResults;
+
+// Results and other redis keys which the report uses
+class ReportResults : public ResultVisitor {
+ public:
+  ReportResults() {
+    sorted_[0] = sorted_[1] = true;
+  }
+
+  ~ReportResults() {
+    for (int g = 0; g < 2; g++) {
+      for (size_t i = 0; i < distances_[g].size(); i++)
+        delete distances_[g][i].second;
+    }
+  }
+
+  void Set(const string &key, const string &value) {
+    if (key.compare(0, 7, "result:") == 0) {
+      string job = key.substr(7);
+      int g = Graph(job[0]);
+      if (g >= 0 && job.size() > 2 && job[1] == 'D' && isdigit(job[2])) {
+        distances_[g].push_back(std::make_pair(atoi(job.c_str() + 2),
+            new string(value)));
+        sorted_[g] = false;
+      } else {
+        results_[job] = value;  // the last one, as in redis
+      }
+    } else if (key.compare(0, 8, "s:count:") == 0) {
+      counts_[key.substr(8)] = strtoull(value.c_str(), NULL, 10);
+    } else if (key.compare(0, 2, "n:") == 0) {
+      names_[atoi(key.c_str() + 2)] = value;
+    }
+  }
+
+  // 0 for articles graph, 1 for categories graph
+  static int Graph(char type) {
+    return type == 'a' ? 0 : type == 'c' ? 1 : -1;
+  }
+
+  // Results of xD jobs by node, the first result of a node is kept (like
+  // analyze.js does for AOF files), returns them sorted by node. They are
+  // sorted once after reading, not by every caller
+  const NodeResults &Distances(int g) {
+    NodeResults *list = &distances_[g];
+    if (sorted_[g])
+      return *list;
+    std::stable_sort(list->begin(), list->end(), CompareNode);
+    size_t kept = 0;
+    for (size_t i = 0; i < list->size(); i++) {
+      if (kept && (*list)[kept - 1].first == (*list)[i].first) {
+        delete (*list)[i].second;
+        continue;
+      }
+      (*list)[kept++] = (*list)[i];
+    }
+    list->resize(kept);
+    sorted_[g] = true;
+    return *list;
+  }
+
+  // Result of job, or NULL
+  const string *Get(const string &job) const {
+    std::map<string, string>::const_iterator it = results_.find(job);
+    return it == results_.end() ? NULL : &it->second;
+  }
+
+  uint64_t Count(const char *name) const {
+    std::map<string, uint64_t>::const_iterator it = counts_.find(name);
+    return it == counts_.end() ? 0 : it->second;
+  }
+
+  const string *Name(node_t node) const {
+    std::map<node_t, string>::const_iterator it = names_.find(node);
+    return it == names_.end() ? NULL : &it->second;
+  }
+
+  size_t num_results() const {
+    return results_.size() + distances_[0].size() + distances_[1].size();
+  }
+
+ private:
+  static bool CompareNode(const pair<node_t, const string *> &a,
+      const pair<node_t, const string *> &b) {
+    return a.first < b.first;
+  }
+
+  NodeResults distances_[2];
+  bool sorted_[2];  // and without duplicates
+  std::map<string, string> results_;  // of other jobs
+  std::map<string, uint64_t> counts_;
+  std::map<node_t, string> names_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ReportResults);
+};
+
+// Fields of one result, missing if the result is missing or damaged
+class Fields {
+ public:
+  explicit Fields(const string *result) : ok_(false) {
+    string binary;
+    if (!result || !ResultToBinary(*result, &binary))
+      return;
+    ResultReader reader(binary);
+    while (reader.Next()) {
+      const string &key = reader.key();
+      switch (reader.type()) {
+        case kResultUnsigned:
+          reals_[key] = reader.number();
+          break;
+        case kResultSigned:
+          reals_[key] = reader.signed_number();
+          break;
+        case kResultDouble:
+          reals_[key] = reader.real();
+          break;
+        case kResultString:
+          texts_[key] = reader.text();
+          break;
+        case kResultList:
+          lists_[key] = reader.list();
+          break;
+        case kResultHistogram:
+          for (size_t i = 0; i < reader.histogram().size(); i++)
+            pairs_[key].push_back(std::make_pair(
+                reader.histogram()[i].first, reader.histogram()[i].second));
+          break;
+        case kResultScores:
+          pairs_[key] = reader.scores();
+          break;
+      }
+    }
+    ok_ = reader.ok() && !texts_.count("error");
+  }
+
+  // Result without error
+  bool ok() const {
+    return ok_;
+  }
+
+  double real(const char *key) const {
+    std::map<string, double>::const_iterator it = reals_.find(key);
+    return it == reals_.end() ? 0.0 : it->second;
+  }
+
+  bool has_real(const char *key) const {
+    return reals_.count(key) > 0;
+  }
+
+  vector<uint32_t> list(const char *key) const {
+    std::map<string, vector<uint32_t> >::const_iterator it = lists_.find(key);
+    return it == lists_.end() ? vector<uint32_t>() : it->second;
+  }
+
+  // Histograms and scores, empty lists are lists
+  vector<pair<double, node_t> > pairs(const char *key) const {
+    std::map<string, vector<pair<double, node_t> > >::const_iterator it =
+        pairs_.find(key);
+    return it == pairs_.end() ? vector<pair<double, node_t> >() : it->second;
+  }
+
+  bool has_pairs(const char *key) const {
+    return pairs_.count(key) > 0 || lists_.count(key) > 0;
+  }
+
+ private:
+  bool ok_;
+  std::map<string, double> reals_;  // all numbers
+  std::map<string, string> texts_;
+  std::map<string, vector<uint32_t> > lists_;
+  std::map<string, vector<pair<double, node_t> > > pairs_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Fields);
+};
+
+// Nested JSON objects and arrays, elements of arrays have no key
+class JsonWriter {
+ public:
+  JsonWriter() {
+    first_.push_back(true);
+  }
+
+  void Begin(const char *key) {
+    Key(key);
+    out_ += '{';
+    first_.push_back(true);
+  }
+
+  void End() {
+    out_ += '}';
+    first_.pop_back();
+  }
+
+  void BeginArray(const char *key) {
+    Key(key);
+    out_ += '[';
+    first_.push_back(true);
+  }
+
+  void EndArray() {
+    out_ += ']';
+    first_.pop_back();
+  }
+
+  void Number(const char *key, uint64_t value) {
+    Key(key);
+    util::append_decimal(&out_, value);
+  }
+
+  void Real(const char *key, double value) {
+    Key(key);
+    util::append_json(&out_, value);
+  }
+
+  void String(const char *key, const string &value) {
+    Key(key);
+    util::append_json(&out_, value);
+  }
+
+  void Null(const char *key) {
+    Key(key);
+    out_ += "null";
+  }
+
+  const string &str() const {
+    return out_;
+  }
+
+ private:
+  void Key(const char *key) {
+    if (!first_.back())
+      out_ += ',';
+    first_.back() = false;
+    if (key) {
+      util::append_json(&out_, string(key));
+      out_ += ':';
+    }
+  }
+
+  string out_;
+  vector<bool> first_;  // of each open object or array
+};
+
+class Report {
+ public:
+  Report(ReportResults *results, NameStore *names)
+  : results_(results), names_(names) { }
+
+  // Report state, as saved by analyze.js
+  string Write() {
+    interesting_.clear();
+    JsonWriter json;
+    json.Begin(NULL);
+    WriteGraph('a', &json);
+    WriteGraph('c', &json);
+    std::sort(interesting_.begin(), interesting_.end());
+    interesting_.erase(std::unique(interesting_.begin(), interesting_.end()),
+        interesting_.end());
+    json.BeginArray("interesting_nodes");
+    for (size_t i = 0; i < interesting_.size(); i++)
+      WriteInteresting(interesting_[i], &json);
+    json.EndArray();
+    json.End();
+    return json.str();
+  }
+
+ private:
+  // Wiki title of node, like ResolveNames of analyze.js
+  string Title(node_t node) {
+    string name;
+    if (names_) {
+      name = names_->name(node);
+    } else if (results_->Name(node)) {
+      name = *results_->Name(node);
+    }
+    if (name.compare(0, 2, "a:") == 0)
+      return name.substr(2);
+    if (name.compare(0, 2, "c:") == 0)
+      return "Category:" + name.substr(2);
+    return name;
+  }
+
+  // [[score, node, title], ...]
+  void WriteScores(const char *key, const vector<pair<double, node_t> > &top,
+      JsonWriter *json) {
+    json->BeginArray(key);
+    for (size_t i = 0; i < top.size(); i++) {
+      json->BeginArray(NULL);
+      json->Real(NULL, top[i].first);
+      json->Number(NULL, top[i].second);
+      json->String(NULL, Title(top[i].second));
+      json->EndArray();
+    }
+    json->EndArray();
+  }
+
+  void WriteGraph(char type, JsonWriter *json) {
+    string t(1, type);
+    bool art = type == 'a';
+    json->Begin(art ? "art" : "cat");
+    json->String("type", t);
+    json->Number("num_nodes", results_->Count("Graph_nodes"));
+    if (art) {
+      json->Number("num_articles", results_->Count("Articles"));
+      json->Number("num_links", results_->Count("Article_links"));
+    } else {
+      json->Number("num_categories", results_->Count("Categories"));
+      json->Number("num_links", results_->Count("Category_links"));
+    }
+
+    Fields scc(results_->Get(t + "S"));
+    vector<pair<double, node_t> > components = scc.pairs("components");
+    uint32_t largest_scc = 0;
+    for (size_t i = 0; i < components.size(); i++)
+      largest_scc = std::max<uint32_t>(largest_scc, components[i].first);
+    json->Number("largest_scc", largest_scc);
+    if (scc.ok()) {
+      json->BeginArray("scc");
+      for (size_t i = 0; i < components.size(); i++) {
+        json->BeginArray(NULL);
+        json->Number(NULL, components[i].first);
+        json->Number(NULL, components[i].second);
+        json->EndArray();
+      }
+      json->EndArray();
+    } else {
+      fprintf(stderr, "Result of %sS is missing\n", t.c_str());
+    }
+
+    Fields diameter(results_->Get(t + "X"));
+    if (diameter.ok()) {
+      json->Begin("diameter");
+      json->Number("diameter", diameter.real("diameter"));
+      json->Number("size", diameter.real("size"));
+      json->Number("bfs", diameter.real("bfs"));
+      json->End();
+    } else {
+      json->Null("diameter");
+    }
+
+    Fields ranks(results_->Get(t + "R"));
+    if (art && ranks.ok()) {
+      vector<pair<double, node_t> > top = ranks.pairs("ranks");
+      for (size_t i = 0; i < top.size(); i++)
+        interesting_.push_back(top[i].second);
+      WriteScores("pageranks", top, json);
+    }
+
+    Fields hits(results_->Get(t + "H"));
+    WriteScores("hubs", hits.pairs("hubs"), json);
+    WriteScores("authorities", hits.pairs("authorities"), json);
+
+    Fields closest(results_->Get(t + "T"));
+    if (closest.ok()) {
+      vector<pair<double, node_t> > top = closest.pairs("closeness");
+      json->BeginArray("close_centr");
+      for (size_t i = 0; i < top.size(); i++) {
+        interesting_.push_back(top[i].second);
+        json->Begin(NULL);
+        json->Number("node", top[i].second);
+        json->Real("avg_dist", top[i].first);
+        json->String("name", Title(top[i].second));
+        json->End();
+      }
+      json->EndArray();
+    }
+
+    // Distances from all nodes, the expensive part
+    const NodeResults &distances =
+        results_->Distances(ReportResults::Graph(type));
+    vector<const string *> values(distances.size());
+    for (size_t i = 0; i < distances.size(); i++)
+      values[i] = distances[i].second;
+    DistanceSummary summary;
+    DistanceAggregator aggregator(&values, largest_scc);
+    aggregator.Run(&summary);
+    if (summary.num_damaged)
+      fprintf(stderr, "Damaged results of %sD: %"PRIu64"\n", t.c_str(),
+          summary.num_damaged);
+    json->Number("nodes_done", summary.nodes_done);
+    json->Number("nodes_done_proper", summary.nodes_done_proper);
+    json->Number("sample_size", summary.nodes_done);
+    json->Number("reachable_sum", summary.reachable_sum);
+    json->Number("distance_sum", summary.distance_sum);
+    json->Number("num_canreachscc", summary.num_canreachscc);
+    json->BeginArray("dist_spectrum");
+    for (size_t i = 0; i < summary.spectrum.size(); i++)
+      json->Number(NULL, summary.spectrum[i]);
+    json->EndArray();
+    json->End();
+  }
+
+  // Degrees and distances of node in one graph, zeros if there was an error
+  void WriteNodeInfo(char type, node_t node, JsonWriter *json) {
+    string t(1, type);
+    char number[20];
+    snprintf(number, sizeof(number), "%"PRIu32, node);
+    Fields info(results_->Get(t + "I" + number));
+    vector<uint32_t> count_dist;
+    const NodeResults &distances =
+        results_->Distances(ReportResults::Graph(type));
+    NodeResults::const_iterator it = std::lower_bound(distances.begin(),
+        distances.end(), std::make_pair(node, static_cast<const string *>(0)));
+    const string *result = it != distances.end() && it->first == node
+        ? it->second : results_->Get(t + "D" + number);
+    Fields dist(result);
+    if (dist.ok())
+      count_dist = dist.list("count_dist");
+
+    json->Begin(type == 'a' ? "art" : "cat");
+    json->Number("in_degree", info.ok() ? info.real("in_degree") : 0);
+    json->Number("out_degree", info.ok() ? info.real("out_degree") : 0);
+    json->BeginArray("count_dist");
+    for (size_t i = 0; i < count_dist.size(); i++)
+      json->Number(NULL, count_dist[i]);
+    json->EndArray();
+    // Largest count, as Math.max in analyze.js
+    if (count_dist.empty())
+      json->Null("max_dist");
+    else
+      json->Number("max_dist",
+          *std::max_element(count_dist.begin(), count_dist.end()));
+    DistanceStat stat(count_dist);
+    json->Begin("stat");
+    json->Number("distances", stat.distances);
+    json->Number("reachable", stat.reachable);
+    json->Real("closeness", stat.closeness());
+    json->End();
+    json->End();
+  }
+
+  void WriteInteresting(node_t node, JsonWriter *json) {
+    json->Begin(NULL);
+    json->Number("node", node);
+    json->String("name", Title(node));
+    WriteNodeInfo('a', node, json);
+    WriteNodeInfo('c', node, json);
+    json->End();
+  }
+
+  ReportResults *results_;
+  NameStore *names_;
+  vector<node_t> interesting_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Report);
+};
+
+int aggregate_results(const vector<string> &aofs,
+    const vector<string> &locals, const char *names_file,
+    const char *output) {
+  ReportResults results;
+  for (size_t i = 0; i < aofs.size() + locals.size(); i++) {
+    bool aof = i < aofs.size();
+    const string &fname = aof ? aofs[i] : locals[i - aofs.size()];
+    SystemFile f;
+    if (!f.open(fname.c_str(), "rb")) {
+      fprintf(stderr, "Could not open %s\n", fname.c_str());
+      return 1;
+    }
+    printf("Reading %s\n", fname.c_str());
+    bool complete = aof ? ReadAof(&f, &results)
+        : ReadLocalResults(&f, &results);
+    if (!complete)
+      fprintf(stderr, "%s is damaged, it is read up to the damage\n",
+          fname.c_str());
+    f.close();
+  }
+  printf("Results: %u\n", static_cast<unsigned>(results.num_results()));
+
+  SystemFile f_names;
+  NameStore *names = NULL;
+  if (names_file) {
+    if (!f_names.open(names_file, "rb")) {
+      fprintf(stderr, "Could not open %s\n", names_file);
+      return 1;
+    }
+    names = new NameStore(&f_names);
+    names->Init(true);
+  }
+
+  Report report(&results, names);
+  string state = report.Write();
+  delete names;
+
+  SystemFile f_out;
+  if (!f_out.open(output, "wb")) {
+    fprintf(stderr, "Could not write %s\n", output);
+    return 1;
+  }
+  f_out.write(state.data(), 1, state.size());
+  f_out.close();
+  printf("Report state is written to %s\n", output);
+  return 0;
+}
+
+}  // namespace wikigraph
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> aofs, locals;
+  const char *names_file = NULL;
+  const char *output = "report/state.json";
+  int threads = 0;
+  while (1) {
+    int option = getopt(argc, argv, "a:l:n:o:t:h");
+    if (option == -1)
+      break;
+    switch (option) {
+      case 'a':
+        aofs.push_back(optarg);
+      break;
+      case 'l':
+        locals.push_back(optarg);
+      break;
+      case 'n':
+        names_file = optarg;
+      break;
+      case 'o':
+        output = optarg;
+      break;
+      case 't':
+        threads = atoi(optarg);
+      break;
+      case 'h':
+        wikigraph::print_help(argv[0]);
+        return 0;
+      break;
+      default:
+        wikigraph::print_help(argv[0]);
+        return 1;
+    }
+  }
+  if (argc != optind || (aofs.empty() && locals.empty())) {
+    wikigraph::print_help(argv[0]);
+    return 1;
+  }
+  wikigraph::SetNumThreads(threads);
+  return wikigraph::aggregate_results(aofs, locals, names_file, output);
+}
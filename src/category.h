@@ -0,0 +1,320 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_CATEGORY_H_
+#define SRC_CATEGORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "graph.h"
+
+namespace wikigraph {
+
+// Hierarchy of categories from directed category links, every page (article
+// or category) links to the categories it belongs to. Category links have
+// cycles, they are broken by a depth-first search over parent links which
+// drops every link back to a node that is still on the stack. What is left
+// is a DAG, and the search order lists parents before children.
+//
+// For every node, level is the longest chain of parents above it. Depth is
+// the shortest chain of categories from the root category (Contents on
+// wikipedia) down to the node, kNoDepth for nodes which are not below it.
+// Without a root, depth is the shortest chain of parents up to any node
+// without parents. Ancestors among the top categories are kept as bit sets
+// for every category, so they are known without a search. Top categories
+// are the kTopCategories categories nearest to the root (by level among
+// those of the same depth), or without a root the ones of the smallest
+// levels.
+//
+// Number of all ancestors is not precomputed, that would need the closure
+// of the hierarchy. It is found by a search over parents on the first
+// query of a node and remembered for later queries.
+class CategoryHierarchy {
+ public:
+  static const int kTopWords = 2;
+  static const uint32_t kTopCategories = 64 * kTopWords;
+  static const uint32_t kNoDepth = UINT32_MAX;
+
+  // Root is 0 if it is not known
+  CategoryHierarchy(Graph *graph, node_t root)
+  : graph_(graph), num_nodes_(graph->num_nodes), root_(root),
+    num_dropped_(0), level_(NULL), depth_(NULL), top_index_(NULL),
+    ancestors_(NULL), seen_(NULL) {
+    parents_.list = NULL;
+    parents_.edges = NULL;
+    children_.list = NULL;
+    children_.edges = NULL;
+  }
+
+  ~CategoryHierarchy() {
+    parents_.release();
+    children_.release();
+    delete[] level_;
+    delete[] depth_;
+    delete[] top_index_;
+    delete[] ancestors_;
+    delete[] seen_;
+  }
+
+  void Build() {
+    BreakCycles();
+    Levels();
+    if (root_)
+      DepthsFromRoot();
+    TopBits();
+    ancestors_ = new uint32_t[num_nodes_ + 1];
+    std::fill(ancestors_, ancestors_ + num_nodes_ + 1, UINT32_MAX);
+    seen_ = new uint8_t[num_nodes_ + 1];
+    memset(seen_, 0, num_nodes_ + 1);
+  }
+
+  // Links dropped to break cycles
+  uint32_t num_dropped() const {
+    return num_dropped_;
+  }
+
+  uint32_t level(node_t node) const {
+    return level_[node];
+  }
+
+  uint32_t depth(node_t node) const {
+    return depth_[node];
+  }
+
+  // Categories of node, without links which were dropped
+  vector<node_t> Parents(node_t node) {
+    return vector<node_t>(parents_.edges + parents_.start(node),
+        parents_.edges + parents_.end(node));
+  }
+
+  // Number of ancestors, searched for on the first query of node
+  uint32_t CountAncestors(node_t node) {
+    if (ancestors_[node] != UINT32_MAX)
+      return ancestors_[node];
+    vector<node_t> queue(1, node);
+    seen_[node] = 1;
+    for (size_t top = 0; top < queue.size(); top++) {
+      node_t next = queue[top];
+      for (uint32_t e = parents_.start(next); e < parents_.end(next); e++) {
+        node_t parent = parents_.edges[e];
+        if (!seen_[parent]) {
+          seen_[parent] = 1;
+          queue.push_back(parent);
+        }
+      }
+    }
+    for (size_t i = 0; i < queue.size(); i++)
+      seen_[queue[i]] = 0;
+    ancestors_[node] = queue.size() - 1;
+    return ancestors_[node];
+  }
+
+  // Top categories which are ancestors of node, without a search
+  vector<node_t> TopAncestors(node_t node) {
+    uint64_t bits[kTopWords] = { 0 };
+    for (uint32_t e = parents_.start(node); e < parents_.end(node); e++) {
+      // Parents have children, so their bits are kept
+      const uint64_t *parent = &top_bits_[top_index_[parents_.edges[e]]];
+      for (int i = 0; i < kTopWords; i++)
+        bits[i] |= parent[i];
+    }
+    vector<node_t> ret;
+    for (size_t t = 0; t < top_.size(); t++) {
+      if (bits[t / 64] & (1ull << (t % 64)))
+        ret.push_back(top_[t]);
+    }
+    return ret;
+  }
+
+  // Top categories, nearest to the root first
+  const vector<node_t> &top() const {
+    return top_;
+  }
+
+ private:
+  enum {
+    kNew = 0,
+    kOnStack = 1,
+    kDone = 2
+  };
+
+  bool HasChildren(node_t node) {
+    return children_.end(node) > children_.start(node);
+  }
+
+  // Depth-first search over parents from every node, post-order is kept
+  void BreakCycles() {
+    uint8_t *state = new uint8_t[num_nodes_ + 1];
+    memset(state, kNew, num_nodes_ + 1);
+    vector<bool> dropped(graph_->num_edges, false);
+    vector<pair<node_t, uint32_t> > stack;  // node, next link
+    order_.reserve(num_nodes_);
+    for (node_t root = 1; root <= num_nodes_; root++) {
+      if (state[root] != kNew)
+        continue;
+      state[root] = kOnStack;
+      stack.push_back(std::make_pair(root, graph_->start(root)));
+      while (!stack.empty()) {
+        node_t node = stack.back().first;
+        uint32_t e = stack.back().second;
+        if (e == graph_->end(node)) {
+          state[node] = kDone;
+          order_.push_back(node);
+          stack.pop_back();
+          continue;
+        }
+        stack.back().second++;
+        node_t parent = graph_->edges[e];
+        if (state[parent] == kOnStack) {
+          dropped[e] = true;
+          num_dropped_++;
+        } else if (state[parent] == kNew) {
+          state[parent] = kOnStack;
+          stack.push_back(std::make_pair(parent, graph_->start(parent)));
+        }
+      }
+    }
+    delete[] state;
+
+    // Graph without dropped links, and its reverse
+    parents_.num_nodes = children_.num_nodes = num_nodes_;
+    parents_.num_edges = graph_->num_edges - num_dropped_;
+    children_.num_edges = parents_.num_edges;
+    parents_.list = new uint32_t[num_nodes_ + 2];
+    parents_.edges = new node_t[parents_.num_edges];
+    children_.list = new uint32_t[num_nodes_ + 2];
+    children_.edges = new node_t[children_.num_edges];
+    memset(children_.list, 0, sizeof(uint32_t) * (num_nodes_ + 2));
+    uint32_t pos = 0;
+    parents_.list[0] = parents_.list[1] = 0;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      for (uint32_t e = graph_->start(node); e < graph_->end(node); e++) {
+        if (!dropped[e]) {
+          parents_.edges[pos++] = graph_->edges[e];
+          children_.list[graph_->edges[e] + 1]++;
+        }
+      }
+      parents_.list[node + 1] = pos;
+    }
+    for (node_t node = 1; node <= num_nodes_; node++)
+      children_.list[node + 1] += children_.list[node];
+    vector<uint32_t> fill(children_.list, children_.list + num_nodes_ + 1);
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      for (uint32_t e = parents_.start(node); e < parents_.end(node); e++)
+        children_.edges[fill[parents_.edges[e]]++] = node;
+    }
+  }
+
+  // Parents come before children in order_
+  void Levels() {
+    level_ = new uint32_t[num_nodes_ + 1];
+    depth_ = new uint32_t[num_nodes_ + 1];
+    level_[0] = depth_[0] = 0;
+    for (size_t i = 0; i < order_.size(); i++) {
+      node_t node = order_[i];
+      uint32_t level = 0, depth = UINT32_MAX;
+      for (uint32_t e = parents_.start(node); e < parents_.end(node); e++) {
+        node_t parent = parents_.edges[e];
+        level = std::max(level, level_[parent] + 1);
+        depth = std::min(depth, depth_[parent] + 1);
+      }
+      level_[node] = level;
+      depth_[node] = depth == UINT32_MAX ? 0 : depth;
+    }
+  }
+
+  // Breadth-first search over children from the root
+  void DepthsFromRoot() {
+    for (node_t node = 0; node <= num_nodes_; node++)
+      depth_[node] = kNoDepth;
+    vector<node_t> queue(1, root_);
+    depth_[root_] = 0;
+    for (size_t top = 0; top < queue.size(); top++) {
+      node_t node = queue[top];
+      for (uint32_t e = children_.start(node); e < children_.end(node); e++) {
+        node_t child = children_.edges[e];
+        if (depth_[child] == kNoDepth) {
+          depth_[child] = depth_[node] + 1;
+          queue.push_back(child);
+        }
+      }
+    }
+  }
+
+  // Bits of top ancestors (and of the category itself) of every category,
+  // parents are done first. Categories which are not below the root are
+  // never top ones, there are many of them without parents.
+  void TopBits() {
+    vector<pair<pii, node_t> > candidates;
+    size_t num_categories = 0;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (!HasChildren(node))
+        continue;
+      num_categories++;
+      if (!root_) {
+        candidates.push_back(std::make_pair(pii(level_[node], 0), node));
+      } else if (depth_[node] != kNoDepth) {
+        candidates.push_back(std::make_pair(pii(depth_[node], level_[node]),
+            node));
+      }
+    }
+    size_t num_top = std::min<size_t>(kTopCategories, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + num_top,
+        candidates.end());
+    top_.clear();
+    for (size_t t = 0; t < num_top; t++)
+      top_.push_back(candidates[t].second);
+
+    std::map<node_t, size_t> own_bit;
+    for (size_t t = 0; t < top_.size(); t++)
+      own_bit[top_[t]] = t;
+
+    // Index 0 holds no bits, it is used for nodes without children
+    top_index_ = new uint32_t[num_nodes_ + 1];
+    memset(top_index_, 0, sizeof(uint32_t) * (num_nodes_ + 1));
+    top_bits_.assign(kTopWords * (num_categories + 1), 0);
+    uint32_t next = kTopWords;
+    for (size_t i = 0; i < order_.size(); i++) {
+      node_t node = order_[i];
+      if (!HasChildren(node))
+        continue;
+      top_index_[node] = next;
+      next += kTopWords;
+      uint64_t *bits = &top_bits_[top_index_[node]];
+      for (uint32_t e = parents_.start(node); e < parents_.end(node); e++) {
+        const uint64_t *parent = &top_bits_[top_index_[parents_.edges[e]]];
+        for (int w = 0; w < kTopWords; w++)
+          bits[w] |= parent[w];
+      }
+      std::map<node_t, size_t>::iterator own = own_bit.find(node);
+      if (own != own_bit.end())
+        bits[own->second / 64] |= 1ull << (own->second % 64);
+    }
+  }
+
+  Graph *graph_;  // directed category links
+  uint32_t num_nodes_;
+  node_t root_;  // 0 if not known
+  uint32_t num_dropped_;
+  Graph parents_;  // DAG
+  Graph children_;  // reverse of the DAG
+  vector<node_t> order_;  // parents before children
+  uint32_t *level_;  // of node
+  uint32_t *depth_;  // of node
+  vector<node_t> top_;  // top categories, bit t is top_[t]
+  uint32_t *top_index_;  // of node, start of its bits in top_bits_
+  vector<uint64_t> top_bits_;
+  uint32_t *ancestors_;  // of node, UINT32_MAX until it is counted
+  uint8_t *seen_;  // used in CountAncestors, always cleared
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CategoryHierarchy);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_CATEGORY_H_
@@ -0,0 +1,415 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_CENTRALITY_H_
+#define SRC_CENTRALITY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <utility>
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+// Arrays for one BFS at a time, each thread has its own. Only distances of
+// visited nodes are reset between searches, so a BFS which visits a few
+// nodes is cheap.
+class BfsWorkspace {
+  static const int32_t kUnseen = -1;
+
+ public:
+  explicit BfsWorkspace(uint32_t num_nodes)
+  : num_nodes_(num_nodes), size_(0), sigma_(NULL), delta_(NULL) {
+    dist_ = new int32_t[num_nodes + 1];
+    memset(dist_, kUnseen, sizeof(dist_[0]) * (num_nodes + 1));
+    queue_ = new node_t[num_nodes + 1];
+  }
+
+  ~BfsWorkspace() {
+    delete[] dist_;
+    delete[] queue_;
+    delete[] sigma_;
+    delete[] delta_;
+  }
+
+  // Start a new search from node
+  void Start(node_t node) {
+    for (uint32_t i = 0; i < size_; i++)
+      dist_[queue_[i]] = kUnseen;
+    dist_[node] = 0;
+    queue_[0] = node;
+    size_ = 1;
+  }
+
+  // Add node to the end of the queue
+  inline void Visit(node_t node, int32_t dist) {
+    dist_[node] = dist;
+    queue_[size_++] = node;
+  }
+
+  // Complete BFS, visited nodes are queue()[0 .. size()) in order of
+  // distance
+  void Bfs(Graph *graph, node_t start) {
+    Start(start);
+    for (uint32_t top = 0; top < size_; top++) {
+      node_t node = queue_[top];
+      node_t *target = &graph->edges[graph->start(node)];
+      node_t *end = &graph->edges[graph->end(node)];
+      for ( ; target < end; target++) {
+        if (dist_[*target] == kUnseen)
+          Visit(*target, dist_[node] + 1);
+      }
+    }
+  }
+
+  // Number of shortest paths (sigma) and dependencies (delta) for Brandes
+  void AllocatePaths() {
+    if (sigma_)
+      return;
+    sigma_ = new double[num_nodes_ + 1];
+    delta_ = new double[num_nodes_ + 1];
+  }
+
+  bool Visited(node_t node) const {
+    return dist_[node] != kUnseen;
+  }
+
+  int32_t *dist() { return dist_; }
+  node_t *queue() { return queue_; }
+  uint32_t size() const { return size_; }
+  double *sigma() { return sigma_; }
+  double *delta() { return delta_; }
+
+ private:
+  uint32_t num_nodes_;
+  int32_t *dist_;
+  node_t *queue_;
+  uint32_t size_;  // number of visited nodes
+  double *sigma_, *delta_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BfsWorkspace);
+};
+
+// BFS workspaces of all threads
+class BfsWorkspaces {
+ public:
+  explicit BfsWorkspaces(uint32_t num_nodes)
+  : workspace_(NumThreads()) {
+    for (size_t i = 0; i < workspace_.size(); i++)
+      workspace_[i] = new BfsWorkspace(num_nodes);
+  }
+  ~BfsWorkspaces() {
+    for (size_t i = 0; i < workspace_.size(); i++)
+      delete workspace_[i];
+  }
+  BfsWorkspace *get(int thread) {
+    return workspace_[thread];
+  }
+  int size() const {
+    return workspace_.size();
+  }
+ private:
+  vector<BfsWorkspace*> workspace_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BfsWorkspaces);
+};
+
+// Random sample of valid nodes (without repetition), the same for the same
+// seed
+inline vector<node_t> SampleNodes(uint32_t num_nodes, BitArray *invalid_node,
+    uint32_t how_many, unsigned int seed) {
+  vector<node_t> nodes;
+  for (node_t node = 1; node <= num_nodes; node++) {
+    if (!invalid_node || !invalid_node->get_value(node))
+      nodes.push_back(node);
+  }
+  how_many = std::min<size_t>(how_many, nodes.size());
+  for (uint32_t i = 0; i < how_many; i++) {
+    uint32_t j = i + rand_r(&seed) % (nodes.size() - i);
+    std::swap(nodes[i], nodes[j]);
+  }
+  nodes.resize(how_many);
+  return nodes;
+}
+
+// Nodes from which some node of the component can be reached, including
+// the component itself. These are the nodes which can reach most of the
+// graph, centrality is compared only among them.
+inline vector<node_t> NodesReaching(Graph *reverse, const uint32_t *labels,
+    uint32_t component) {
+  uint32_t num_nodes = reverse->num_nodes;
+  vector<bool> seen(num_nodes + 1, false);
+  vector<node_t> queue;
+  for (node_t node = 1; node <= num_nodes; node++) {
+    if (labels[node] == component) {
+      seen[node] = true;
+      queue.push_back(node);
+    }
+  }
+  for (size_t top = 0; top < queue.size(); top++) {
+    node_t node = queue[top];
+    for (uint32_t i = reverse->start(node); i < reverse->end(node); i++) {
+      node_t source = reverse->edges[i];
+      if (!seen[source]) {
+        seen[source] = true;
+        queue.push_back(source);
+      }
+    }
+  }
+  std::sort(queue.begin(), queue.end());
+  return queue;
+}
+
+// Betweenness centrality estimated from BFS of sampled sources (Brandes
+// algorithm with source sampling, Brandes & Pich). Sources are processed
+// in parallel, each thread accumulates dependencies in its own array.
+//
+// Results are normalized by (n-1)(n-2), the largest possible betweenness.
+// Dependency of one source on a node is at most n-2, so by Hoeffding's
+// inequality the estimate of each node is within error() of the exact
+// value with probability 95%.
+class SampledBetweenness {
+ public:
+  SampledBetweenness(Graph *graph, BitArray *invalid_node, uint32_t samples)
+  : graph_(graph), invalid_node_(invalid_node),
+    num_nodes_(graph->num_nodes), samples_(samples), num_valid_(0) { }
+
+  // Nodes with the highest betweenness
+  vector<pair<double, node_t> > Run(uint32_t how_many) {
+    vector<node_t> sources = SampleNodes(num_nodes_, invalid_node_, samples_,
+        kSeed);
+    samples_ = sources.size();
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (!invalid_node_ || !invalid_node_->get_value(node))
+        num_valid_++;
+    }
+
+    BfsWorkspaces workspaces(num_nodes_);
+    SourceBody body = { this, &sources, &workspaces,
+      vector<double*>(workspaces.size()) };
+    for (int i = 0; i < workspaces.size(); i++) {
+      body.sum[i] = new double[num_nodes_ + 1];
+      memset(body.sum[i], 0, sizeof(double) * (num_nodes_ + 1));
+    }
+    ParallelFor(0, sources.size(), 1, &body);
+
+    vector<pair<double, node_t> > ret;
+    double scale = samples_ && num_valid_ > 2
+        ? static_cast<double>(num_valid_) / samples_
+          / (static_cast<double>(num_valid_ - 1) * (num_valid_ - 2))
+        : 0.0;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (invalid_node_ && invalid_node_->get_value(node))
+        continue;
+      double sum = 0.0;
+      for (size_t i = 0; i < body.sum.size(); i++)
+        sum += body.sum[i][node];
+      ret.push_back(std::make_pair(sum * scale, node));
+    }
+    for (size_t i = 0; i < body.sum.size(); i++)
+      delete[] body.sum[i];
+
+    how_many = std::min<size_t>(how_many, ret.size());
+    std::partial_sort(ret.begin(), ret.begin() + how_many, ret.end(),
+        std::greater< pair<double, node_t> >());
+    ret.resize(how_many);
+    return ret;
+  }
+
+  uint32_t samples() const {
+    return samples_;
+  }
+
+  double error() const {
+    return samples_ ? std::sqrt(std::log(2.0 / 0.05) / (2.0 * samples_))
+        : 1.0;
+  }
+
+ private:
+  static const unsigned int kSeed = 1;
+
+  struct SourceBody {
+    SampledBetweenness *s;
+    const vector<node_t> *sources;
+    BfsWorkspaces *workspaces;
+    vector<double*> sum;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (uint32_t i = begin; i < end; i++)
+        s->Accumulate((*sources)[i], workspaces->get(thread), sum[thread]);
+    }
+  };
+
+  // Brandes: count shortest paths in BFS order, then accumulate
+  // dependencies in reverse order. Successors of a node are exactly one
+  // step further, so only the forward graph is needed.
+  void Accumulate(node_t source, BfsWorkspace *w, double *sum) {
+    w->AllocatePaths();
+    w->Bfs(graph_, source);
+    int32_t *dist = w->dist();
+    node_t *queue = w->queue();
+    double *sigma = w->sigma();
+    double *delta = w->delta();
+    for (uint32_t i = 0; i < w->size(); i++) {
+      sigma[queue[i]] = 0.0;
+      delta[queue[i]] = 0.0;
+    }
+    sigma[source] = 1.0;
+    for (uint32_t i = 0; i < w->size(); i++) {
+      node_t node = queue[i];
+      for (uint32_t e = graph_->start(node); e < graph_->end(node); e++) {
+        node_t target = graph_->edges[e];
+        if (dist[target] == dist[node] + 1)
+          sigma[target] += sigma[node];
+      }
+    }
+    for (uint32_t i = w->size(); i-- > 1; ) {
+      node_t node = queue[i];
+      double dependency = 0.0;
+      for (uint32_t e = graph_->start(node); e < graph_->end(node); e++) {
+        node_t target = graph_->edges[e];
+        if (dist[target] == dist[node] + 1)
+          dependency += (1.0 + delta[target]) / sigma[target];
+      }
+      delta[node] = sigma[node] * dependency;
+      sum[node] += delta[node];
+    }
+  }
+
+  Graph *graph_;
+  BitArray *invalid_node_;
+  uint32_t num_nodes_;
+  uint32_t samples_;
+  uint32_t num_valid_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SampledBetweenness);
+};
+
+// Closeness (average distance to reachable nodes, smaller is closer)
+// estimated from BFS of sampled targets on the reverse graph, each one
+// gives distance from every node to the target (Eppstein & Wang). Nodes
+// with the best estimates are then measured exactly (Okamoto et al.), which
+// gives the exact top nodes with high probability.
+class SampledCloseness {
+  static const uint32_t kRefine = 4;  // exact BFS for kRefine * how_many
+
+ public:
+  // Only nodes which reach the component are ranked
+  SampledCloseness(Graph *graph, Graph *reverse, BitArray *invalid_node,
+      const uint32_t *labels, uint32_t component, uint32_t samples)
+  : graph_(graph), reverse_(reverse), invalid_node_(invalid_node),
+    labels_(labels), component_(component),
+    num_nodes_(graph->num_nodes), samples_(samples) { }
+
+  // Nodes with the smallest average distance
+  vector<pair<double, node_t> > Run(uint32_t how_many) {
+    vector<node_t> targets = SampleNodes(num_nodes_, invalid_node_, samples_,
+        kSeed);
+    samples_ = targets.size();
+
+    BfsWorkspaces workspaces(num_nodes_);
+    EstimateBody estimate = { this, &targets, &workspaces,
+      vector<uint32_t*>(workspaces.size()),
+      vector<uint32_t*>(workspaces.size()) };
+    for (int i = 0; i < workspaces.size(); i++) {
+      estimate.dist_sum[i] = new uint32_t[num_nodes_ + 1];
+      estimate.count[i] = new uint32_t[num_nodes_ + 1];
+      memset(estimate.dist_sum[i], 0, sizeof(uint32_t) * (num_nodes_ + 1));
+      memset(estimate.count[i], 0, sizeof(uint32_t) * (num_nodes_ + 1));
+    }
+    ParallelFor(0, targets.size(), 1, &estimate);
+
+    vector<node_t> nodes = NodesReaching(reverse_, labels_, component_);
+    vector<pair<double, node_t> > estimates;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      uint64_t dist_sum = 0, count = 0;
+      for (size_t t = 0; t < estimate.count.size(); t++) {
+        dist_sum += estimate.dist_sum[t][nodes[i]];
+        count += estimate.count[t][nodes[i]];
+      }
+      double avg = count ? static_cast<double>(dist_sum) / count : HUGE_VAL;
+      estimates.push_back(std::make_pair(avg, nodes[i]));
+    }
+    for (size_t i = 0; i < estimate.count.size(); i++) {
+      delete[] estimate.dist_sum[i];
+      delete[] estimate.count[i];
+    }
+
+    size_t refine = std::min<size_t>(kRefine * how_many, estimates.size());
+    std::partial_sort(estimates.begin(), estimates.begin() + refine,
+        estimates.end());
+    estimates.resize(refine);
+
+    ExactBody exact = { this, &estimates, &workspaces };
+    ParallelFor(0, estimates.size(), 1, &exact);
+    how_many = std::min<size_t>(how_many, estimates.size());
+    std::partial_sort(estimates.begin(), estimates.begin() + how_many,
+        estimates.end());
+    estimates.resize(how_many);
+    return estimates;
+  }
+
+  uint32_t samples() const {
+    return samples_;
+  }
+
+ private:
+  static const unsigned int kSeed = 2;
+
+  struct EstimateBody {
+    SampledCloseness *s;
+    const vector<node_t> *targets;
+    BfsWorkspaces *workspaces;
+    vector<uint32_t*> dist_sum;  // per thread
+    vector<uint32_t*> count;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      BfsWorkspace *w = workspaces->get(thread);
+      for (uint32_t i = begin; i < end; i++) {
+        w->Bfs(s->reverse_, (*targets)[i]);
+        // Target itself is skipped
+        for (uint32_t j = 1; j < w->size(); j++) {
+          node_t node = w->queue()[j];
+          dist_sum[thread][node] += w->dist()[node];
+          count[thread][node]++;
+        }
+      }
+    }
+  };
+
+  struct ExactBody {
+    SampledCloseness *s;
+    vector<pair<double, node_t> > *nodes;
+    BfsWorkspaces *workspaces;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      BfsWorkspace *w = workspaces->get(thread);
+      for (uint32_t i = begin; i < end; i++) {
+        w->Bfs(s->graph_, (*nodes)[i].second);
+        uint64_t dist_sum = 0;
+        for (uint32_t j = 0; j < w->size(); j++)
+          dist_sum += w->dist()[w->queue()[j]];
+        (*nodes)[i].first = w->size() > 1
+            ? static_cast<double>(dist_sum) / (w->size() - 1) : HUGE_VAL;
+      }
+    }
+  };
+
+  Graph *graph_;
+  Graph *reverse_;
+  BitArray *invalid_node_;
+  const uint32_t *labels_;
+  uint32_t component_;
+  uint32_t num_nodes_;
+  uint32_t samples_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SampledCloseness);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_CENTRALITY_H_
@@ -0,0 +1,153 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_COMMUNITIES_H_
+#define SRC_COMMUNITIES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+// Communities of an undirected graph (each edge is given in both
+// directions) by label propagation (Raghavan, Albert & Kumara). Every node
+// starts with its own label and repeatedly takes the label most of its
+// neighbours have, so labels spread through densely linked groups and stop
+// at sparse cuts between them.
+//
+// Updates are asynchronous: all threads update labels in place, in a random
+// order of nodes which is shuffled every iteration, and a node sees labels
+// its neighbours got earlier in the same iteration. A node keeps its label
+// if it is among the most frequent ones, other ties are broken randomly.
+// Invalid nodes get 0 and do not pass their labels.
+class LabelPropagation {
+ public:
+  LabelPropagation(Graph *graph, BitArray *invalid_node)
+  : graph_(graph), invalid_node_(invalid_node),
+    num_nodes_(graph->num_nodes) { }
+
+  // labels has num_nodes + 1 elements. Stops when no more than
+  // 1 / kStopFraction of nodes change labels, returns the number of
+  // iterations. Communities are labeled by the smallest node in them.
+  uint32_t Run(uint32_t max_iterations, uint32_t *labels) {
+    vector<node_t> order;
+    for (node_t node = 0; node <= num_nodes_; node++) {
+      labels[node] = node && Valid(node) ? node : 0;
+      if (labels[node])
+        order.push_back(node);
+    }
+    uint32_t random = 1;
+    uint32_t iteration = 0;
+    while (iteration < max_iterations) {
+      iteration++;
+      for (size_t i = order.size(); i > 1; i--)
+        std::swap(order[i - 1], order[Next(&random) % i]);
+      UpdateBody body;
+      body.s = this;
+      body.order = &order;
+      body.labels = labels;
+      body.random.resize(NumThreads());
+      for (size_t t = 0; t < body.random.size(); t++)
+        body.random[t] = Next(&random) | 1;
+      body.neighbours.resize(NumThreads());
+      body.changed.assign(NumThreads(), 0);
+      ParallelFor(0, order.size(), 1024, &body);
+      uint32_t changed = 0;
+      for (size_t t = 0; t < body.changed.size(); t++)
+        changed += body.changed[t];
+      if (changed <= order.size() / kStopFraction)
+        break;
+    }
+    Relabel(labels);
+    return iteration;
+  }
+
+ private:
+  static const uint32_t kStopFraction = 1000;
+
+  // xorshift, state must not be 0
+  static uint32_t Next(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+  }
+
+  struct UpdateBody {
+    LabelPropagation *s;
+    const vector<node_t> *order;
+    uint32_t *labels;
+    vector<uint32_t> random;  // per thread
+    vector<vector<uint32_t> > neighbours;  // per thread, their labels
+    vector<uint32_t> changed;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      Graph *graph = s->graph_;
+      vector<uint32_t> &around = neighbours[thread];
+      for (uint32_t i = begin; i < end; i++) {
+        node_t node = (*order)[i];
+        around.clear();
+        for (uint32_t e = graph->start(node); e < graph->end(node); e++) {
+          uint32_t label = AtomicLoad(&labels[graph->edges[e]]);
+          if (label)
+            around.push_back(label);
+        }
+        if (around.empty())
+          continue;
+        std::sort(around.begin(), around.end());
+        uint32_t current = labels[node];
+        uint32_t best = 0, best_count = 0, current_count = 0, ties = 0;
+        for (size_t j = 0; j < around.size(); ) {
+          size_t k = j;
+          while (k < around.size() && around[k] == around[j])
+            k++;
+          uint32_t count = k - j;
+          if (around[j] == current)
+            current_count = count;
+          if (count > best_count) {
+            best = around[j];
+            best_count = count;
+            ties = 1;
+          } else if (count == best_count
+              && Next(&random[thread]) % ++ties == 0) {
+            best = around[j];
+          }
+          j = k;
+        }
+        if (current_count == best_count)
+          continue;
+        AtomicStore(&labels[node], best);
+        changed[thread]++;
+      }
+    }
+  };
+
+  // Label of each community becomes its smallest node
+  void Relabel(uint32_t *labels) {
+    vector<node_t> smallest(num_nodes_ + 1, 0);
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (labels[node] && !smallest[labels[node]])
+        smallest[labels[node]] = node;
+    }
+    for (node_t node = 1; node <= num_nodes_; node++)
+      labels[node] = smallest[labels[node]];
+  }
+
+  bool Valid(node_t node) const {
+    return !invalid_node_ || !invalid_node_->get_value(node);
+  }
+
+  Graph *graph_;
+  BitArray *invalid_node_;
+  uint32_t num_nodes_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LabelPropagation);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_COMMUNITIES_H_
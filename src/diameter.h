@@ -0,0 +1,227 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_DIAMETER_H_
+#define SRC_DIAMETER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+// Exact diameter of a strongly connected component, computed by bounding
+// eccentricities of its nodes (Takes & Kosters, adapted to directed
+// graphs). ecc(w) is the largest distance from w to another node in the
+// component. A BFS forwards and backwards from v gives d(v, w) and
+// d(w, v) for every w, and
+//
+//   ecc(w) >= d(w, v)
+//   ecc(w) >= ecc(v) - d(v, w)
+//   ecc(w) <= d(w, v) + ecc(v)
+//
+// Nodes whose upper bound can not exceed the largest eccentricity found so
+// far are dropped. BFS sources alternate between the node with the largest
+// upper bound and the node with the smallest lower bound. On small-world
+// graphs this takes tens of BFS runs instead of one per node.
+class DiameterSolver {
+  static const uint32_t kInfinity = UINT32_MAX;
+  static const int32_t kUnseen = -1;
+
+ public:
+  // Nodes of the component are those with labels[node] == component
+  DiameterSolver(Graph *graph, Graph *reverse, const uint32_t *labels,
+      uint32_t component)
+  : graph_(graph), reverse_(reverse), labels_(labels),
+    component_(component), num_nodes_(graph->num_nodes),
+    diameter_(0), num_bfs_(0), size_(0) {
+    lower_ = new uint32_t[num_nodes_ + 1];
+    upper_ = new uint32_t[num_nodes_ + 1];
+  }
+
+  ~DiameterSolver() {
+    delete[] lower_;
+    delete[] upper_;
+  }
+
+  void Run() {
+    vector<node_t> candidates;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      lower_[node] = 0;
+      upper_[node] = kInfinity;
+      if (InComponent(node))
+        candidates.push_back(node);
+    }
+    size_ = candidates.size();
+    if (candidates.empty())
+      return;
+
+    dist_forward_ = new int32_t[num_nodes_ + 1];
+    dist_backward_ = new int32_t[num_nodes_ + 1];
+    queue_forward_ = new node_t[num_nodes_ + 1];
+    queue_backward_ = new node_t[num_nodes_ + 1];
+
+    node_t source = HighestDegree(candidates);
+    for (int round = 0; !candidates.empty(); round++) {
+      if (round > 0)
+        source = round % 2 ? LargestUpper(candidates)
+            : SmallestLower(candidates);
+      // Both directions at once
+      BfsBody bfs = { this, source };
+      ParallelFor(0, 2, 1, &bfs);
+      num_bfs_ += 2;
+      uint32_t ecc = bfs_ecc_[0];
+      diameter_ = std::max(diameter_, std::max(ecc, bfs_ecc_[1]));
+
+      size_t left = 0;
+      for (size_t i = 0; i < candidates.size(); i++) {
+        node_t w = candidates[i];
+        uint32_t from_w = dist_backward_[w];  // d(w, source)
+        uint32_t to_w = dist_forward_[w];  // d(source, w)
+        lower_[w] = std::max(lower_[w], from_w);
+        if (ecc > to_w)
+          lower_[w] = std::max(lower_[w], ecc - to_w);
+        upper_[w] = std::min(upper_[w], from_w + ecc);
+        diameter_ = std::max(diameter_, lower_[w]);
+        if (upper_[w] > diameter_ && lower_[w] != upper_[w])
+          candidates[left++] = w;
+      }
+      candidates.resize(left);
+      // Diameter could have grown after some nodes were kept
+      left = 0;
+      for (size_t i = 0; i < candidates.size(); i++) {
+        if (upper_[candidates[i]] > diameter_)
+          candidates[left++] = candidates[i];
+      }
+      candidates.resize(left);
+    }
+
+    delete[] dist_forward_;
+    delete[] dist_backward_;
+    delete[] queue_forward_;
+    delete[] queue_backward_;
+  }
+
+  uint32_t diameter() const {
+    return diameter_;
+  }
+
+  // Number of BFS runs it took to find the diameter
+  uint32_t num_bfs() const {
+    return num_bfs_;
+  }
+
+  // Number of nodes in the component
+  uint32_t size() const {
+    return size_;
+  }
+
+  bool InComponent(node_t node) const {
+    return labels_[node] == component_;
+  }
+
+  // Bounds of eccentricity of a node in the component, equal if exact
+  uint32_t lower(node_t node) const {
+    return lower_[node];
+  }
+
+  uint32_t upper(node_t node) const {
+    return upper_[node];
+  }
+
+ private:
+  struct BfsBody {
+    DiameterSolver *s;
+    node_t source;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (uint32_t i = begin; i < end; i++) {
+        if (i == 0)
+          s->bfs_ecc_[0] = s->Bfs(s->graph_, source, s->dist_forward_,
+              s->queue_forward_);
+        else
+          s->bfs_ecc_[1] = s->Bfs(s->reverse_, source, s->dist_backward_,
+              s->queue_backward_);
+      }
+    }
+  };
+
+  // Distances from start to nodes of the component, returns the largest
+  uint32_t Bfs(Graph *graph, node_t start, int32_t *dist, node_t *queue) {
+    memset(dist, kUnseen, sizeof(dist[0]) * (num_nodes_ + 1));
+    dist[start] = 0;
+    queue[0] = start;
+    uint32_t queuesize = 1;
+    for (uint32_t top = 0; top < queuesize; top++) {
+      node_t node = queue[top];
+      node_t *target = &graph->edges[graph->start(node)];
+      node_t *end = &graph->edges[graph->end(node)];
+      for ( ; target < end; target++) {
+        if (dist[*target] == kUnseen && InComponent(*target)) {
+          dist[*target] = dist[node] + 1;
+          queue[queuesize++] = *target;
+        }
+      }
+    }
+    return dist[queue[queuesize - 1]];
+  }
+
+  node_t HighestDegree(const vector<node_t> &nodes) {
+    node_t best = nodes[0];
+    uint64_t best_score = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      uint64_t out_degree = graph_->end(nodes[i]) - graph_->start(nodes[i]);
+      uint64_t in_degree = reverse_->end(nodes[i])
+          - reverse_->start(nodes[i]);
+      uint64_t score = (out_degree + 1) * (in_degree + 1);
+      if (score > best_score) {
+        best = nodes[i];
+        best_score = score;
+      }
+    }
+    return best;
+  }
+
+  node_t LargestUpper(const vector<node_t> &nodes) {
+    node_t best = nodes[0];
+    for (size_t i = 1; i < nodes.size(); i++) {
+      if (upper_[nodes[i]] > upper_[best])
+        best = nodes[i];
+    }
+    return best;
+  }
+
+  node_t SmallestLower(const vector<node_t> &nodes) {
+    node_t best = nodes[0];
+    for (size_t i = 1; i < nodes.size(); i++) {
+      if (lower_[nodes[i]] < lower_[best])
+        best = nodes[i];
+    }
+    return best;
+  }
+
+  Graph *graph_;
+  Graph *reverse_;
+  const uint32_t *labels_;
+  uint32_t component_;
+  uint32_t num_nodes_;
+
+  uint32_t diameter_;
+  uint32_t num_bfs_;
+  uint32_t size_;
+  uint32_t *lower_, *upper_;
+
+  // Used in Run
+  int32_t *dist_forward_, *dist_backward_;
+  node_t *queue_forward_, *queue_backward_;
+  uint32_t bfs_ecc_[2];
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DiameterSolver);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_DIAMETER_H_
@@ -0,0 +1,140 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_DUMP_CACHE_H_
+#define SRC_DUMP_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include "wikigraph_stubs_internal.h"
+#include "file_io.h"
+
+namespace wikigraph {
+
+// Rows parsed from a mysql dump can be saved in a binary cache, so that
+// later runs don't have to parse SQL again. Cache is a sequence of uint32
+// units followed by a trailer:
+//
+//  [units...][num_units low][num_units high][signature][kDumpCacheMagic]
+//
+// Strings are stored as their length followed by the bytes, padded with
+// zeroes to a multiple of 4. Signature identifies the dump (see
+// file_signature), cache with a different signature is stale.
+const uint32_t kDumpCacheMagic = 0x31434757;  // "WGC1"
+const size_t kDumpCacheTrailer = 4;  // in units
+
+// Signature of a file based on its size and modification time, 0 if the
+// file does not exist. Signature of files this one depends on should be
+// given as seed, so a change of any of them invalidates the cache.
+inline uint32_t file_signature(const char *path, uint32_t seed) {
+  struct stat info;
+  if (stat(path, &info) != 0)
+    return 0;
+  uint64_t size = info.st_size;
+  uint32_t data[3] = { static_cast<uint32_t>(size),
+    static_cast<uint32_t>(size >> 32), static_cast<uint32_t>(info.st_mtime) };
+  return crc32(seed, reinterpret_cast<const Bytef*>(data), sizeof(data));
+}
+
+class DumpCacheWriter {
+ public:
+  explicit DumpCacheWriter(File *f)
+  : writer_(f), num_units_(0) { }
+
+  void write_uint(uint32_t val) {
+    writer_.write_uint(val);
+    num_units_++;
+  }
+  // Bytes padded with zeroes to a multiple of 4
+  void write_bytes(const void *data, size_t len) {
+    const char *ptr = reinterpret_cast<const char*>(data);
+    for (size_t i = 0; i < len; i += 4) {
+      uint32_t unit = 0;
+      memcpy(&unit, ptr + i, std::min<size_t>(4, len - i));
+      write_uint(unit);
+    }
+  }
+  void write_string(const string &str) {
+    write_uint(str.size());
+    write_bytes(str.data(), str.size());
+  }
+  // Write the trailer, cache is not valid until this is called
+  void finish(uint32_t signature) {
+    writer_.write_uint(static_cast<uint32_t>(num_units_));
+    writer_.write_uint(static_cast<uint32_t>(num_units_ >> 32));
+    writer_.write_uint(signature);
+    writer_.write_uint(kDumpCacheMagic);
+    writer_.finish();
+  }
+ private:
+  BufferedWriter writer_;
+  uint64_t num_units_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DumpCacheWriter);
+};
+
+class DumpCacheReader {
+ public:
+  explicit DumpCacheReader(File *f)
+  : file_(f), reader_(f), left_(0) { }
+
+  // Check that cache is complete and matches the signature
+  bool init(uint32_t signature) {
+    file_->seek(0, SEEK_END);
+    off_t size = file_->tell();
+    if (size < off_t(sizeof(uint32_t) * kDumpCacheTrailer))
+      return false;
+    uint32_t trailer[kDumpCacheTrailer];
+    file_->seek(-off_t(sizeof(trailer)), SEEK_END);
+    file_->read(trailer, sizeof(uint32_t), kDumpCacheTrailer);
+    file_->seek(0, SEEK_SET);
+
+    uint64_t num_units = trailer[0] | (uint64_t(trailer[1]) << 32);
+    if (trailer[3] != kDumpCacheMagic || trailer[2] != signature)
+      return false;
+    if (size != off_t(sizeof(uint32_t) * (num_units + kDumpCacheTrailer)))
+      return false;  // Truncated
+    left_ = num_units;
+    return true;
+  }
+  bool has_next() const {
+    return left_ > 0;
+  }
+  uint32_t read_uint() {
+    assert(left_ > 0);
+    left_--;
+    return reader_.read_unit();
+  }
+  void read_bytes(void *data, size_t len) {
+    char *ptr = reinterpret_cast<char*>(data);
+    for (size_t i = 0; i < len; i += 4) {
+      uint32_t unit = read_uint();
+      memcpy(ptr + i, &unit, std::min<size_t>(4, len - i));
+    }
+  }
+  void read_string(string *str) {
+    uint32_t len = read_uint();
+    str->resize(len);
+    if (len)
+      read_bytes(&(*str)[0], len);
+  }
+  void set_print_progress(bool do_print) {
+    reader_.set_print_progress(do_print);
+  }
+ private:
+  File *file_;
+  BufferedReader<uint32_t> reader_;
+  uint64_t left_;  // units which are not read yet
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DumpCacheReader);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_DUMP_CACHE_H_
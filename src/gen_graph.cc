@@ -1,14 +1,21 @@
 // Copyright 2011 Emir Habul, see file COPYING
 
+#include <getopt.h>
+#include <pthread.h>
+
 #include <cstdio>
 #include <cctype>
 #include <cstdarg>
 
+#include <algorithm>
+
 #include "config.h"
 #include "sql_parser.h"
 #include "file_io.h"
 #include "redis.h"
 #include "graph.h"
+#include "name_store.h"
+#include "dump_cache.h"
 
 #include <google/dense_hash_map>
 using google::dense_hash_map;
@@ -30,7 +37,9 @@ struct WikiStatus {
     UNKNOWN = 0,
     REGULAR = 1,
     REDIRECT = 2,
-    RESOLVED = 3  // resolved redirect
+    RESOLVED = 3,  // resolved redirect
+    BROKEN = 4,  // redirect which can not be resolved (cycle, missing target)
+    VISITING = 5  // temporary state while following a chain of redirects
   };
   unsigned int type:3;
   unsigned int is_category:1;  // 0 - article, 1 - category
@@ -40,17 +49,22 @@ struct WikiStatus {
 WikiStatus g_wikistatus[MAX_WIKI_PAGEID+1];
 
 uint32_t g_wikigraphId[MAX_WIKI_PAGEID+1];
+uint32_t g_graph2wiki[MAX_NODEID+1];
 
 // Global struct for storing info about graph and conversion process
 struct WikiGraphInfo {
   int graph_nodes_count, article_count, category_count;
   int art_redirect_count, cat_redirect_count;
+  int unresolved_redirect_count, cyclic_redirect_count;
   int article_links_count;
   int skipped_catlinks, skipped_fromcat_links;
   int category_links_count;
   int hidden_graphid;
   int stub_graphid;
+  uint32_t page_signature, redirect_signature;  // of dumps, see read_dump
 } g_info;
+// Stages which run in parallel update g_info under this lock
+pthread_mutex_t g_info_lock = PTHREAD_MUTEX_INITIALIZER;
 
 bool g_nodeIsCat[MAX_NODEID];
 bool g_nodeIsHidden[MAX_NODEID];  // Belongs to category Hidden_categories OR Category:Stub_categories
@@ -70,22 +84,160 @@ dense_hash_map<string, int, FVNHash> g_redirName2wiki;
 dense_hash_map<string, int, FVNHash> g_name2graphId;
 dense_hash_map<int, string> g_wiki2redirName;
 
+// wikiId of the page with the given title, for resolved redirects wikiId
+// of the target page. 0 if there is no such page.
+int title_wikiId(const string &title) {
+  dense_hash_map<string, int, FVNHash>::const_iterator page =
+    g_name2graphId.find(title);
+  if (page != g_name2graphId.end() && page->second > 0)
+    return g_graph2wiki[page->second];
+  dense_hash_map<string, int, FVNHash>::const_iterator redir =
+    g_redirName2wiki.find(title);
+  if (redir != g_redirName2wiki.end())
+    return redir->second;
+  return 0;
+}
+
+// graphId of the page, redirects are followed.
+// 0 for missing pages and redirects which are not resolved.
+int wiki_graphId(int wikiId) {
+  unsigned int type = g_wikistatus[wikiId].type;
+  if (type == WikiStatus::REGULAR || type == WikiStatus::RESOLVED)
+    return g_wikigraphId[wikiId];
+  return 0;
+}
+
 }  // namespace
 
+// Bit of stage (1-based) in a set of stages
+inline uint32_t stage_bit(int stage) {
+  return 1u << stage;
+}
+
 class Stage {
  public:
   virtual ~Stage() {}
+  // Stages may run in parallel (see StageScheduler), main() should only
+  // read the tables which it does not modify and must not use redis.
   virtual void main(redisContext *redis) = 0;
   virtual void finish(redisContext *redis) = 0;
+  // Set of stages which must be done before main() starts
+  virtual uint32_t depends_on() const = 0;
+  // Files written by main()
+  virtual void outputs(vector<const char *> *files) const { }
+  // Whether main() modifies global tables
+  virtual bool modifies_tables() const {
+    return false;
+  }
 };
 
+// Handler of rows which come either from the SQL dump (data) or from its
+// binary cache (cached_data). Both are turned into the same normalized row,
+// which is written to the cache while SQL is parsed.
+class CachedDataHandler : public DataHandler {
+ public:
+  CachedDataHandler() : cache_(NULL) { }
+  virtual void cached_data(DumpCacheReader *cache) = 0;
+  void set_cache(DumpCacheWriter *cache) {
+    cache_ = cache;
+  }
+ protected:
+  DumpCacheWriter *cache_;  // NULL if rows are not cached
+};
+
+// Bump this when the format of cached rows changes
+const uint32_t kDumpCacheFormat = 1;
+
+// Signature of dump DUMPFILES<name>.sql(.gz), seed is signature of the
+// dumps which were used to normalize its rows.
+uint32_t dump_signature(const char *name, uint32_t seed) {
+  string fname = string(DUMPFILES) + name + ".sql";
+  uint32_t signature = file_signature(fname.c_str(), seed);
+  if (!signature)
+    signature = file_signature((fname + ".gz").c_str(), seed);
+  return signature;
+}
+
+// Feed all rows of DUMPFILES<name>.sql (or .sql.gz) to the handler. If
+// DUMP_CACHE is defined and DUMPFILES<name>.cache has the same signature,
+// rows are read from the cache instead. Otherwise the cache is rewritten.
+void read_dump(const char *name, CachedDataHandler *handler,
+    uint32_t signature) {
+  string fname = string(DUMPFILES) + name + ".sql";
+  string gzname = fname + ".gz";
+#ifdef DUMP_CACHE
+  string cachename = string(DUMPFILES) + name + ".cache";
+  string tmpname = cachename + ".tmp";
+
+  SystemFile cachefile;
+  if (cachefile.open(cachename.c_str(), "rb")) {
+    bool valid;
+    if (1) {  // Destroy reader before closing the file
+      DumpCacheReader cache(&cachefile);
+      valid = cache.init(signature);
+      if (valid) {
+        printf("Reading cache '%s'\n", cachename.c_str());
+        cache.set_print_progress(true);
+        while (cache.has_next())
+          handler->cached_data(&cache);
+      }
+    }
+    cachefile.close();
+    if (valid)
+      return;
+  }
+  DumpCacheWriter *writer = NULL;
+  if (cachefile.open(tmpname.c_str(), "wb")) {
+    writer = new DumpCacheWriter(&cachefile);
+    handler->set_cache(writer);
+  }
+#endif
+  bool parsed = false;
+  SystemFile file;
+  if (file.open(fname.c_str(), "rb")) {
+    BufferedReader<char> reader(&file);
+    reader.set_print_progress(true);
+    SqlParser parser(&reader, handler);
+    parser.run();
+    file.close();
+    parsed = true;
+  } else {
+    GzipFile gzfile;
+    if (gzfile.open(gzname.c_str(), "rb")) {
+      BufferedReader<char> reader(&gzfile);
+      reader.set_print_progress(true);
+      SqlParser parser(&reader, handler);
+      parser.run();
+      gzfile.close();
+      parsed = true;
+    } else {
+      fprintf(stderr, "failed to open file '%s' and '%s'\n",
+          fname.c_str(), gzname.c_str());
+    }
+  }
+#ifdef DUMP_CACHE
+  if (writer) {
+    handler->set_cache(NULL);
+    if (parsed)
+      writer->finish(signature);
+    delete writer;
+    cachefile.close();
+    // Cache becomes visible only when it is complete
+    if (parsed)
+      rename(tmpname.c_str(), cachename.c_str());
+    else
+      unlink(tmpname.c_str());
+  }
+#endif
+}
+
 /**************
  * STAGE 1
  * Create graph nodes and store relevant data about nodes
  */
 namespace stage1 {
 
-class PageHandler : public DataHandler {  // for Stage1
+class PageHandler : public CachedDataHandler {  // for Stage1
  protected:
   // SQL schema
   enum Page {
@@ -102,8 +254,8 @@ class PageHandler : public DataHandler {  // for Stage1
     page_len = 10  // int(8) unsigned NOT NULL DEFAULT '0',
   };
  public:
-  explicit PageHandler(redisContext *redis)
-  :redis_(redis), is_cat_(NULL) { }
+  PageHandler()
+  : is_cat_(NULL) { }
   void init() {
     file_.open("graph_nodeiscat.bin", "wb");
     is_cat_ = new BufferedWriter(&file_);
@@ -116,59 +268,70 @@ class PageHandler : public DataHandler {  // for Stage1
     }
   }
   void data(const vector<string> &data);
+  void cached_data(DumpCacheReader *cache);
  protected:
-  redisContext *redis_;
+  // Row of the page table with title without a prefix
+  virtual void page(int wikiId, int namespc, bool is_redir,
+      const string &name);
  private:
   BufferedWriter *is_cat_;
   SystemFile file_;
+  string title_;  // buffer for cached_data
   DISALLOW_COPY_AND_ASSIGN(PageHandler);
 };
 
 class PageHandlerNames : public PageHandler {
  public:
-  explicit PageHandlerNames(redisContext *redis)
-  : PageHandler(redis) { }
-  void init() {}  // don't write nodeiscat.bin
-  void data(const vector<string> &data);
+  PageHandlerNames()
+  : names_(NULL) { }
+  void init() {  // don't write nodeiscat.bin
+    names_file_.open("names.bin", "wb");
+    names_ = new NameStoreWriter(&names_file_, g_info.graph_nodes_count);
+  }
+  ~PageHandlerNames() {
+    if (names_) {
+      delete names_;
+      names_file_.close();
+    }
+  }
+  void page(int wikiId, int namespc, bool is_redir, const string &name);
  private:
+  NameStoreWriter *names_;
+  SystemFile names_file_;
   DISALLOW_COPY_AND_ASSIGN(PageHandlerNames);
 };
 
 class Stage1 : public Stage {
  public:
+  uint32_t depends_on() const {
+    return 0;
+  }
+  void outputs(vector<const char *> *files) const {
+    files->push_back("graph_nodeiscat.bin");
+    files->push_back("names.bin");
+  }
+  bool modifies_tables() const {
+    return true;
+  }
   void main(redisContext *redis) {
     g_info.graph_nodes_count = g_info.article_count = g_info.category_count = 0;
     g_info.art_redirect_count = g_info.cat_redirect_count = 0;
 
-    PageHandler data_handler(redis);
+    PageHandler data_handler;
     data_handler.init();
 
-    const char *fname = DUMPFILES"page.sql";
-    const char *gzname = DUMPFILES"page.sql.gz";
+    g_info.page_signature = dump_signature("page", kDumpCacheFormat);
+    read_dump("page", &data_handler, g_info.page_signature);
 
-    SystemFile file;
-    if (file.open(fname, "rb")) {
-      BufferedReader<char> reader(&file);
-      reader.set_print_progress(true);
-      SqlParser parser(&reader, &data_handler);
-      parser.run();
-      file.close();
-    } else {
-      GzipFile gzfile;
-      if (gzfile.open(gzname, "rb")) {
-        BufferedReader<char> reader(&gzfile);
-        reader.set_print_progress(true);
-        SqlParser parser(&reader, &data_handler);
-        parser.run();
-      } else {
-        fprintf(stderr, "failed to open file '%s' and '%s'\n", fname, gzname);
-      }
-      gzfile.close();
-    }
-    g_info.hidden_graphid = g_name2graphId["c:Hidden_categories"];
+    g_info.hidden_graphid = wiki_graphId(title_wikiId("c:Hidden_categories"));
     printf("Hidden graphid %d\n", g_info.hidden_graphid);
-    g_info.stub_graphid = g_name2graphId["c:Stub_categories"];
+    g_info.stub_graphid = wiki_graphId(title_wikiId("c:Stub_categories"));
     printf("Stub graphid %d\n", g_info.stub_graphid);
+
+    // Names are written in a second pass, when the number of nodes is known
+    PageHandlerNames names_handler;
+    names_handler.init();
+    read_dump("page", &names_handler, g_info.page_signature);
   }
 
   void finish(redisContext *redis) {
@@ -195,40 +358,49 @@ class Stage1 : public Stage {
         "SET s:special:StubGraphId %d", g_info.stub_graphid);
     freeReplyObject(reply);
 
-    PageHandlerNames data_handler(redis);
-    data_handler.init();
-
-    const char *fname = DUMPFILES"page.sql";
-    const char *gzname = DUMPFILES"page.sql.gz";
-
-    SystemFile file;
-    if (file.open(fname, "rb")) {
-      BufferedReader<char> reader(&file);
-      reader.set_print_progress(true);
-      SqlParser parser(&reader, &data_handler);
-      parser.run();
-      file.close();
-    } else {
-      GzipFile gzfile;
-      if (gzfile.open(gzname, "rb")) {
-        BufferedReader<char> reader(&gzfile);
-        reader.set_print_progress(true);
-        SqlParser parser(&reader, &data_handler);
-        parser.run();
-        gzfile.close();
-      } else {
-        fprintf(stderr, "failed to open file '%s' and '%s'\n", fname, gzname);
-      }
+#ifdef REDIS_NAMES
+    SystemFile f_names;
+    if (!f_names.open("names.bin", "rb")) {
+      perror("fopen");
+      exit(1);
+    }
+    NameStore names(&f_names);
+    names.Init(false);
+    f_names.close();
+    for (node_t node = 1; node <= names.num_nodes(); node++) {
+      reply = redisCmd(redis, "SET n:%d %s", node, names.name(node).c_str());
+      freeReplyObject(reply);
     }
+#endif
   }
 };
 
-// mysql table 'page'
+// mysql table 'page', only articles and categories are cached
 void PageHandler::data(const vector<string> &data) {
-  bool is_redir = data[page_is_redirect][0] == '1';
   int namespc = atoi(data[page_namespace].c_str());
-
+  if (namespc != NS_MAIN && namespc != NS_CATEGORY)
+    return;  // Other namespaces are not interesting
   int wikiId = atoi(data[page_id].c_str());
+  bool is_redir = data[page_is_redirect][0] == '1';
+  if (cache_) {
+    cache_->write_uint(wikiId);
+    cache_->write_uint(namespc);
+    cache_->write_uint(is_redir);
+    cache_->write_string(data[page_title]);
+  }
+  page(wikiId, namespc, is_redir, data[page_title]);
+}
+
+void PageHandler::cached_data(DumpCacheReader *cache) {
+  int wikiId = cache->read_uint();
+  int namespc = cache->read_uint();
+  bool is_redir = cache->read_uint();
+  cache->read_string(&title_);
+  page(wikiId, namespc, is_redir, title_);
+}
+
+void PageHandler::page(int wikiId, int namespc, bool is_redir,
+    const string &name) {
   assert(wikiId <= MAX_WIKI_PAGEID);
 
   const char *prefix;
@@ -252,7 +424,7 @@ void PageHandler::data(const vector<string> &data) {
     return;  // Other namespaces are not interesting
   }
 
-  string title = prefix + data[page_title];
+  string title = prefix + name;
 
   int graphId = -1;
   if (is_redir) {
@@ -268,6 +440,7 @@ void PageHandler::data(const vector<string> &data) {
     g_nodeIsCat[graphId] = node_is_cat;
     is_cat_->write_bit(node_is_cat);
     g_name2graphId[title] = graphId;
+    g_graph2wiki[graphId] = wikiId;
 #ifdef DEBUG
     printf("graph[%d] = %s (wikiId=%d)\n", graphId, title.c_str(), wikiId);
 #endif
@@ -281,16 +454,11 @@ void PageHandler::data(const vector<string> &data) {
     g_wikigraphId[wikiId] = graphId;
   }
   return;
-}  // DataHandler::data
-
-// mysql table 'page' for saving names
-void PageHandlerNames::data(const vector<string> &data) {
-  bool is_redir = data[page_is_redirect][0] == '1';
-  int namespc = atoi(data[page_namespace].c_str());
-
-  int wikiId = atoi(data[page_id].c_str());
-  assert(wikiId <= MAX_WIKI_PAGEID);
+}  // PageHandler::page
 
+// Saving names
+void PageHandlerNames::page(int wikiId, int namespc, bool is_redir,
+    const string &name) {
   const char *prefix;
   if (namespc == NS_MAIN) {  // Articles
     prefix = "a:";
@@ -300,14 +468,11 @@ void PageHandlerNames::data(const vector<string> &data) {
     return;  // Other namespaces are not interesting
   }
 
-  const char *title = data[page_title].c_str();
   if (!is_redir) {
     uint32_t graphId = g_wikigraphId[wikiId];
-    redisReply *reply;
-    reply = redisCmd(redis_, "SET n:%d %s%s", graphId, prefix, title);
-    freeReplyObject(reply);
+    names_->add_name(graphId, prefix, name);
   }
-}  // DataHandlerNames::data
+}  // PageHandlerNames::page
 
 }  // namespace stage1
 
@@ -317,7 +482,7 @@ void PageHandlerNames::data(const vector<string> &data) {
  */
 namespace stage2 {
 
-class RedirectHandler : public DataHandler {
+class RedirectHandler : public CachedDataHandler {
  private:
   // SQL schema
   enum Redirect {
@@ -326,67 +491,80 @@ class RedirectHandler : public DataHandler {
     rd_title = 2  // varbinary(255) NOT NULL DEFAULT '',
   };
   redisContext *redis_;
+  // Redirects pointing to another redirect: wikiId -> wikiId of target
+  dense_hash_map<int, int> redir_target_;
  public:
-  int unresolved_redir_count;
   explicit RedirectHandler(redisContext *redis)
   :redis_(redis) {
-    unresolved_redir_count = 0;
+    redir_target_.set_empty_key(0);
   }
   ~RedirectHandler() { }
   void init() { }
   void data(const vector<string> &data);
+  void cached_data(DumpCacheReader *cache);
+  // Redirect wikiId points to the page target (wikiId)
+  void redirect(int wikiId, int target);
+  void resolve_chains();
  private:
   DISALLOW_COPY_AND_ASSIGN(RedirectHandler);
 };
 
 class Stage2 : public Stage {
  public:
+  uint32_t depends_on() const {
+    return stage_bit(1);
+  }
+  bool modifies_tables() const {
+    return true;
+  }
   void main(redisContext *redis) {
-    // Can handle multiple redirects (up to 4 levels)
-    const int REDIR_MAX = 4;
+    g_info.unresolved_redirect_count = g_info.cyclic_redirect_count = 0;
     RedirectHandler data_handler(redis);
     data_handler.init();
 
-    const char *fname = DUMPFILES"redirect.sql";
-    const char *gzname = DUMPFILES"redirect.sql.gz";
+    g_info.redirect_signature = dump_signature("redirect",
+        g_info.page_signature);
+    read_dump("redirect", &data_handler, g_info.redirect_signature);
 
-    int iter = 0;
-    do {
-      data_handler.unresolved_redir_count = 0;
-
-      // Open redirect.sql
-      SystemFile file;
-      if (file.open(fname, "rb")) {
-        BufferedReader<char> reader(&file);
-        reader.set_print_progress(true);
-        SqlParser parser(&reader, &data_handler);
-        parser.run();
-        file.close();
-      } else {
-        GzipFile gzfile;
-        if (gzfile.open(gzname, "rb")) {
-          BufferedReader<char> reader(&gzfile);
-          reader.set_print_progress(true);
-          SqlParser parser(&reader, &data_handler);
-          parser.run();
-        } else {
-          fprintf(stderr, "failed to open file '%s' and '%s'\n", fname, gzname);
-        }
-        gzfile.close();
-      }
-      printf("Unresolved redirects: %d\n", data_handler.unresolved_redir_count);
-      iter++;
-    }
-    while (data_handler.unresolved_redir_count && iter < REDIR_MAX);
+    // Redirects to redirects are handled in memory, any depth is supported
+    data_handler.resolve_chains();
+    printf("Unresolved redirects: %d\n", g_info.unresolved_redirect_count);
+    printf("Cyclic redirects: %d\n", g_info.cyclic_redirect_count);
   }
   void finish(redisContext *redis) {
+    redisReply *reply;
+    reply = redisCmd(redis, "SET s:count:Unresolved_redirects %d",
+        g_info.unresolved_redirect_count);
+    freeReplyObject(reply);
+    reply = redisCmd(redis, "SET s:count:Cyclic_redirects %d",
+        g_info.cyclic_redirect_count);
+    freeReplyObject(reply);
   }
 };
+
+// Redirect wikiId points to a page graphId
+void resolve_redirect(int wikiId, int graphId) {
+  assert(graphId <= MAX_NODEID);
+
+  string prefix_hash = g_wiki2redirName[wikiId];
+  assert(prefix_hash.size() > 0);
+
+  assert(g_name2graphId.find(prefix_hash) == g_name2graphId.end());
+  g_name2graphId[prefix_hash] = graphId;
+
+  g_wikistatus[wikiId].type = WikiStatus::RESOLVED;  // Resolved redirect
+  g_wikigraphId[wikiId] = graphId;
+
+  // This key is no longer needed
+  g_wiki2redirName.erase(wikiId);
+  g_redirName2wiki.erase(prefix_hash);
+}
+
 // mysql table 'redirect'
 void RedirectHandler::data(const vector<string> &data) {
   int wikiId = atoi(data[rd_from].c_str());
   // Check is redirect was resolved previously
-  if (g_wikistatus[wikiId].type != 2)
+  if (g_wikistatus[wikiId].type != WikiStatus::REDIRECT)
     return;
   int namespc = atoi(data[rd_namespace].c_str());
 
@@ -403,38 +581,97 @@ void RedirectHandler::data(const vector<string> &data) {
 #ifdef DEBUG
   printf("(wikiId=%d) redirected to %s\n", wikiId, title.c_str());
 #endif
+  int target = title_wikiId(title);
+  if (cache_) {
+    cache_->write_uint(wikiId);
+    cache_->write_uint(target);
+  }
+  redirect(wikiId, target);
+}  // DataHandler::data
+
+void RedirectHandler::cached_data(DumpCacheReader *cache) {
+  int wikiId = cache->read_uint();
+  int target = cache->read_uint();
+  redirect(wikiId, target);
+}
 
-  if (g_redirName2wiki.find(title) != g_redirName2wiki.end()) {
-    // Target is still a redirect
+void RedirectHandler::redirect(int wikiId, int target) {
+  if (g_wikistatus[wikiId].type != WikiStatus::REDIRECT)
+    return;
+  if (target == 0) {
+    fprintf(stderr, "Inconsistency: Target of %s not found\n",
+        g_wiki2redirName[wikiId].c_str());
+    return;  // Nothing scary, mysqldump take time to perform,
+    // leaving dumps at potentially inconsistent state
+  }
+  if (g_wikistatus[target].type == WikiStatus::REDIRECT) {
+    // Target is still a redirect, it is resolved after all rows are read
 #ifdef DEBUG
-    printf("this is still a redirect %s (wikiId=%d)\n",
-        title.c_str(), g_redirName2wiki[title]);
+    printf("this is still a redirect (wikiId=%d)\n", target);
 #endif
-    unresolved_redir_count++;
+    redir_target_[wikiId] = target;
   } else {
     // Target is valid page (or resolved redirect)
-    int graphId = g_name2graphId[title];
-    if (graphId < 1) {
-      fprintf(stderr, "Inconsistency: Page not found %s\n", title.c_str());
-      return;  // Nothing scary, mysqldump take time to perform,
-      // leaving dumps at potentially inconsistent state
-    }
-    assert(graphId <= MAX_NODEID);
-
-    string prefix_hash = g_wiki2redirName[wikiId];
-    assert(prefix_hash.size() > 0);
-
-    assert(g_name2graphId.find(prefix_hash) == g_name2graphId.end());
-    g_name2graphId[prefix_hash] = graphId;
-
-    g_wikistatus[wikiId].type = WikiStatus::RESOLVED;  // Resolved redirect
-    g_wikigraphId[wikiId] = graphId;
+    resolve_redirect(wikiId, g_wikigraphId[target]);
+  }
+}
 
-    // This key is no longer needed
-    g_wiki2redirName.erase(wikiId);
-    g_redirName2wiki.erase(prefix_hash);
+// Follow each chain of redirects until a page is found. Every redirect on
+// the path is resolved at once (path compression), so each redirect is
+// visited only once.
+void RedirectHandler::resolve_chains() {
+  vector<int> path;
+  for (dense_hash_map<int, int>::iterator it = redir_target_.begin();
+      it != redir_target_.end(); ++it) {
+    if (g_wikistatus[it->first].type != WikiStatus::REDIRECT)
+      continue;  // Already resolved as a part of some other chain
+
+    path.clear();
+    int wikiId = it->first;
+    int graphId = 0;
+    bool cycle = false;
+    while (1) {
+      unsigned int type = g_wikistatus[wikiId].type;
+      if (type == WikiStatus::RESOLVED) {
+        graphId = g_wikigraphId[wikiId];
+        break;
+      }
+      if (type == WikiStatus::VISITING) {
+        cycle = true;
+        break;
+      }
+      if (type != WikiStatus::REDIRECT)
+        break;  // Chain leads to a broken redirect
+      dense_hash_map<int, int>::iterator next = redir_target_.find(wikiId);
+      if (next == redir_target_.end())
+        break;  // Target redirect does not have a valid row
+      g_wikistatus[wikiId].type = WikiStatus::VISITING;
+      path.push_back(wikiId);
+      wikiId = next->second;
+    }
+#ifdef DEBUG
+    printf("redirect chain of length %d from (wikiId=%d) graphId=%d\n",
+        static_cast<int>(path.size()), it->first, graphId);
+#endif
+    for (size_t i = 0; i < path.size(); i++) {
+      if (graphId) {
+        g_wikistatus[path[i]].type = WikiStatus::REDIRECT;
+        resolve_redirect(path[i], graphId);
+      } else {
+        g_wikistatus[path[i]].type = WikiStatus::BROKEN;
+      }
+    }
+    if (!graphId) {
+      // Only redirects from the first repeated one onward form the cycle,
+      // the ones leading into it are unresolved
+      size_t tail = path.size();
+      if (cycle)
+        tail = std::find(path.begin(), path.end(), wikiId) - path.begin();
+      g_info.unresolved_redirect_count += tail;
+      g_info.cyclic_redirect_count += path.size() - tail;
+    }
   }
-}  // DataHandler::data
+}
 
 }  // namespace stage2
 
@@ -444,7 +681,7 @@ void RedirectHandler::data(const vector<string> &data) {
  */
 namespace stage3 {
 
-class PageLinkHandler : public DataHandler {
+class PageLinkHandler : public CachedDataHandler {
  private:
   enum PageLinks {  // SQL schema
     pl_from = 0,  // int(8) unsigned NOT NULL DEFAULT '0',
@@ -456,8 +693,10 @@ class PageLinkHandler : public DataHandler {
   BufferedWriter *buff_writer_;
   SystemFile file_;
  public:
+  int links_count, skipped_catlinks, skipped_fromcat_links;
   explicit PageLinkHandler(redisContext *redis)
-  :redis_(redis) { }
+  :redis_(redis), links_count(0), skipped_catlinks(0),
+   skipped_fromcat_links(0) { }
   void init() {
     file_.open("artlinks.graph", "wb");
     buff_writer_ = new BufferedWriter(&file_);
@@ -469,42 +708,33 @@ class PageLinkHandler : public DataHandler {
     file_.close();
   }
   void data(const vector<string> &data);
+  void cached_data(DumpCacheReader *cache);
+  // Link from regular page wikiId to the page to_wikiId in namespace
+  void link(int wikiId, int namespc, int to_wikiId);
  private:
   DISALLOW_COPY_AND_ASSIGN(PageLinkHandler);
 };
 
 class Stage3 : public Stage {
  public:
+  uint32_t depends_on() const {
+    return stage_bit(2);
+  }
+  void outputs(vector<const char *> *files) const {
+    files->push_back("artlinks.graph");
+  }
   void main(redisContext *redis) {
-    g_info.article_links_count = 0;
-    g_info.skipped_catlinks = g_info.skipped_fromcat_links = 0;
-
     PageLinkHandler data_handler(redis);
     data_handler.init();
 
-    const char *fname = DUMPFILES"pagelinks.sql";
-    const char *gzname = DUMPFILES"pagelinks.sql.gz";
+    read_dump("pagelinks", &data_handler,
+        dump_signature("pagelinks", g_info.redirect_signature));
 
-    // Open pagelinks.sql
-    SystemFile file;
-    if (file.open(fname, "rb")) {
-      BufferedReader<char> reader(&file);
-      reader.set_print_progress(true);
-      SqlParser parser(&reader, &data_handler);
-      parser.run();
-      file.close();
-    } else {
-      GzipFile gzfile;
-      if (gzfile.open(gzname, "rb")) {
-        BufferedReader<char> reader(&gzfile);
-        reader.set_print_progress(true);
-        SqlParser parser(&reader, &data_handler);
-        parser.run();
-        gzfile.close();
-      } else {
-        fprintf(stderr, "failed to open file '%s' and '%s'\n", fname, gzname);
-      }
-    }
+    pthread_mutex_lock(&g_info_lock);
+    g_info.article_links_count = data_handler.links_count;
+    g_info.skipped_catlinks = data_handler.skipped_catlinks;
+    g_info.skipped_fromcat_links = data_handler.skipped_fromcat_links;
+    pthread_mutex_unlock(&g_info_lock);
   }
   void finish(redisContext *redis) {
     redisReply *reply;
@@ -521,7 +751,7 @@ class Stage3 : public Stage {
   }
 };
 
-// mysql table 'pagelink'
+// mysql table 'pagelink', only links from regular pages are cached
 void PageLinkHandler::data(const vector<string> &data) {
   int wikiId = atoi(data[pl_from].c_str());
 
@@ -529,50 +759,65 @@ void PageLinkHandler::data(const vector<string> &data) {
   if (g_wikistatus[wikiId].type != WikiStatus::REGULAR) {
     return;  // If it is not regular page skip it
   }
+  int namespc = atoi(data[pl_namespace].c_str());
+  // Only links to articles are needed
+  int to_wikiId = 0;
+  if (namespc == NS_MAIN)
+    to_wikiId = title_wikiId("a:" + data[pl_title]);
+  if (cache_) {
+    cache_->write_uint(wikiId);
+    cache_->write_uint(namespc);
+    cache_->write_uint(to_wikiId);
+  }
+  link(wikiId, namespc, to_wikiId);
+}  // DataHandler::data
+
+void PageLinkHandler::cached_data(DumpCacheReader *cache) {
+  int wikiId = cache->read_uint();
+  int namespc = cache->read_uint();
+  int to_wikiId = cache->read_uint();
+  link(wikiId, namespc, to_wikiId);
+}
+
+void PageLinkHandler::link(int wikiId, int namespc, int to_wikiId) {
   if (g_wikistatus[wikiId].is_category) {
-    g_info.skipped_fromcat_links++;
+    skipped_fromcat_links++;
     return;  // Skip links from categories
   }
   int from_graphId = g_wikigraphId[wikiId];
 
   graph_->start_node(from_graphId);
 
-  int namespc = atoi(data[pl_namespace].c_str());
-
-  const char *prefix;
-  if (namespc == NS_MAIN) {  // Articles
-    prefix = "a:";
-  } else if (namespc == NS_CATEGORY) {   // Categories
+  if (namespc == NS_CATEGORY) {
     // Links to categories are ignored
     // I only focus on inter-article links and category inclusion links
-    g_info.skipped_catlinks++;
+    skipped_catlinks++;
     return;
-  } else {
+  } else if (namespc != NS_MAIN) {
     return;  // Other namespaces are not interesting
   }
 
-  string title = prefix + data[pl_title];
-  int to_graphId = g_name2graphId[title];
+  int to_graphId = wiki_graphId(to_wikiId);
   if (to_graphId > 0 && !g_nodeIsCat[to_graphId]) {
 #ifdef DEBUG
-  printf("link from graphId=%d (wikiId=%d)  to=%s graphId=%d  type=%d\n",
-      from_graphId, wikiId, title.c_str(), to_graphId,
-      g_wikistatus[to_graphId].type);
+  printf("link from graphId=%d (wikiId=%d)  to graphId=%d (wikiId=%d)\n",
+      from_graphId, wikiId, to_graphId, to_wikiId);
 #endif
-    g_info.article_links_count++;
+    links_count++;
     graph_->add_edge(to_graphId);
   }
-}  // DataHandler::data
+}
 
 }  // namespace stage3
 
 /**************
  * STAGE 4
- * Genereate _forward_ edges in category inclusion links
+ * Genereate _forward_ edges in category inclusion links, they are kept in
+ * catlinks_fw.graph for the category hierarchy (see category.h)
  */
 namespace stage4 {
 
-class CategoryLinksHandler : public DataHandler {
+class CategoryLinksHandler : public CachedDataHandler {
   // SQL schema
   enum CategoryLinks {
     cl_from = 0,  // int(10) unsigned NOT NULL DEFAULT '0',
@@ -581,39 +826,52 @@ class CategoryLinksHandler : public DataHandler {
     cl_timestamp = 3  // timestamp NOT NULL DEFAULT CURRENT_TIMESTAMP,
   };
   redisContext *redis_;
-  GraphWriter *graph_;
-  BufferedWriter *buff_writer_;
+  BufferedWriter *pairs_;
   SystemFile file_;
-  bool exploreHidden_;
  public:
+  uint32_t num_pairs;
   explicit CategoryLinksHandler(redisContext *redis)
-  :redis_(redis), exploreHidden_(false) { }
+  :redis_(redis), pairs_(NULL), num_pairs(0) { }
   void init() {
-    file_.open("tmp_catlinks_fw.graph", "wb");
-    buff_writer_ = new BufferedWriter(&file_);
-    graph_ = new GraphBuffWriter(buff_writer_, g_info.graph_nodes_count);
+    file_.open("tmp_catlinks_pairs.bin", "wb");
+    pairs_ = new BufferedWriter(&file_);
   }
   ~CategoryLinksHandler() {
-    delete graph_;
-    delete buff_writer_;
-    file_.close();
+    close();
   }
-  void setExploreHidden(bool val) {
-    exploreHidden_ = val;
+  // All pairs are written to the file
+  void close() {
+    if (pairs_) {
+      delete pairs_;
+      file_.close();
+      pairs_ = NULL;
+    }
   }
   void data(const vector<string> &data);
+  void cached_data(DumpCacheReader *cache);
+  // Regular page wikiId belongs to the category to_wikiId
+  void link(int wikiId, int to_wikiId);
  private:
   DISALLOW_COPY_AND_ASSIGN(CategoryLinksHandler);
 };
 
 class Stage4 : public Stage {
  public:
+  uint32_t depends_on() const {
+    return stage_bit(2);
+  }
+  void outputs(vector<const char *> *files) const {
+    files->push_back("catlinks_fw.graph");
+  }
+  bool modifies_tables() const {  // g_nodeIsHidden
+    return true;
+  }
   void main(redisContext *redis) {
-    g_info.category_links_count = 0;
+    int links_count = 0;
     CategoryLinksHandler data_handler(redis);
     data_handler.init();
-    // In first pass we collect nodes that belong to hidden category
-    data_handler.setExploreHidden(true);
+    // While parsing we collect nodes that belong to hidden category, and
+    // links are saved as (from, to) pairs of graphIds.
     if (g_info.hidden_graphid) {
       g_nodeIsHidden[g_info.hidden_graphid] = true;
     }
@@ -621,33 +879,37 @@ class Stage4 : public Stage {
       g_nodeIsHidden[g_info.stub_graphid] = true;
     }
 
-    const char *fname = DUMPFILES"categorylinks.sql";
-    const char *gzname = DUMPFILES"categorylinks.sql.gz";
+    read_dump("categorylinks", &data_handler,
+        dump_signature("categorylinks", g_info.redirect_signature));
+    data_handler.close();
 
-    for (int i = 0; i < 2; i++) {
-      // Open categorylinks.sql
-      SystemFile file;
-      if (file.open(fname, "rb")) {
-        BufferedReader<char> reader(&file);
-        reader.set_print_progress(true);
-        SqlParser parser(&reader, &data_handler);
-        parser.run();
-        file.close();
-      } else {
-        GzipFile gzfile;
-        if (gzfile.open(gzname, "rb")) {
-          BufferedReader<char> reader(&gzfile);
-          reader.set_print_progress(true);
-          SqlParser parser(&reader, &data_handler);
-          parser.run();
-          gzfile.close();
-        } else {
-          fprintf(stderr, "failed to open file '%s' and '%s'\n", fname, gzname);
-        }
+    // Construct a graph, ignoring links to and from hidden nodes
+    SystemFile f_pairs;
+    f_pairs.open("tmp_catlinks_pairs.bin", "rb");
+    SystemFile f_out;
+    f_out.open("catlinks_fw.graph", "wb");
+    if (1) {  // Destroy objects before closing files
+      BufferedReader<uint32_t> reader(&f_pairs);
+      BufferedWriter writer(&f_out);
+      GraphBuffWriter graph(&writer, g_info.graph_nodes_count);
+      for (uint32_t i = 0; i < data_handler.num_pairs; i++) {
+        node_t from_graphId = reader.read_unit();
+        node_t to_graphId = reader.read_unit();
+        if (g_nodeIsHidden[from_graphId] || g_nodeIsHidden[to_graphId])
+          continue;
+        // Construct edges to and from non-hidden nodes
+        links_count++;
+        graph.start_node(from_graphId);
+        graph.add_edge(to_graphId);
       }
-      data_handler.setExploreHidden(false);
-      // In second pass we ignore links to and from hidden nodes
     }
+    f_out.close();
+    f_pairs.close();
+    unlink("tmp_catlinks_pairs.bin");
+
+    pthread_mutex_lock(&g_info_lock);
+    g_info.category_links_count = links_count;
+    pthread_mutex_unlock(&g_info_lock);
   }
   void finish(redisContext *redis) {
     redisReply *reply;
@@ -657,51 +919,49 @@ class Stage4 : public Stage {
   }
 };
 
-// mysql table 'categorylinks'
+// mysql table 'categorylinks', only links from regular pages are cached
 void CategoryLinksHandler::data(const vector<string> &data) {
   int wikiId = atoi(data[cl_from].c_str());
   // If it is not regular page skip it
   if (g_wikistatus[wikiId].type != WikiStatus::REGULAR)
     return;
-  int from_graphId = g_wikigraphId[wikiId];
-
-  if (!exploreHidden_) {
-    // We actually want to construct a cat graph
-    graph_->start_node(from_graphId);
-    if (g_nodeIsHidden[from_graphId])
-      return;
+  // target is always a category
+  int to_wikiId = title_wikiId("c:" + data[cl_to]);
+  if (cache_) {
+    cache_->write_uint(wikiId);
+    cache_->write_uint(to_wikiId);
   }
+  link(wikiId, to_wikiId);
+}  // DataHandler::data
 
-  const char *prefix = "c:";  // target is always a category
-
-  string title = prefix + data[cl_to];
+void CategoryLinksHandler::cached_data(DumpCacheReader *cache) {
+  int wikiId = cache->read_uint();
+  int to_wikiId = cache->read_uint();
+  link(wikiId, to_wikiId);
+}
 
-  int to_graphId = g_name2graphId[title];
+void CategoryLinksHandler::link(int wikiId, int to_wikiId) {
+  int from_graphId = g_wikigraphId[wikiId];
+  int to_graphId = wiki_graphId(to_wikiId);
 
   if (to_graphId > 0) {
 #ifdef DEBUG
-  printf("categorylink: graphId=%d (wikiId=%d)  to=%s graphId=%d  type=%d\n",
-    from_graphId, wikiId, title.c_str(), to_graphId,
-    g_wikistatus[to_graphId].type);
+  printf("categorylink: graphId=%d (wikiId=%d)  to graphId=%d (wikiId=%d)\n",
+    from_graphId, wikiId, to_graphId, to_wikiId);
 #endif
-    if (exploreHidden_) {
-      // Just mark all neighbours of hidden node
-      if (from_graphId == g_info.hidden_graphid
-          || to_graphId == g_info.hidden_graphid
-          || from_graphId == g_info.stub_graphid
-          || to_graphId == g_info.stub_graphid) {
-        g_nodeIsHidden[from_graphId] = true;
-        g_nodeIsHidden[to_graphId] = true;
-      }
-    } else {
-      if (g_nodeIsHidden[to_graphId])
-        return;
-      // Construct edges to and from non-hidden nodes
-      g_info.category_links_count++;
-      graph_->add_edge(to_graphId);
+    // Mark all neighbours of hidden node
+    if (from_graphId == g_info.hidden_graphid
+        || to_graphId == g_info.hidden_graphid
+        || from_graphId == g_info.stub_graphid
+        || to_graphId == g_info.stub_graphid) {
+      g_nodeIsHidden[from_graphId] = true;
+      g_nodeIsHidden[to_graphId] = true;
     }
+    pairs_->write_uint(from_graphId);
+    pairs_->write_uint(to_graphId);
+    num_pairs++;
   }
-}  // DataHandler::data
+}
 
 }  // namespace stage4
 
@@ -714,6 +974,12 @@ namespace stage5 {
 
 class Stage5 : public Stage {
  public:
+  uint32_t depends_on() const {
+    return stage_bit(4);
+  }
+  void outputs(vector<const char *> *files) const {
+    files->push_back("tmp_catlinks_bw.graph");
+  }
   void main(redisContext *redis) {
     // Setup output graph
     SystemFile f_out;
@@ -728,7 +994,7 @@ class Stage5 : public Stage {
       for (int pass = 1; nodes < last_node; pass++) {
         // Open graph with forward links
         SystemFile f_in;
-        f_in.open("tmp_catlinks_fw.graph", "rb");
+        f_in.open("catlinks_fw.graph", "rb");
         BufferedReader<uint32_t> reader(&f_in);
         reader.set_print_progress(true);
         StreamGraphReader graph_in(&reader);
@@ -761,10 +1027,16 @@ namespace stage6 {
 
 class Stage6 : public Stage {
  public:
+  uint32_t depends_on() const {
+    return stage_bit(5);
+  }
+  void outputs(vector<const char *> *files) const {
+    files->push_back("catlinks.graph");
+  }
   void main(redisContext *redis) {
     // Open graph with forward links
     SystemFile f_in1;
-    f_in1.open("tmp_catlinks_fw.graph", "rb");
+    f_in1.open("catlinks_fw.graph", "rb");
     BufferedReader<uint32_t> reader1(&f_in1);
     StreamGraphReader graph_in1(&reader1);
     graph_in1.init();
@@ -797,9 +1069,422 @@ class Stage6 : public Stage {
 
 }  // namespace stage6
 
+/**************
+ * CHECKPOINTS
+ * After each stage gen_graph.ckpt records which stages are done, g_info
+ * and checksums of files produced so far. Stages which modify global
+ * tables also save them to gen_graph_tables<stage>.bin, so that the run
+ * can be resumed after any stage. Both use the format of dump caches with
+ * the signature of all dumps, new dumps invalidate the checkpoint.
+ */
+namespace checkpoint {
+
+const char *kCheckpointFile = "gen_graph.ckpt";
+const uint32_t kCheckpointFormat = 3;
+
+struct OutputFile {
+  string name;
+  int stage;  // which produced it
+  uint32_t signature;  // see file_signature
+};
+
+struct Checkpoint {
+  uint32_t signature;  // of all dumps
+  uint32_t done;  // set of completed stages, see stage_bit
+  WikiGraphInfo info;
+  vector<OutputFile> files;
+};
+
+uint32_t dumps_signature() {
+  uint32_t signature = kCheckpointFormat + sizeof(WikiGraphInfo);
+  signature = dump_signature("page", signature);
+  signature = dump_signature("redirect", signature);
+  signature = dump_signature("pagelinks", signature);
+  signature = dump_signature("categorylinks", signature);
+  return signature;
+}
+
+// Write to a temporary file first, so that an interrupted write does not
+// destroy the previous checkpoint.
+void commit(const string &fname) {
+  rename((fname + ".tmp").c_str(), fname.c_str());
+}
+
+string tables_file(int stage) {
+  char fname[50];
+  snprintf(fname, sizeof(fname), "gen_graph_tables%d.bin", stage);
+  return fname;
+}
+
+// Files are identified by size and modification time like the dumps, so
+// that resuming does not have to read all of them.
+bool describe(const char *fname, int stage, OutputFile *out) {
+  out->name = fname;
+  out->stage = stage;
+  out->signature = file_signature(fname, kCheckpointFormat);
+  return out->signature != 0;
+}
+
+bool verify(const OutputFile &file) {
+  return file_signature(file.name.c_str(), kCheckpointFormat)
+      == file.signature;
+}
+
+void save(const Checkpoint &ckpt) {
+  string tmpname = string(kCheckpointFile) + ".tmp";
+  SystemFile f;
+  if (!f.open(tmpname.c_str(), "wb")) {
+    perror("can not write checkpoint");
+    return;
+  }
+  if (1) {  // Destroy writer before closing the file
+    DumpCacheWriter w(&f);
+    w.write_uint(ckpt.done);
+    w.write_bytes(&ckpt.info, sizeof(ckpt.info));
+    w.write_uint(ckpt.files.size());
+    for (size_t i = 0; i < ckpt.files.size(); i++) {
+      w.write_string(ckpt.files[i].name);
+      w.write_uint(ckpt.files[i].stage);
+      w.write_uint(ckpt.files[i].signature);
+    }
+    w.finish(ckpt.signature);
+  }
+  f.close();
+  commit(kCheckpointFile);
+}
+
+bool load(Checkpoint *ckpt) {
+  SystemFile f;
+  if (!f.open(kCheckpointFile, "rb"))
+    return false;
+  bool valid;
+  if (1) {  // Destroy reader before closing the file
+    DumpCacheReader r(&f);
+    valid = r.init(ckpt->signature);
+    if (valid) {
+      ckpt->done = r.read_uint();
+      r.read_bytes(&ckpt->info, sizeof(ckpt->info));
+      ckpt->files.resize(r.read_uint());
+      for (size_t i = 0; i < ckpt->files.size(); i++) {
+        r.read_string(&ckpt->files[i].name);
+        ckpt->files[i].stage = r.read_uint();
+        ckpt->files[i].signature = r.read_uint();
+      }
+    }
+  }
+  f.close();
+  return valid;
+}
+
+// Global tables after the stage
+void save_tables(int stage, uint32_t signature) {
+  string fname = tables_file(stage);
+  SystemFile f;
+  if (!f.open((fname + ".tmp").c_str(), "wb")) {
+    perror("can not write tables");
+    return;
+  }
+  if (1) {  // Destroy writer before closing the file
+    DumpCacheWriter w(&f);
+    uint32_t wiki_count = MAX_WIKI_PAGEID + 1;
+    while (wiki_count > 0 && g_wikistatus[wiki_count - 1].type == 0)
+      wiki_count--;
+    w.write_uint(wiki_count);
+    w.write_bytes(g_wikistatus, sizeof(g_wikistatus[0]) * wiki_count);
+    w.write_bytes(g_wikigraphId, sizeof(g_wikigraphId[0]) * wiki_count);
+
+    uint32_t node_count = g_info.graph_nodes_count + 1;
+    w.write_uint(node_count);
+    w.write_bytes(g_graph2wiki, sizeof(g_graph2wiki[0]) * node_count);
+    w.write_bytes(g_nodeIsCat, sizeof(g_nodeIsCat[0]) * node_count);
+    w.write_bytes(g_nodeIsHidden, sizeof(g_nodeIsHidden[0]) * node_count);
+
+    w.write_uint(g_redirName2wiki.size());
+    for (dense_hash_map<string, int, FVNHash>::const_iterator it =
+        g_redirName2wiki.begin(); it != g_redirName2wiki.end(); ++it) {
+      w.write_string(it->first);
+      w.write_uint(it->second);
+    }
+    w.write_uint(g_name2graphId.size());
+    for (dense_hash_map<string, int, FVNHash>::const_iterator it =
+        g_name2graphId.begin(); it != g_name2graphId.end(); ++it) {
+      w.write_string(it->first);
+      w.write_uint(it->second);
+    }
+    w.write_uint(g_wiki2redirName.size());
+    for (dense_hash_map<int, string>::const_iterator it =
+        g_wiki2redirName.begin(); it != g_wiki2redirName.end(); ++it) {
+      w.write_uint(it->first);
+      w.write_string(it->second);
+    }
+    w.finish(signature);
+  }
+  f.close();
+  commit(fname);
+}
+
+bool load_tables(int stage, uint32_t signature) {
+  string fname = tables_file(stage);
+  SystemFile f;
+  if (!f.open(fname.c_str(), "rb"))
+    return false;
+  bool valid;
+  if (1) {  // Destroy reader before closing the file
+    DumpCacheReader r(&f);
+    valid = r.init(signature);
+    if (valid) {
+      printf("Reading '%s'\n", fname.c_str());
+      r.set_print_progress(true);
+      uint32_t wiki_count = r.read_uint();
+      assert(wiki_count <= MAX_WIKI_PAGEID + 1);
+      r.read_bytes(g_wikistatus, sizeof(g_wikistatus[0]) * wiki_count);
+      r.read_bytes(g_wikigraphId, sizeof(g_wikigraphId[0]) * wiki_count);
+
+      uint32_t node_count = r.read_uint();
+      assert(node_count <= MAX_NODEID);
+      r.read_bytes(g_graph2wiki, sizeof(g_graph2wiki[0]) * node_count);
+      r.read_bytes(g_nodeIsCat, sizeof(g_nodeIsCat[0]) * node_count);
+      r.read_bytes(g_nodeIsHidden, sizeof(g_nodeIsHidden[0]) * node_count);
+
+      string name;
+      g_redirName2wiki.clear();
+      for (uint32_t i = r.read_uint(); i > 0; i--) {
+        r.read_string(&name);
+        g_redirName2wiki[name] = r.read_uint();
+      }
+      g_name2graphId.clear();
+      for (uint32_t i = r.read_uint(); i > 0; i--) {
+        r.read_string(&name);
+        g_name2graphId[name] = r.read_uint();
+      }
+      g_wiki2redirName.clear();
+      for (uint32_t i = r.read_uint(); i > 0; i--) {
+        int wikiId = r.read_uint();
+        r.read_string(&g_wiki2redirName[wikiId]);
+      }
+    }
+  }
+  f.close();
+  return valid;
+}
+
+// Find stages which are done and don't have to be run again, returns
+// false on error. Global tables and g_info are restored to the state after
+// these stages. from_stage is 1-based, stages from it onwards are run again,
+// 0 means to resume the last run.
+bool resume(Checkpoint *ckpt, const vector<Stage*> &stages, int from_stage) {
+  ckpt->signature = dumps_signature();
+  if (!load(ckpt)) {
+    ckpt->done = 0;
+    ckpt->files.clear();
+  }
+  uint32_t all = 0;
+  for (size_t i = 0; i < stages.size(); i++)
+    all |= stage_bit(i + 1);
+  uint32_t done = ckpt->done;
+  if (from_stage) {
+    uint32_t before = stage_bit(from_stage) - stage_bit(1);
+    if ((done & before) != before) {
+      fprintf(stderr, "Can not start from stage %d, previous stages are not "
+          "completed with current dumps\n", from_stage);
+      return false;
+    }
+    done &= before;
+  }
+  // Stage is run again if its file is missing or changed, or if a stage it
+  // depends on is run again. Temporary files are only needed while there
+  // are stages left to run.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t i = 0; i < ckpt->files.size(); i++) {
+      const OutputFile &file = ckpt->files[i];
+      if (!(done & stage_bit(file.stage)))
+        continue;
+      if (done == all && file.name.compare(0, 4, "tmp_") == 0)
+        continue;
+      if (!verify(file)) {
+        printf("File '%s' has changed\n", file.name.c_str());
+        done &= ~stage_bit(file.stage);
+        changed = true;
+      }
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+      if ((done & stage_bit(i + 1)) && (stages[i]->depends_on() & ~done)) {
+        done &= ~stage_bit(i + 1);
+        changed = true;
+      }
+    }
+  }
+  // Stages which modify tables form a chain, restore the tables from the
+  // last of them
+  int tables_stage = 0;
+  for (size_t i = 0; i < stages.size(); i++) {
+    if ((done & stage_bit(i + 1)) && stages[i]->modifies_tables())
+      tables_stage = i + 1;
+  }
+  if (tables_stage && !load_tables(tables_stage, ckpt->signature)) {
+    printf("Tables after stage %d are not available\n", tables_stage);
+    done = 0;
+  }
+  if (done) {
+    g_info = ckpt->info;
+    printf("Resuming, completed stages:");
+    for (size_t i = 0; i < stages.size(); i++) {
+      if (done & stage_bit(i + 1))
+        printf(" %d", static_cast<int>(i + 1));
+    }
+    printf("\n");
+  }
+  // Forget stages which will be run again
+  vector<OutputFile> files;
+  for (size_t i = 0; i < ckpt->files.size(); i++) {
+    if (done & stage_bit(ckpt->files[i].stage))
+      files.push_back(ckpt->files[i]);
+  }
+  ckpt->files.swap(files);
+  ckpt->done = done;
+  return true;
+}
+
+// Record that the stage is done
+void stage_done(Checkpoint *ckpt, Stage *stage, int number) {
+  ckpt->done |= stage_bit(number);
+  if (stage->modifies_tables())
+    save_tables(number, ckpt->signature);
+  vector<const char *> outputs;
+  stage->outputs(&outputs);
+  for (size_t i = 0; i < outputs.size(); i++) {
+    OutputFile file;
+    if (describe(outputs[i], number, &file))
+      ckpt->files.push_back(file);
+  }
+  pthread_mutex_lock(&g_info_lock);
+  ckpt->info = g_info;
+  pthread_mutex_unlock(&g_info_lock);
+  save(*ckpt);
+}
+
+}  // namespace checkpoint
+
+/**************
+ * SCHEDULER
+ * Each stage is started in its own thread as soon as the stages it depends
+ * on are done. Stage3 and the category graph (Stage4, Stage5, Stage6) only
+ * read the tables built by Stage1 and Stage2, so they run in parallel.
+ */
+class StageScheduler {
+ public:
+  StageScheduler(const vector<Stage*> &stages, redisContext *redis,
+      checkpoint::Checkpoint *ckpt)
+  : stages_(stages), redis_(redis), ckpt_(ckpt), done_(ckpt->done) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&cond_, NULL);
+  }
+  ~StageScheduler() {
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&mutex_);
+  }
+  // Run all stages which are not done yet
+  void run() {
+    uint32_t all = 0;
+    for (size_t i = 0; i < stages_.size(); i++)
+      all |= stage_bit(i + 1);
+
+    vector<Task> tasks(stages_.size());
+    vector<pthread_t> threads;
+    pthread_mutex_lock(&mutex_);
+    uint32_t started = done_;
+    while (done_ != all) {
+      for (size_t i = 0; i < stages_.size(); i++) {
+        if ((started & stage_bit(i + 1))
+            || (stages_[i]->depends_on() & ~done_))
+          continue;
+        started |= stage_bit(i + 1);
+        printf("Starting stage %d\n", static_cast<int>(i + 1));
+        tasks[i].scheduler = this;
+        tasks[i].number = i + 1;
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, run_stage, &tasks[i])) {
+          perror("pthread_create");
+          exit(1);
+        }
+        threads.push_back(thread);
+      }
+      pthread_cond_wait(&cond_, &mutex_);
+    }
+    pthread_mutex_unlock(&mutex_);
+    for (size_t i = 0; i < threads.size(); i++)
+      pthread_join(threads[i], NULL);
+  }
+ private:
+  struct Task {
+    StageScheduler *scheduler;
+    int number;
+  };
+  static void *run_stage(void *arg) {
+    Task *task = reinterpret_cast<Task*>(arg);
+    StageScheduler *self = task->scheduler;
+    Stage *stage = self->stages_[task->number - 1];
+    stage->main(self->redis_);
+
+    pthread_mutex_lock(&self->mutex_);
+    printf("Finished stage %d\n", task->number);
+    checkpoint::stage_done(self->ckpt_, stage, task->number);
+    self->done_ |= stage_bit(task->number);
+    pthread_cond_signal(&self->cond_);
+    pthread_mutex_unlock(&self->mutex_);
+    return NULL;
+  }
+
+  const vector<Stage*> &stages_;
+  redisContext *redis_;
+  checkpoint::Checkpoint *ckpt_;
+  uint32_t done_;  // guarded by mutex_
+  pthread_mutex_t mutex_;
+  pthread_cond_t cond_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(StageScheduler);
+};
+
 }  // namespace wikigraph
 
+void print_help(const char *prog) {
+  printf("Usage: %s [options]\n", prog);
+  printf(" -s, --from-stage N  Run stages from N (1-6) onwards, by default\n");
+  printf("                     the last run is resumed\n");
+  printf(" -h, --help          Print this help\n");
+}
+
 int main(int argc, char *argv[]) {
+  int from_stage = 0;
+  static struct option long_options[] = {
+    {"from-stage", required_argument, 0, 's'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+  };
+  while (1) {
+    int option = getopt_long(argc, argv, "s:h", long_options, NULL);
+    if (option == -1)
+      break;
+    switch (option) {
+      case 's':
+        from_stage = atoi(optarg);
+      break;
+      case 'h':
+        print_help(argv[0]);
+        return 0;
+      break;
+      default:
+        print_help(argv[0]);
+        return 1;
+    }
+  }
+  if (argc != optind || from_stage < 0 || from_stage > 6) {
+    print_help(argv[0]);
+    return 1;
+  }
+
   wikigraph::g_name2graphId.set_empty_key("");
   wikigraph::g_redirName2wiki.set_empty_key("");
   wikigraph::g_redirName2wiki.set_deleted_key("~__deleted_key__~");
@@ -838,10 +1523,14 @@ int main(int argc, char *argv[]) {
   stages.push_back(new wikigraph::stage5::Stage5());
   stages.push_back(new wikigraph::stage6::Stage6());
 
+  wikigraph::checkpoint::Checkpoint ckpt;
+  if (!wikigraph::checkpoint::resume(&ckpt, stages, from_stage))
+    return 1;
+
   // Run though stages
-  for (size_t i = 0; i < stages.size(); i++) {
-    printf("Starting stage %d\n", i+1);
-    stages[i]->main(redis);
+  if (1) {
+    wikigraph::StageScheduler scheduler(stages, redis, &ckpt);
+    scheduler.run();
   }
 
   printf("Finalizing.\n");
@@ -15,7 +15,23 @@
 #include <climits>
 #include <cmath>
 
+#include "category.h"
+#include "centrality.h"
+#include "communities.h"
 #include "graph.h"
+#include "hits.h"
+#include "kcore.h"
+#include "landmarks.h"
+#include "node_array.h"
+#include "pagerank.h"
+#include "parallel.h"
+#include "pll.h"
+#include "ppr.h"
+#include "diameter.h"
+#include "scc.h"
+#include "topk_closeness.h"
+#include "triangles.h"
+#include "wcc.h"
 
 namespace wikigraph {
 
@@ -23,15 +39,35 @@ class CompleteGraphAlgo {
   static const int DIST_ARRAY = 100;  // threshold to use array for distances
  public:
   explicit CompleteGraphAlgo(File *file)
-  : file_(file), invalid_node_(NULL), queue_(NULL) {
+  : file_(file), invalid_node_(NULL), map_size_(0), queue_(NULL),
+    checksum_(0), scc_(NULL), scc_size_(NULL), wcc_(NULL),
+    wcc_size_(NULL), diameter_(NULL), symmetric_(false), core_(NULL),
+    triangles_(NULL), ppr_(NULL), ranks_(NULL), start_ranks_(NULL),
+    num_iterations_(0), hubs_(NULL), authorities_(NULL), hierarchy_(NULL),
+    landmarks_(NULL), bidirectional_(NULL), labeling_(NULL),
+    community_(NULL), community_size_(NULL), workspaces_(NULL) {
     graph_.list = NULL;
     graph_.edges = NULL;
+    reverse_.list = NULL;
+    reverse_.edges = NULL;
+    undirected_.list = NULL;
+    undirected_.edges = NULL;
   }
 
   CompleteGraphAlgo(File *file, BitArray *valid_node)
-  : file_(file), invalid_node_(valid_node), queue_(NULL) {
+  : file_(file), invalid_node_(valid_node), map_size_(0), queue_(NULL),
+    checksum_(0), scc_(NULL), scc_size_(NULL), wcc_(NULL),
+    wcc_size_(NULL), diameter_(NULL), symmetric_(false), core_(NULL),
+    triangles_(NULL), ppr_(NULL), ranks_(NULL), start_ranks_(NULL),
+    num_iterations_(0), hubs_(NULL), authorities_(NULL), hierarchy_(NULL),
+    landmarks_(NULL), bidirectional_(NULL), labeling_(NULL),
+    community_(NULL), community_size_(NULL), workspaces_(NULL) {
     graph_.list = NULL;
     graph_.edges = NULL;
+    reverse_.list = NULL;
+    reverse_.edges = NULL;
+    undirected_.list = NULL;
+    undirected_.edges = NULL;
   }
 
   void Init(bool mMap) {
@@ -55,8 +91,8 @@ class CompleteGraphAlgo {
         graph_.list = new uint32_t[ graph_.num_nodes + 2 ];
         file_->read(graph_.list, sizeof(uint32_t), graph_.num_nodes + 2);
     } else {
-        void *edges = ::mmap(NULL,
-            (graph_.num_edges + graph_.num_nodes + 2)*sizeof(uint32_t),
+        map_size_ = (graph_.num_edges + graph_.num_nodes + 2)*sizeof(uint32_t);
+        void *edges = ::mmap(NULL, map_size_,
             PROT_READ, MAP_SHARED, file_->fdno(), 0);
 
         if (edges == MAP_FAILED) {
@@ -75,14 +111,39 @@ class CompleteGraphAlgo {
   }
 
   ~CompleteGraphAlgo() {
-    if (graph_.edges)
-      delete[] graph_.edges;
-    if (graph_.list)
-      delete[] graph_.list;
+    if (map_size_) {
+      ::munmap(graph_.edges, map_size_);
+    } else {
+      if (graph_.edges)
+        delete[] graph_.edges;
+      if (graph_.list)
+        delete[] graph_.list;
+    }
     if (queue_) {
       delete[] queue_;
       delete[] dist_;
     }
+    reverse_.release();
+    delete[] scc_;
+    delete[] scc_size_;
+    delete[] wcc_;
+    delete[] wcc_size_;
+    delete diameter_;
+    undirected_.release();
+    delete[] core_;
+    delete[] triangles_;
+    delete ppr_;
+    delete[] ranks_;
+    delete[] start_ranks_;
+    delete[] hubs_;
+    delete[] authorities_;
+    delete hierarchy_;
+    delete landmarks_;
+    delete bidirectional_;
+    delete labeling_;
+    delete[] community_;
+    delete[] community_size_;
+    delete workspaces_;
   }
 
   vector<uint32_t> GetDistances(node_t start) {
@@ -135,174 +196,544 @@ class CompleteGraphAlgo {
     return result;
   }
 
-  vector<uint32_t> Scc() {  // Tarjan
-    int tindex = 1;
-    int top = -1;
-    int top_scc = -1;
-    const int MAXNODES = graph_.num_nodes + 2;
-    const int num_nodes = graph_.num_nodes;
-
-    int32_t *lowindex = dist_;  // reuse some memory
-    int32_t *nodeindex = new int32_t[MAXNODES];
-    memset(nodeindex, -1, 4 * (MAXNODES));
-    int8_t *instack = new int8_t[MAXNODES];
-    memset(instack, 0, MAXNODES);
-    int32_t *stackI = new int32_t[MAXNODES];
-    memset(stackI, 0, MAXNODES);
-    int32_t *stacknode = new int32_t[MAXNODES];
-    memset(stacknode, 0, MAXNODES);
-    node_t *stack = queue_;  // reuse some memory
-
-    vector<uint32_t> scc_result;
-
-    for (int k = 1; k <= num_nodes; k++) {
-#ifdef DEBUG
-      printf("processing node %d\n", k);
-#endif
-      if (invalid_node_ && invalid_node_->get_value(k))
-        continue;
+  // Counts of distances from every source, as GetDistances(source), BFS of
+  // the sources are divided among all threads
+  void GetDistances(const vector<node_t> &sources,
+      vector<vector<uint32_t> > *counts) {
+    if (!workspaces_ || workspaces_->size() != NumThreads()) {
+      delete workspaces_;
+      workspaces_ = new BfsWorkspaces(graph_.num_nodes);
+    }
+    counts->assign(sources.size(), vector<uint32_t>());
+    CountDistances body;
+    body.graph = &graph_;
+    body.sources = &sources;
+    body.counts = counts;
+    body.workspaces = workspaces_;
+    ParallelTasks(sources.size(), &body);
+  }
 
-      // This node should not be previously visited /*and not be a category*/
-      if (nodeindex[k] == -1  /* && !IS_CATEGORY(k)*/) {
-        // Push to execution stack
-        stacknode[++top] = k;
-        stackI[top] = -1;
-
-        // Process stack
-        while (top >= 0) {
-          int node = stacknode[top];
-          int &i = stackI[top];
-
-          if (i == -1) {  // Uninitialized
-            // Initialize the node
-            nodeindex[node] = tindex++;
-            lowindex[node] = nodeindex[node];
-
-            stack[++top_scc] = node;
-            instack[node] = true;
-            i = graph_.start(node);  // node_begin_list[node];
-          } else if (i < graph_.end(node)) {  // node_end_list(node)) {
-            // New location of REF1 (see bellow)
-            int dest = graph_.edges[i];
-            lowindex[node] = std::min(lowindex[node], lowindex[dest]);
-            i++;
-          }
-          for ( ; i < graph_.end(node) /* node_end_list(node) */; i++) {
-            int dest = graph_.edges[i];
-            if (nodeindex[dest] == -1) {  // Not visited
-              // Push dest to execution stack
-              stacknode[++top] = dest;
-              stackI[top] = -1;
-              break;  // Original REF1 code
-            } else if (instack[dest]) {  // does belongs to this component
-              lowindex[node] = std::min(lowindex[node], lowindex[dest]);
-            }
-          }
-          if (i == graph_.end(node)) {  // node_end_list(node)) {
-            if (lowindex[node] == nodeindex[node]) {
-              // We found one component
-              int count = 0;
-#ifdef DEBUG
-              printf("Component:[");
-#endif
-              int sccnode;
-              do {
-                sccnode = stack[top_scc--];
-                instack[sccnode] = false;
-                count++;
-#ifdef DEBUG
-                printf(" %d", sccnode);
-#endif
-              } while (sccnode != node);
-#ifdef DEBUG
-              printf(" ]\n");
-#endif
-              scc_result.push_back(count);
-            }
-            // Remove node from execution stack
-            top--;
-          }
-        }
-        assert(top_scc == -1);
-      }
+  // Sizes of strongly connected components, in order of their labels
+  vector<uint32_t> Scc() {
+    SccLabels();
+    return ComponentSizes(scc_, scc_size_);
+  }
+
+  // Strongly connected component of every node, labeled by the smallest
+  // node in it (0 for invalid nodes). Computed on first use.
+  const uint32_t *SccLabels() {
+    if (!scc_) {
+      scc_ = new uint32_t[graph_.num_nodes + 1];
+      SccSolver solver(&graph_, Reverse(), invalid_node_);
+      solver.Run(scc_);
+      scc_size_ = CountSizes(scc_);
     }
-    // free(lowindex);
-    free(nodeindex);
-    free(instack);
-    free(stackI);
-    free(stacknode);
-    // free(stack);
+    return scc_;
+  }
 
-    // return util::count_items(scc_result);
-    return scc_result;
+  // Number of nodes in the component of node
+  uint32_t SccSize(node_t node) {
+    SccLabels();
+    return scc_[node] ? scc_size_[scc_[node]] : 0;
   }
 
-  vector<pair<double, node_t> > PageRank(uint32_t how_many, bool verbose) {
-    double *rank1 = new double[graph_.num_nodes + 2];
-    double *rank2 = new double[graph_.num_nodes + 2];
+  // Labels can be saved next to the graph file, see node_array.h
+  bool LoadSccLabels(const string &fname) {
+    return LoadLabels(fname, &scc_, &scc_size_);
+  }
 
-    uint32_t N = 0u;
+  bool SaveSccLabels(const string &fname) {
+    return SaveNodeArray(fname, SccLabels(), graph_.num_nodes, Checksum());
+  }
+
+  bool HasSccLabels() const {
+    return scc_ != NULL;
+  }
+
+  // Label of the largest strongly connected component
+  uint32_t LargestScc() {
+    SccLabels();
+    uint32_t largest = 0;
     for (node_t node = 1; node <= graph_.num_nodes; node++) {
-      if (invalid_node_ && invalid_node_->get_value(node))
-        continue;
+      if (scc_[node] == node && (!largest
+            || scc_size_[node] > scc_size_[largest]))
+        largest = node;
+    }
+    return largest;
+  }
+
+  // Diameter of the largest strongly connected component and bounds on
+  // eccentricity of its nodes, computed on first use
+  DiameterSolver *Diameter() {
+    if (!diameter_) {
+      diameter_ = new DiameterSolver(&graph_, Reverse(), SccLabels(),
+          LargestScc());
+      diameter_->Run();
+    }
+    return diameter_;
+  }
+
+  // Sizes of weakly connected components, in order of their labels
+  vector<uint32_t> Wcc() {
+    WccLabels();
+    return ComponentSizes(wcc_, wcc_size_);
+  }
+
+  // Weakly connected component of every node, labeled by the smallest
+  // node in it (0 for invalid nodes). Computed on first use.
+  const uint32_t *WccLabels() {
+    if (!wcc_) {
+      wcc_ = new uint32_t[graph_.num_nodes + 1];
+      WccSolver solver(&graph_, invalid_node_);
+      solver.Run(wcc_);
+      wcc_size_ = CountSizes(wcc_);
+    }
+    return wcc_;
+  }
+
+  uint32_t WccSize(node_t node) {
+    WccLabels();
+    return wcc_[node] ? wcc_size_[wcc_[node]] : 0;
+  }
+
+  bool LoadWccLabels(const string &fname) {
+    return LoadLabels(fname, &wcc_, &wcc_size_);
+  }
+
+  bool SaveWccLabels(const string &fname) {
+    return SaveNodeArray(fname, WccLabels(), graph_.num_nodes, Checksum());
+  }
+
+  bool HasWccLabels() const {
+    return wcc_ != NULL;
+  }
+
+  // Graph with all edges reversed, built on first use
+  Graph *Reverse() {
+    if (!reverse_.list)
+      BuildReverse();
+    return &reverse_;
+  }
+
+  Graph *graph() {
+    return &graph_;
+  }
+
+  // Every link of the graph is also given in the opposite direction (true
+  // for category links), Undirected() does not need the reverse graph
+  void set_symmetric(bool symmetric) {
+    symmetric_ = symmetric;
+  }
+
+  // Links in both directions, sorted without duplicates and self-links,
+  // built on first use
+  Graph *Undirected() {
+    if (!undirected_.list)
+      BuildUndirected();
+    return &undirected_;
+  }
+
+  // Core number of every node in the undirected graph, see kcore.h
+  const uint32_t *CoreNumbers() {
+    if (!core_) {
+      core_ = new uint32_t[graph_.num_nodes + 1];
+      KCore kcore(Undirected(), invalid_node_);
+      if (NumThreads() > 1)
+        kcore.RunParallel(core_);
+      else
+        kcore.RunBuckets(core_);
+    }
+    return core_;
+  }
+
+  bool LoadCoreNumbers(const string &fname) {
+    uint32_t *loaded = new uint32_t[graph_.num_nodes + 1];
+    if (!LoadNodeArray(fname, graph_.num_nodes, Checksum(), loaded)) {
+      delete[] loaded;
+      return false;
+    }
+    delete[] core_;
+    core_ = loaded;
+    return true;
+  }
+
+  bool SaveCoreNumbers(const string &fname) {
+    return SaveNodeArray(fname, CoreNumbers(), graph_.num_nodes, Checksum());
+  }
 
-      N++;
+  bool HasCoreNumbers() const {
+    return core_ != NULL;
+  }
+
+  // Communities of the undirected graph by label propagation, see
+  // communities.h. Labeled by the smallest node in each (0 for invalid
+  // nodes), computed on first use.
+  const uint32_t *Communities(uint32_t max_iterations) {
+    if (!community_) {
+      community_ = new uint32_t[graph_.num_nodes + 1];
+      LabelPropagation propagation(Undirected(), invalid_node_);
+      propagation.Run(max_iterations, community_);
+      community_size_ = CountSizes(community_);
     }
+    return community_;
+  }
+
+  // Sizes of communities, in order of their labels
+  vector<uint32_t> CommunitySizes(uint32_t max_iterations) {
+    Communities(max_iterations);
+    return ComponentSizes(community_, community_size_);
+  }
+
+  uint32_t CommunitySize(node_t node, uint32_t max_iterations) {
+    Communities(max_iterations);
+    return community_[node] ? community_size_[community_[node]] : 0;
+  }
+
+  bool LoadCommunities(const string &fname) {
+    return LoadLabels(fname, &community_, &community_size_);
+  }
+
+  bool SaveCommunities(const string &fname, uint32_t max_iterations) {
+    return SaveNodeArray(fname, Communities(max_iterations),
+        graph_.num_nodes, Checksum());
+  }
+
+  bool HasCommunities() const {
+    return community_ != NULL;
+  }
+
+  // Number of triangles each node is part of in the undirected graph, see
+  // triangles.h
+  const uint64_t *Triangles() {
+    if (!triangles_) {
+      triangles_ = new uint64_t[graph_.num_nodes + 1];
+      TriangleCounter counter(Undirected());
+      counter.Run(triangles_);
+    }
+    return triangles_;
+  }
+
+  // Fraction of pairs of neighbours of node which are linked
+  double Clustering(node_t node) {
+    uint64_t degree = Undirected()->end(node) - Undirected()->start(node);
+    if (degree < 2)
+      return 0.0;
+    return 2.0 * Triangles()[node] / (degree * (degree - 1));
+  }
 
-    const double dumping = 0.85;
+  // Number of triangles, average of Clustering over valid nodes and
+  // transitivity (fraction of paths of length 2 which are closed)
+  void ClusteringInfo(uint64_t *num_triangles, double *average,
+      double *transitivity) {
+    const uint64_t *triangles = Triangles();
+    Graph *undirected = Undirected();
+    uint64_t sum = 0, paths = 0, valid = 0;
+    double clustering = 0.0;
     for (node_t node = 1; node <= graph_.num_nodes; node++) {
       if (invalid_node_ && invalid_node_->get_value(node))
         continue;
+      uint64_t degree = undirected->end(node) - undirected->start(node);
+      sum += triangles[node];
+      if (degree > 1)
+        paths += degree * (degree - 1) / 2;
+      clustering += Clustering(node);
+      valid++;
+    }
+    *num_triangles = sum / 3;
+    *average = valid ? clustering / valid : 0.0;
+    *transitivity = paths ? static_cast<double>(sum) / paths : 0.0;
+  }
 
-      rank1[node] = 1.0 / N;
+  bool LoadTriangles(const string &fname) {
+    uint64_t *loaded = new uint64_t[graph_.num_nodes + 1];
+    if (!LoadNodeArray(fname, graph_.num_nodes, Checksum(), loaded)) {
+      delete[] loaded;
+      return false;
     }
+    delete[] triangles_;
+    triangles_ = loaded;
+    return true;
+  }
+
+  bool SaveTriangles(const string &fname) {
+    return SaveNodeArray(fname, Triangles(), graph_.num_nodes, Checksum());
+  }
 
-    while (true) {
-      PowerIteration(N, dumping, rank1, rank2);
-      std::swap(rank1, rank2);
-      // rank1 contains results
+  bool HasTriangles() const {
+    return triangles_ != NULL;
+  }
+
+  BitArray *invalid_node() {
+    return invalid_node_;
+  }
 
-      double delta = 0.0;
-      for (node_t node = 1; node <= graph_.num_nodes; node++) {
-        if (invalid_node_ && invalid_node_->get_value(node))
-          continue;
+  // crc32 of the graph, identifies the graph for saved results
+  uint32_t Checksum() {
+    if (!checksum_) {
+      uLong crc = crc32(0L, Z_NULL, 0);
+      crc = Crc32Array(crc, graph_.list, graph_.num_nodes + 2);
+      crc = Crc32Array(crc, graph_.edges, graph_.num_edges);
+      checksum_ = crc ? crc : 1;  // 0 means not computed
+    }
+    return checksum_;
+  }
 
-        delta += std::fabs(rank1[node] - rank2[node]);
+  // PageRank of every node, see pagerank.h. Iteration starts from ranks
+  // given to StartRanks, if any.
+  const float *Ranks(const PageRankOptions &options) {
+    if (!ranks_) {
+      ranks_ = new float[graph_.num_nodes + 1];
+      if (options.single_precision) {
+        StartingRanks(ranks_);
+        PageRankSolver<float> solver(Reverse(), invalid_node_);
+        num_iterations_ = solver.Run(options, ranks_);
+      } else {
+        double *ranks = new double[graph_.num_nodes + 1];
+        StartingRanks(ranks);
+        PageRankSolver<double> solver(Reverse(), invalid_node_);
+        num_iterations_ = solver.Run(options, ranks);
+        std::copy(ranks, ranks + graph_.num_nodes + 1, ranks_);
+        delete[] ranks;
       }
-      if (verbose) {
-        printf("Delta: %lf\n", delta);
+    }
+    return ranks_;
+  }
+
+  // Iterations of the last computation of ranks, 0 if they were loaded
+  uint32_t num_iterations() const {
+    return num_iterations_;
+  }
+
+  // Ranks of another graph (previous month) are used as the starting point.
+  // previous_node gives the node of that graph for every node, 0 for new
+  // nodes. Returns how many nodes got their previous rank.
+  uint32_t StartRanks(const string &fname,
+      const vector<node_t> &previous_node) {
+    vector<float> previous;
+    uint32_t num_previous = LoadOtherNodeArray(fname, &previous);
+    if (!num_previous)
+      return 0;
+    float *loaded = new float[graph_.num_nodes + 1];
+    uint32_t num_matched = 0;
+    loaded[0] = 0.0f;
+    for (node_t node = 1; node <= graph_.num_nodes; node++) {
+      node_t old = node < previous_node.size() ? previous_node[node] : 0;
+      if (old && old <= num_previous) {
+        loaded[node] = previous[old];
+        num_matched++;
+      } else {
+        loaded[node] = 1.0f / num_previous;  // new nodes start with average
       }
+    }
+    if (!num_matched) {
+      delete[] loaded;
+      return 0;
+    }
+    delete[] start_ranks_;
+    start_ranks_ = loaded;
+    return num_matched;
+  }
 
-      if (delta < 1e-3)
-        break;
+  bool LoadRanks(const string &fname) {
+    float *loaded = new float[graph_.num_nodes + 1];
+    if (!LoadNodeArray(fname, graph_.num_nodes, Checksum(), loaded)) {
+      delete[] loaded;
+      return false;
     }
+    delete[] ranks_;
+    ranks_ = loaded;
+    num_iterations_ = 0;
+    return true;
+  }
 
-    double ranksum = 0.0;
-    for (node_t node = 1; node <= graph_.num_nodes; node++) {
-      if (invalid_node_ && invalid_node_->get_value(node))
-        continue;
+  bool SaveRanks(const string &fname) {
+    return ranks_ && SaveNodeArray(fname, ranks_, graph_.num_nodes,
+        Checksum());
+  }
+
+  bool HasRanks() const {
+    return ranks_ != NULL;
+  }
+
+  // Nodes with the highest PageRank
+  vector<pair<double, node_t> > PageRank(uint32_t how_many,
+      const PageRankOptions &options) {
+    return TopNodes(Ranks(options), how_many);
+  }
 
-      ranksum += rank1[node];
+  vector<pair<double, node_t> > PageRank(uint32_t how_many, bool verbose) {
+    PageRankOptions options;
+    options.verbose = verbose;
+    return PageRank(how_many, options);
+  }
+
+  // Hub and authority scores of every node (each sums to 1), see hits.h.
+  // Returns the number of iterations, 0 if they were computed before.
+  uint32_t Hits(double tolerance, uint32_t max_iterations) {
+    if (hubs_)
+      return 0;
+    hubs_ = new float[graph_.num_nodes + 1];
+    authorities_ = new float[graph_.num_nodes + 1];
+    wikigraph::Hits hits(&graph_, Reverse(), invalid_node_);
+    return hits.Run(tolerance, max_iterations, hubs_, authorities_);
+  }
+
+  const float *hubs() const {
+    return hubs_;
+  }
+
+  const float *authorities() const {
+    return authorities_;
+  }
+
+  // Graph of directed category links (page to its categories) as a
+  // hierarchy, see category.h. Root category (0 if not known) is used when
+  // the hierarchy is built.
+  CategoryHierarchy *Hierarchy(node_t root) {
+    if (!hierarchy_) {
+      hierarchy_ = new CategoryHierarchy(&graph_, root);
+      hierarchy_->Build();
     }
+    return hierarchy_;
+  }
 
-    vector<pair<double, node_t> > ret;
+  // Distances to and from landmarks, see landmarks.h
+  LandmarkIndex *Landmarks() {
+    if (!landmarks_) {
+      landmarks_ = new LandmarkIndex(&graph_, Reverse(), invalid_node_);
+      landmarks_->Build();
+    }
+    return landmarks_;
+  }
+
+  bool LoadLandmarks(const string &fname) {
+    LandmarkIndex::Row *loaded = new LandmarkIndex::Row[graph_.num_nodes + 1];
+    if (!LoadNodeArray(fname, graph_.num_nodes, Checksum(), loaded)) {
+      delete[] loaded;
+      return false;
+    }
+    delete landmarks_;
+    landmarks_ = new LandmarkIndex(&graph_, Reverse(), invalid_node_);
+    landmarks_->Set(loaded);
+    return true;
+  }
+
+  bool SaveLandmarks(const string &fname) {
+    return SaveNodeArray(fname, Landmarks()->rows(), graph_.num_nodes,
+        Checksum());
+  }
+
+  bool HasLandmarks() const {
+    return landmarks_ != NULL;
+  }
+
+  // Exact distance by bidirectional BFS, LandmarkIndex::kUnreachable if
+  // there is no path
+  int32_t Distance(node_t from, node_t to) {
+    if (!bidirectional_)
+      bidirectional_ = new BidirectionalBfs(&graph_, Reverse());
+    return bidirectional_->Distance(from, to);
+  }
+
+  // Exact distances between nodes of the largest strongly connected
+  // component, see pll.h. No node is labeled if the component has too
+  // long paths.
+  PrunedLabeling *DistanceLabels() {
+    if (!labeling_) {
+      labeling_ = new PrunedLabeling(&graph_, Reverse());
+      labeling_->Build(SccLabels(), LargestScc());
+    }
+    return labeling_;
+  }
+
+  bool LoadDistanceLabels(const string &fname) {
+    SystemFile f;
+    if (!f.open(fname.c_str(), "rb"))
+      return false;
+    PrunedLabeling *loaded = new PrunedLabeling(&graph_, Reverse());
+    bool ok = loaded->Read(&f, Checksum());
+    f.close();
+    if (!ok) {
+      delete loaded;
+      return false;
+    }
+    delete labeling_;
+    labeling_ = loaded;
+    return true;
+  }
 
+  bool SaveDistanceLabels(const string &fname) {
+    DistanceLabels();
+    string tmpname = TempFileName(fname);
+    SystemFile f;
+    if (!f.open(tmpname.c_str(), "wb"))
+      return false;
+    labeling_->Write(&f, Checksum());
+    f.close();
+    return rename(tmpname.c_str(), fname.c_str()) == 0;
+  }
+
+  bool HasDistanceLabels() const {
+    return labeling_ != NULL;
+  }
+
+  // Valid nodes with the highest values, sorted
+  vector<pair<double, node_t> > TopNodes(const float *values,
+      uint32_t how_many) {
+    vector<pair<double, node_t> > ret;
     for (node_t node = 1; node <= graph_.num_nodes; node++) {
       if (invalid_node_ && invalid_node_->get_value(node))
         continue;
 
-      ret.push_back(std::make_pair(rank1[node], node));
+      ret.push_back(std::make_pair(values[node], node));
     }
-    delete[] rank1;
-    delete[] rank2;
-
-    how_many = std::min(how_many, N);
+    how_many = std::min<size_t>(how_many, ret.size());
     std::partial_sort(ret.begin(), ret.begin() + how_many, ret.end(),
         std::greater< pair<double, node_t> >());
     ret.resize(how_many);
-    for (size_t i = 0; i < ret.size(); i++) {
-      ret[i].first /= ranksum;
-    }
+    return ret;
+  }
+
+  // Nodes with the highest betweenness, estimated from BFS of sampled
+  // sources. samples is set to the number of sources actually used (not
+  // more than nodes), error to the bound of the error, see centrality.h
+  vector<pair<double, node_t> > Betweenness(uint32_t how_many,
+      uint32_t *samples, double *error) {
+    SampledBetweenness betweenness(&graph_, invalid_node_, *samples);
+    vector<pair<double, node_t> > ret = betweenness.Run(how_many);
+    *samples = betweenness.samples();
+    *error = betweenness.error();
+    return ret;
+  }
+
+  // Nodes with the smallest average distance to reachable nodes, among
+  // nodes which reach the largest strongly connected component
+  vector<pair<double, node_t> > SampledClosest(uint32_t how_many,
+      uint32_t samples) {
+    SampledCloseness closeness(&graph_, Reverse(), invalid_node_,
+        SccLabels(), LargestScc(), samples);
+    return closeness.Run(how_many);
+  }
+
+  // Exact closest nodes, the same as SampledClosest would give with all
+  // nodes sampled. num_cut is set to the number of BFS that were cut off.
+  vector<pair<double, node_t> > TopClosest(uint32_t how_many,
+      uint32_t *num_cut) {
+    TopkCloseness closeness(&graph_, Reverse(), SccLabels(), LargestScc());
+    vector<pair<double, node_t> > ret = closeness.Run(how_many);
+    *num_cut = closeness.num_cut();
+    return ret;
+  }
+
+  // Nodes most related to source by personalized PageRank, see ppr.h.
+  // num_pushes is set to the number of pushes the query took.
+  vector<pair<double, node_t> > Related(node_t source, double alpha,
+      double epsilon, uint32_t how_many, uint32_t *num_pushes) {
+    if (!ppr_)
+      ppr_ = new PersonalizedPageRank(&graph_);
+    vector<pair<double, node_t> > ret = ppr_->Run(source, alpha, epsilon,
+        how_many);
+    *num_pushes = ppr_->num_pushes();
     return ret;
   }
 
@@ -347,39 +778,224 @@ class CompleteGraphAlgo {
     return graph_.num_edges;
   }
 
- protected:
-  void PowerIteration(uint32_t N, double dumping,
-      double *rank_in, double *rank_out) {
-    for (node_t node = 1; node <= graph_.num_nodes; node++) {
-      if (invalid_node_ && invalid_node_->get_value(node))
-        continue;
+ private:
+  template<class Real>
+  void StartingRanks(Real *ranks) {
+    for (node_t node = 0; node <= graph_.num_nodes; node++)
+      ranks[node] = start_ranks_ ? start_ranks_[node] : Real(1.0);
+  }
 
-      rank_out[node] = (1.0 - dumping) / N;
+  static uLong Crc32Array(uLong crc, const uint32_t *data, size_t len) {
+    const Bytef *bytes = reinterpret_cast<const Bytef*>(data);
+    size_t left = len * sizeof(uint32_t);
+    while (left) {  // crc32 takes 32-bit lengths
+      uInt chunk = std::min<size_t>(left, 1u << 30);
+      crc = crc32(crc, bytes, chunk);
+      bytes += chunk;
+      left -= chunk;
     }
-    for (node_t node = 1; node <= graph_.num_nodes; node++) {
-      if (invalid_node_ && invalid_node_->get_value(node))
-        continue;
+    return crc;
+  }
 
-      node_t *target = &graph_.edges[graph_.start(node)];
-      node_t *end = &graph_.edges[graph_.end(node)];
-      int out_degree = graph_.end(node) - graph_.start(node);
+  struct CountDistances {
+    Graph *graph;
+    const vector<node_t> *sources;
+    vector<vector<uint32_t> > *counts;
+    BfsWorkspaces *workspaces;
+    void operator()(uint32_t task, int thread) {
+      BfsWorkspace *bfs = workspaces->get(thread);
+      bfs->Bfs(graph, (*sources)[task]);
+      vector<uint32_t> *count = &(*counts)[task];
+      // Visited nodes are in order of distance
+      for (uint32_t i = 0; i < bfs->size(); i++) {
+        uint32_t dist = bfs->dist()[bfs->queue()[i]];
+        if (dist == count->size())
+          count->push_back(0);
+        (*count)[dist]++;
+      }
+    }
+  };
+  struct CountInDegree {
+    Graph *graph;
+    uint32_t *list;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++) {
+        for (uint32_t i = graph->start(node); i < graph->end(node); i++)
+          AtomicAdd<uint32_t>(&list[graph->edges[i] + 1], 1);
+      }
+    }
+  };
+  struct FillReverse {
+    Graph *graph;
+    uint32_t *pos;
+    node_t *edges;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++) {
+        for (uint32_t i = graph->start(node); i < graph->end(node); i++)
+          edges[AtomicAdd<uint32_t>(&pos[graph->edges[i]], 1)] = node;
+      }
+    }
+  };
+  struct SortLists {
+    Graph *graph;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++)
+        std::sort(graph->edges + graph->start(node),
+            graph->edges + graph->end(node));
+    }
+  };
+
+  void BuildReverse() {
+    uint32_t num_nodes = graph_.num_nodes;
+    reverse_.num_nodes = num_nodes;
+    reverse_.num_edges = graph_.num_edges;
+    reverse_.list = new uint32_t[num_nodes + 2];
+    memset(reverse_.list, 0, sizeof(uint32_t) * (num_nodes + 2));
+    // In-degree of node is counted in list[node + 1]
+    CountInDegree count = { &graph_, reverse_.list };
+    ParallelFor(1, num_nodes + 1, 4096, &count);
+    for (node_t node = 1; node <= num_nodes; node++)
+      reverse_.list[node + 1] += reverse_.list[node];
+
+    reverse_.edges = new node_t[graph_.num_edges];
+    uint32_t *pos = new uint32_t[num_nodes + 2];
+    memcpy(pos, reverse_.list, sizeof(uint32_t) * (num_nodes + 2));
+    FillReverse fill = { &graph_, pos, reverse_.edges };
+    ParallelFor(1, num_nodes + 1, 4096, &fill);
+    delete[] pos;
+    // Order of edges depends on threads, sort them to get the same graph
+    SortLists sort = { &reverse_ };
+    ParallelFor(1, num_nodes + 1, 4096, &sort);
+  }
 
-      double contrib_rank = dumping * rank_in[node] / out_degree;
-      for ( ; target < end; target++) {
-        // link is from (node) to (*target)
-        rank_out[*target] += contrib_rank;
+  // Union of out- and in-links of every node
+  struct UnionLinks {
+    Graph *graph, *reverse;  // reverse is NULL for symmetric graph
+    vector<vector<node_t> > links;  // per thread
+    void Collect(node_t node, vector<node_t> *list) {
+      list->assign(graph->edges + graph->start(node),
+          graph->edges + graph->end(node));
+      if (reverse)
+        list->insert(list->end(), reverse->edges + reverse->start(node),
+            reverse->edges + reverse->end(node));
+      std::sort(list->begin(), list->end());
+      list->erase(std::unique(list->begin(), list->end()), list->end());
+      list->erase(std::remove(list->begin(), list->end(), node),
+          list->end());
+    }
+  };
+  struct CountUnion : UnionLinks {
+    uint32_t *list;  // degree of node in list[node + 1]
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++) {
+        Collect(node, &links[thread]);
+        list[node + 1] = links[thread].size();
       }
     }
+  };
+  struct FillUnion : UnionLinks {
+    Graph *undirected;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++) {
+        Collect(node, &links[thread]);
+        std::copy(links[thread].begin(), links[thread].end(),
+            undirected->edges + undirected->start(node));
+      }
+    }
+  };
+
+  void BuildUndirected() {
+    uint32_t num_nodes = graph_.num_nodes;
+    undirected_.num_nodes = num_nodes;
+    undirected_.list = new uint32_t[num_nodes + 2];
+    memset(undirected_.list, 0, sizeof(uint32_t) * (num_nodes + 2));
+    CountUnion count;
+    count.graph = &graph_;
+    count.reverse = symmetric_ ? NULL : Reverse();
+    count.links.resize(NumThreads());
+    count.list = undirected_.list;
+    ParallelFor(1, num_nodes + 1, 4096, &count);
+    for (node_t node = 1; node <= num_nodes; node++)
+      undirected_.list[node + 1] += undirected_.list[node];
+    undirected_.num_edges = undirected_.list[num_nodes + 1];
+
+    undirected_.edges = new node_t[undirected_.num_edges];
+    FillUnion fill;
+    fill.graph = &graph_;
+    fill.reverse = count.reverse;
+    fill.links.resize(NumThreads());
+    fill.undirected = &undirected_;
+    ParallelFor(1, num_nodes + 1, 4096, &fill);
+  }
+
+  // Number of nodes with each label
+  uint32_t *CountSizes(const uint32_t *labels) {
+    uint32_t *sizes = new uint32_t[graph_.num_nodes + 1];
+    memset(sizes, 0, sizeof(uint32_t) * (graph_.num_nodes + 1));
+    for (node_t node = 1; node <= graph_.num_nodes; node++) {
+      if (labels[node])
+        sizes[labels[node]]++;
+    }
+    return sizes;
+  }
+
+  vector<uint32_t> ComponentSizes(const uint32_t *labels,
+      const uint32_t *sizes) {
+    vector<uint32_t> result;
+    for (node_t node = 1; node <= graph_.num_nodes; node++) {
+      if (labels[node] == node)
+        result.push_back(sizes[node]);
+    }
+    return result;
+  }
+
+  bool LoadLabels(const string &fname, uint32_t **labels, uint32_t **sizes) {
+    uint32_t *loaded = new uint32_t[graph_.num_nodes + 1];
+    if (!LoadNodeArray(fname, graph_.num_nodes, Checksum(), loaded)) {
+      delete[] loaded;
+      return false;
+    }
+    delete[] *labels;
+    delete[] *sizes;
+    *labels = loaded;
+    *sizes = CountSizes(loaded);
+    return true;
   }
 
- private:
   File *file_;
   Graph graph_;
   BitArray *invalid_node_;
+  size_t map_size_;  // non-zero if graph is mmap-ed
 
   // Used in computation
   node_t *queue_;
   int32_t *dist_;
+
+  // Computed on first use
+  Graph reverse_;
+  uint32_t checksum_;
+  uint32_t *scc_;  // component of node
+  uint32_t *scc_size_;  // size of component, by label
+  uint32_t *wcc_;
+  uint32_t *wcc_size_;
+  DiameterSolver *diameter_;
+  bool symmetric_;
+  Graph undirected_;
+  uint32_t *core_;  // core number of node
+  uint64_t *triangles_;  // of node
+  PersonalizedPageRank *ppr_;  // reused by queries
+  float *ranks_;  // of node
+  float *start_ranks_;  // of node, from the previous month
+  uint32_t num_iterations_;  // of PageRank
+  float *hubs_;  // of node
+  float *authorities_;  // of node
+  CategoryHierarchy *hierarchy_;
+  LandmarkIndex *landmarks_;
+  BidirectionalBfs *bidirectional_;
+  PrunedLabeling *labeling_;
+  uint32_t *community_;  // of node
+  uint32_t *community_size_;  // by label
+  BfsWorkspaces *workspaces_;  // of threads, for distances from many sources
  private:
   DISALLOW_COPY_AND_ASSIGN(CompleteGraphAlgo);
 };
@@ -0,0 +1,135 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_HITS_H_
+#define SRC_HITS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+// Hubs and authorities of valid nodes (Kleinberg). Authority of a node is
+// the sum of hub scores of nodes linking to it, hub score is the sum of
+// authorities of nodes it links to. Both are computed alternately by all
+// threads, pulling over the reverse graph for authorities and over the
+// graph for hubs, and scaled to sum 1 after each step. Links to and from
+// invalid nodes are ignored.
+class Hits {
+ public:
+  Hits(Graph *graph, Graph *reverse, BitArray *invalid_node)
+  : graph_(graph), reverse_(reverse), invalid_node_(invalid_node),
+    num_nodes_(graph->num_nodes), delta_(0.0) { }
+
+  // hubs and authorities have num_nodes + 1 elements, returns the number
+  // of iterations.
+  uint32_t Run(double tolerance, uint32_t max_iterations, float *hubs,
+      float *authorities) {
+    uint32_t num_valid = 0;
+    for (node_t node = 1; node <= num_nodes_; node++)
+      num_valid += Valid(node);
+    for (node_t node = 0; node <= num_nodes_; node++) {
+      hubs[node] = node && Valid(node) ? 1.0f / num_valid : 0.0f;
+      authorities[node] = 0.0f;
+    }
+    float *next = new float[num_nodes_ + 1];
+    uint32_t iteration = 0;
+    while (iteration < max_iterations) {
+      iteration++;
+      delta_ = Step(reverse_, hubs, authorities, next);
+      delta_ += Step(graph_, authorities, hubs, next);
+      if (delta_ < tolerance)
+        break;
+    }
+    delete[] next;
+    return iteration;
+  }
+
+  // L1 change of hubs and authorities in the last iteration
+  double delta() const {
+    return delta_;
+  }
+
+ private:
+  bool Valid(node_t node) const {
+    return !invalid_node_ || !invalid_node_->get_value(node);
+  }
+
+  // next[node] = sum of in[] over links of node
+  struct MultiplyBody {
+    const Hits *s;
+    Graph *links;
+    const float *in;
+    float *next;
+    vector<double> sum;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++) {
+        double value = 0.0;
+        if (s->Valid(node)) {
+          for (uint32_t e = links->start(node); e < links->end(node); e++)
+            value += in[links->edges[e]];  // 0 for invalid nodes
+        }
+        next[node] = value;
+        sum[thread] += value;
+      }
+    }
+  };
+
+  // values[node] = next[node] * scale
+  struct ScaleBody {
+    const float *next;
+    float *values;
+    double scale;
+    vector<double> delta;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++) {
+        float value = next[node] * scale;
+        delta[thread] += std::fabs(value - values[node]);
+        values[node] = value;
+      }
+    }
+  };
+
+  // values = links * in, scaled to sum 1, returns L1 change of values
+  double Step(Graph *links, const float *in, float *values, float *next) {
+    MultiplyBody multiply;
+    multiply.s = this;
+    multiply.links = links;
+    multiply.in = in;
+    multiply.next = next;
+    multiply.sum.resize(NumThreads());
+    next[0] = 0.0f;
+    ParallelFor(1, num_nodes_ + 1, 4096, &multiply);
+    double sum = 0.0;
+    for (size_t i = 0; i < multiply.sum.size(); i++)
+      sum += multiply.sum[i];
+
+    ScaleBody scale;
+    scale.next = next;
+    scale.values = values;
+    scale.scale = sum > 0 ? 1.0 / sum : 0.0;
+    scale.delta.resize(NumThreads());
+    ParallelFor(1, num_nodes_ + 1, 4096, &scale);
+    double delta = 0.0;
+    for (size_t i = 0; i < scale.delta.size(); i++)
+      delta += scale.delta[i];
+    return delta;
+  }
+
+  Graph *graph_;
+  Graph *reverse_;
+  BitArray *invalid_node_;
+  uint32_t num_nodes_;
+  double delta_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Hits);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_HITS_H_
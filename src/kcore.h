@@ -0,0 +1,176 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_KCORE_H_
+#define SRC_KCORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+// Core number of every node of an undirected graph (each edge is given in
+// both directions): the largest k such that the node belongs to a subgraph
+// where every node has degree k or more. Invalid nodes get 0.
+class KCore {
+ public:
+  KCore(Graph *graph, BitArray *invalid_node)
+  : graph_(graph), invalid_node_(invalid_node),
+    num_nodes_(graph->num_nodes) { }
+
+  // Batagelj & Zaversnik: nodes are kept in an array sorted by current
+  // degree with the start of each degree (bucket) known. Removing the node
+  // with the smallest degree moves each neighbour one bucket down in
+  // constant time, so the whole run is O(E).
+  void RunBuckets(uint32_t *core) {
+    uint32_t *deg = core;  // degree becomes core number when node is done
+    uint32_t max_deg = 0;
+    for (node_t node = 0; node <= num_nodes_; node++) {
+      deg[node] = Valid(node) ? Degree(node) : 0;
+      max_deg = std::max(max_deg, deg[node]);
+    }
+    // bin[d] = start of nodes with degree d in vert
+    vector<uint32_t> bin(max_deg + 2, 0);
+    for (node_t node = 1; node <= num_nodes_; node++)
+      bin[deg[node] + 1]++;
+    for (uint32_t d = 1; d <= max_deg + 1; d++)
+      bin[d] += bin[d - 1];
+    node_t *vert = new node_t[num_nodes_];
+    uint32_t *pos = new uint32_t[num_nodes_ + 1];
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      pos[node] = bin[deg[node]]++;
+      vert[pos[node]] = node;
+    }
+    for (uint32_t d = max_deg + 1; d > 0; d--)
+      bin[d] = bin[d - 1];
+    bin[0] = 0;
+
+    for (uint32_t i = 0; i < num_nodes_; i++) {
+      node_t node = vert[i];
+      for (uint32_t e = graph_->start(node); e < graph_->end(node); e++) {
+        node_t next = graph_->edges[e];
+        if (deg[next] <= deg[node])
+          continue;
+        // Swap next with the first node of its bucket, shrink the bucket
+        uint32_t first = bin[deg[next]];
+        node_t other = vert[first];
+        if (other != next) {
+          vert[pos[next]] = other;
+          pos[other] = pos[next];
+          vert[first] = next;
+          pos[next] = first;
+        }
+        bin[deg[next]]++;
+        deg[next]--;
+      }
+    }
+    delete[] vert;
+    delete[] pos;
+  }
+
+  // Parallel peeling: for k = 0, 1, 2, ... all remaining nodes with degree
+  // k or less are removed at once by all threads, neighbours whose degree
+  // drops to k are removed in the same round. Degrees are decremented
+  // atomically, a node is taken by the one thread which moves its degree
+  // from k+1 to k.
+  void RunParallel(uint32_t *core) {
+    deg_ = new uint32_t[num_nodes_ + 1];
+    removed_ = new uint8_t[num_nodes_ + 1];
+    core_ = core;
+    memset(removed_, 0, num_nodes_ + 1);
+    vector<node_t> active;
+    for (node_t node = 0; node <= num_nodes_; node++) {
+      core_[node] = 0;
+      deg_[node] = Valid(node) ? Degree(node) : 0;
+      if (node && Valid(node))
+        active.push_back(node);
+    }
+
+    vector<node_t> frontier;
+    for (uint32_t k = 0; !active.empty(); k++) {
+      // Remaining nodes with degree k or less
+      size_t left = 0;
+      frontier.clear();
+      for (size_t i = 0; i < active.size(); i++) {
+        node_t node = active[i];
+        if (removed_[node])
+          continue;
+        if (deg_[node] <= k) {
+          removed_[node] = 1;
+          frontier.push_back(node);
+        } else {
+          active[left++] = node;
+        }
+      }
+      active.resize(left);
+
+      while (!frontier.empty()) {
+        PeelBody body;
+        body.s = this;
+        body.k = k;
+        body.frontier = &frontier;
+        body.next.resize(NumThreads());
+        ParallelFor(0, frontier.size(), 256, &body);
+        frontier.clear();
+        for (size_t i = 0; i < body.next.size(); i++)
+          frontier.insert(frontier.end(), body.next[i].begin(),
+              body.next[i].end());
+      }
+    }
+    delete[] deg_;
+    delete[] removed_;
+  }
+
+ private:
+  struct PeelBody {
+    KCore *s;
+    uint32_t k;
+    const vector<node_t> *frontier;
+    vector<vector<node_t> > next;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      Graph *graph = s->graph_;
+      for (uint32_t i = begin; i < end; i++) {
+        node_t node = (*frontier)[i];
+        s->core_[node] = k;
+        for (uint32_t e = graph->start(node); e < graph->end(node); e++) {
+          node_t next = graph->edges[e];
+          if (AtomicLoad(&s->removed_[next]))
+            continue;
+          uint32_t old_deg = AtomicAdd<uint32_t>(&s->deg_[next], -1);
+          if (old_deg == k + 1) {
+            AtomicOr<uint8_t>(&s->removed_[next], 1);
+            this->next[thread].push_back(next);
+          }
+        }
+      }
+    }
+  };
+
+  bool Valid(node_t node) const {
+    return !invalid_node_ || !invalid_node_->get_value(node);
+  }
+
+  uint32_t Degree(node_t node) const {
+    return graph_->end(node) - graph_->start(node);
+  }
+
+  Graph *graph_;
+  BitArray *invalid_node_;
+  uint32_t num_nodes_;
+
+  // Used in RunParallel
+  uint32_t *core_;
+  uint32_t *deg_;
+  uint8_t *removed_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(KCore);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_KCORE_H_
@@ -0,0 +1,259 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_LANDMARKS_H_
+#define SRC_LANDMARKS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "graph.h"
+#include "centrality.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+// Distances of every node to and from kLandmarks landmarks, one byte each
+// (kNone if there is no path, kMaxDist if it is kMaxDist or longer, which
+// only helps lower bounds). Distance from s to t
+// is bounded by the triangle inequality for each landmark L:
+//
+//   d(s,t) <= d(s,L) + d(L,t)
+//   d(s,t) >= d(L,t) - d(L,s)  and  d(s,t) >= d(s,L) - d(t,L)
+//
+// so both bounds take O(kLandmarks) time. Landmarks are valid nodes of the
+// highest degree, neighbours of a landmark are not taken, so that landmarks
+// cover more of the graph.
+class LandmarkIndex {
+ public:
+  static const int kLandmarks = 16;
+  static const uint8_t kNone = 255;
+  static const uint8_t kMaxDist = 254;
+  static const int32_t kUnreachable = -1;
+
+  // Distances of one node, saved with SaveNodeArray
+  struct Row {
+    uint8_t to[kLandmarks];  // from node to landmark
+    uint8_t from[kLandmarks];  // from landmark to node
+  };
+
+  LandmarkIndex(Graph *graph, Graph *reverse, BitArray *invalid_node)
+  : graph_(graph), reverse_(reverse), invalid_node_(invalid_node),
+    num_nodes_(graph->num_nodes), rows_(NULL) { }
+
+  ~LandmarkIndex() {
+    delete[] rows_;
+  }
+
+  // One BFS forward and one backward from each landmark, in parallel
+  void Build() {
+    ChooseLandmarks();
+    rows_ = new Row[num_nodes_ + 1];
+    memset(rows_, kNone, sizeof(Row) * (num_nodes_ + 1));
+    BfsWorkspaces workspaces(num_nodes_);
+    BuildBody body = { this, &workspaces };
+    ParallelFor(0, 2 * landmarks_.size(), 1, &body);
+  }
+
+  // Takes rows of num_nodes + 1 nodes (from LoadNodeArray), landmarks are
+  // the nodes at distance 0
+  void Set(Row *rows) {
+    delete[] rows_;
+    rows_ = rows;
+    landmarks_.clear();
+    for (int i = 0; i < kLandmarks; i++) {
+      for (node_t node = 1; node <= num_nodes_; node++) {
+        if (rows_[node].to[i] == 0) {
+          landmarks_.push_back(node);
+          break;
+        }
+      }
+    }
+  }
+
+  const Row *rows() const {
+    return rows_;
+  }
+
+  const vector<node_t> &landmarks() const {
+    return landmarks_;
+  }
+
+  // Bounds of distance from s to t, upper is kUnreachable if no landmark
+  // connects them, lower is kUnreachable if t is certainly not reachable
+  void Bounds(node_t s, node_t t, int32_t *lower, int32_t *upper) const {
+    if (s == t) {
+      *lower = *upper = 0;
+      return;
+    }
+    const Row &rs = rows_[s], &rt = rows_[t];
+    int32_t low = 1, up = kUnreachable;
+    for (size_t i = 0; i < landmarks_.size(); i++) {
+      // Landmark reaches s but not t, or t reaches it but s does not
+      if ((rs.from[i] != kNone && rt.from[i] == kNone)
+          || (rt.to[i] != kNone && rs.to[i] == kNone)) {
+        *lower = *upper = kUnreachable;
+        return;
+      }
+      if (rs.to[i] < kMaxDist && rt.from[i] < kMaxDist) {
+        int32_t through = rs.to[i] + rt.from[i];
+        if (up == kUnreachable || through < up)
+          up = through;
+      }
+      // Capped distance is a lower bound, it can only be subtracted from
+      if (rt.from[i] != kNone && rs.from[i] < kMaxDist)
+        low = std::max<int32_t>(low, rt.from[i] - rs.from[i]);
+      if (rs.to[i] != kNone && rt.to[i] < kMaxDist)
+        low = std::max<int32_t>(low, rs.to[i] - rt.to[i]);
+    }
+    *lower = low;
+    *upper = up;
+  }
+
+ private:
+  void ChooseLandmarks() {
+    vector<pair<uint32_t, node_t> > order;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (invalid_node_ && invalid_node_->get_value(node))
+        continue;
+      uint32_t degree = graph_->end(node) - graph_->start(node)
+          + reverse_->end(node) - reverse_->start(node);
+      order.push_back(std::make_pair(degree, node));
+    }
+    std::sort(order.begin(), order.end(),
+        std::greater<pair<uint32_t, node_t> >());
+    vector<bool> taken(num_nodes_ + 1, false);
+    landmarks_.clear();
+    for (size_t i = 0; i < order.size(); i++) {
+      node_t node = order[i].second;
+      if (taken[node])
+        continue;
+      landmarks_.push_back(node);
+      if (landmarks_.size() == kLandmarks)
+        break;
+      Take(graph_, node, &taken);
+      Take(reverse_, node, &taken);
+    }
+  }
+
+  void Take(Graph *graph, node_t node, vector<bool> *taken) {
+    (*taken)[node] = true;
+    for (uint32_t e = graph->start(node); e < graph->end(node); e++)
+      (*taken)[graph->edges[e]] = true;
+  }
+
+  struct BuildBody {
+    LandmarkIndex *s;
+    BfsWorkspaces *workspaces;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      BfsWorkspace *w = workspaces->get(thread);
+      for (uint32_t job = begin; job < end; job++) {
+        size_t i = job / 2;
+        bool forward = job % 2 == 0;
+        w->Bfs(forward ? s->graph_ : s->reverse_, s->landmarks_[i]);
+        // Each job writes its own byte of the rows
+        for (uint32_t k = 0; k < w->size(); k++) {
+          node_t node = w->queue()[k];
+          uint8_t dist = std::min<int32_t>(w->dist()[node], kMaxDist);
+          if (forward)
+            s->rows_[node].from[i] = dist;
+          else
+            s->rows_[node].to[i] = dist;
+        }
+      }
+    }
+  };
+
+  Graph *graph_;
+  Graph *reverse_;
+  BitArray *invalid_node_;
+  uint32_t num_nodes_;
+  vector<node_t> landmarks_;
+  Row *rows_;  // of node
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LandmarkIndex);
+};
+
+// Exact distance from s to t by BFS from both ends, each step expands the
+// smaller frontier by one level. Searches stop as soon as no path shorter
+// than the best found so far can exist.
+class BidirectionalBfs {
+ public:
+  BidirectionalBfs(Graph *graph, Graph *reverse)
+  : graph_(graph), reverse_(reverse), forward_(graph->num_nodes),
+    backward_(graph->num_nodes), num_visited_(0) { }
+
+  // Distance, or LandmarkIndex::kUnreachable
+  int32_t Distance(node_t s, node_t t) {
+    forward_.Start(s);
+    backward_.Start(t);
+    if (s == t)
+      return 0;
+    int32_t best = LandmarkIndex::kUnreachable;
+    int32_t radius_fw = 0, radius_bw = 0;  // levels done
+    uint32_t top_fw = 0, top_bw = 0;  // start of the frontier
+    while (true) {
+      uint32_t frontier_fw = forward_.size() - top_fw;
+      uint32_t frontier_bw = backward_.size() - top_bw;
+      // Without a meeting, one complete search proves there is no path
+      if (best == LandmarkIndex::kUnreachable) {
+        if (!frontier_fw || !frontier_bw)
+          break;
+      } else if (best <= radius_fw + radius_bw + 1
+          || (!frontier_fw && !frontier_bw)) {
+        break;
+      }
+      if (frontier_bw == 0 || (frontier_fw && frontier_fw <= frontier_bw)) {
+        Level(graph_, &forward_, &backward_, &top_fw, radius_fw, &best);
+        radius_fw++;
+      } else {
+        Level(reverse_, &backward_, &forward_, &top_bw, radius_bw, &best);
+        radius_bw++;
+      }
+    }
+    num_visited_ = forward_.size() + backward_.size();
+    return best;
+  }
+
+  // Nodes visited by the last search
+  uint32_t num_visited() const {
+    return num_visited_;
+  }
+
+ private:
+  // Visit nodes at distance level + 1 of search w, meeting the other one
+  void Level(Graph *graph, BfsWorkspace *w, BfsWorkspace *other,
+      uint32_t *top, int32_t level, int32_t *best) {
+    uint32_t level_end = w->size();
+    for ( ; *top < level_end; (*top)++) {
+      node_t node = w->queue()[*top];
+      for (uint32_t e = graph->start(node); e < graph->end(node); e++) {
+        node_t next = graph->edges[e];
+        if (w->Visited(next))
+          continue;
+        w->Visit(next, level + 1);
+        if (other->Visited(next)) {
+          int32_t through = level + 1 + other->dist()[next];
+          if (*best == LandmarkIndex::kUnreachable || through < *best)
+            *best = through;
+        }
+      }
+    }
+  }
+
+  Graph *graph_;
+  Graph *reverse_;
+  BfsWorkspace forward_;
+  BfsWorkspace backward_;
+  uint32_t num_visited_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BidirectionalBfs);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_LANDMARKS_H_
@@ -0,0 +1,232 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_NAME_STORE_H_
+#define SRC_NAME_STORE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include "wikigraph_stubs_internal.h"
+#include "file_io.h"
+
+namespace wikigraph {
+
+// Names of graph nodes are stored in the file similar to *.graph files:
+//
+//  [titles concatenated, padded with zeroes to a multiple of 4 bytes]
+//  [offset list: num_nodes + 2 entries of uint32]
+//  [num_bytes][num_nodes]
+//
+// Name of node is between offset(node) and offset(node + 1), names are
+// stored with the same prefix as in redis ("a:" or "c:").
+class NameStoreWriter {
+ public:
+  NameStoreWriter(File *f, uint32_t num_nodes)
+      : file_(f), nodes_(num_nodes), cur_node_(0), pos_(0), file_pos_(0) {
+    size_t list_len = (num_nodes + 2);
+    list_ = new uint32_t[ list_len ];
+    memset(list_, 0, sizeof(uint32_t) * list_len);
+    buffer_ = new char[kBufferSize];
+  }
+  ~NameStoreWriter() {
+    finish();
+    delete[] buffer_;
+    delete[] list_;
+  }
+  // Nodes must be given in increasing order, missing nodes get empty names
+  void add_name(node_t node, const char *prefix, const string &title) {
+    assert(node > 0);
+    assert(node <= nodes_);
+    assert(node > cur_node_);
+    while (PREDICT_FALSE(++cur_node_ < node)) {
+      list_[cur_node_] = file_pos_;
+    }
+    list_[node] = file_pos_;
+    write_bytes(prefix, strlen(prefix));
+    write_bytes(title.data(), title.size());
+  }
+  void finish() {
+    if (file_ == NULL)
+      return;
+
+    while (PREDICT_TRUE(++cur_node_ <= nodes_)) {
+      list_[cur_node_] = file_pos_;
+    }
+    list_[nodes_ + 1] = file_pos_;
+
+    // Keep offset list aligned, this allows to mmap the file
+    uint32_t num_bytes = file_pos_;
+    const char zeroes[4] = {0};
+    write_bytes(zeroes, (4 - file_pos_ % 4) % 4);
+    flush();
+
+    file_->write(list_, sizeof(uint32_t), nodes_ + 2);
+    file_->write(&num_bytes, sizeof(uint32_t), 1);
+    file_->write(&nodes_, sizeof(uint32_t), 1);
+    file_ = NULL;
+  }
+ private:
+  void write_bytes(const char *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+      buffer_[pos_++] = data[i];
+      if (PREDICT_FALSE(pos_ == kBufferSize))
+        flush();
+    }
+    file_pos_ += len;
+  }
+  void flush() {
+    if (file_->write(buffer_, 1, pos_) != pos_) {
+      perror("can not write names");
+      exit(1);
+    }
+    pos_ = 0;
+  }
+
+  File *file_;
+  uint32_t nodes_;
+  node_t cur_node_;
+  size_t pos_;  // position in buffer_
+  uint32_t file_pos_;  // bytes of names written so far
+  uint32_t *list_;  // beginning of each name
+  char *buffer_;  // [kBufferSize]
+ private:
+  DISALLOW_COPY_AND_ASSIGN(NameStoreWriter);
+};
+
+// Read-only access to names.bin
+class NameStore {
+ public:
+  explicit NameStore(File *file)
+  : file_(file), names_(NULL), list_(NULL), map_(NULL), map_size_(0),
+    num_bytes_(0), num_nodes_(0) { }
+
+  ~NameStore() {
+    if (map_) {
+      ::munmap(map_, map_size_);
+    } else {
+      delete[] names_;
+      delete[] list_;
+    }
+  }
+
+  void Init(bool mMap) {
+    assert(names_ == NULL);
+    uint32_t tmp[2];
+    // Read from back
+    file_->seek(-off_t(sizeof(uint32_t) * 2), SEEK_END);
+    file_->read(tmp, sizeof(uint32_t), 2);
+    file_->seek(0, SEEK_SET);
+
+    num_bytes_ = tmp[0];
+    num_nodes_ = tmp[1];
+    size_t padded = (num_bytes_ + 3) / 4 * 4;
+
+    if (!mMap) {
+      names_ = new char[ padded ];
+      file_->read(names_, 1, padded);
+      list_ = new uint32_t[ num_nodes_ + 2 ];
+      file_->read(list_, sizeof(uint32_t), num_nodes_ + 2);
+    } else {
+      map_size_ = padded + (num_nodes_ + 2) * sizeof(uint32_t);
+      map_ = ::mmap(NULL, map_size_, PROT_READ, MAP_SHARED, file_->fdno(), 0);
+      if (map_ == MAP_FAILED) {
+        perror("mmap failed");
+        exit(1);
+      }
+      names_ = reinterpret_cast<char*>(map_);
+      list_ = reinterpret_cast<uint32_t*>(names_ + padded);
+    }
+  }
+
+  // Name with prefix, for example "a:Main_Page".
+  // Empty string for nodes that do not have a name.
+  string name(node_t node) const {
+    if (node < 1 || node > num_nodes_)
+      return string();
+    return string(names_ + list_[node], list_[node + 1] - list_[node]);
+  }
+
+  uint32_t num_nodes() const {
+    return num_nodes_;
+  }
+
+  // Node with the name, 0 if there is none. Names are not indexed, every
+  // node is checked.
+  node_t Find(const string &name) const {
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (list_[node + 1] - list_[node] == name.size()
+          && !memcmp(names_ + list_[node], name.data(), name.size()))
+        return node;
+    }
+    return 0;
+  }
+
+  // Node of other with the same name for every node (0 if there is none),
+  // for example to carry values over to node ids of another month.
+  void Match(const NameStore &other, vector<node_t> *other_node) const {
+    vector<node_t> mine, theirs;
+    SortedByName(&mine);
+    other.SortedByName(&theirs);
+    other_node->assign(num_nodes_ + 1, 0);
+    size_t i = 0, j = 0;
+    while (i < mine.size() && j < theirs.size()) {
+      int cmp = Compare(mine[i], other, theirs[j]);
+      if (cmp < 0) {
+        i++;
+      } else if (cmp > 0) {
+        j++;
+      } else {
+        (*other_node)[mine[i++]] = theirs[j++];
+      }
+    }
+  }
+
+ private:
+  struct ByName {
+    explicit ByName(const NameStore *store) : store(store) { }
+    bool operator()(node_t a, node_t b) const {
+      return store->Compare(a, *store, b) < 0;
+    }
+    const NameStore *store;
+  };
+
+  // Nodes which have a name
+  void SortedByName(vector<node_t> *nodes) const {
+    nodes->clear();
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (list_[node + 1] > list_[node])
+        nodes->push_back(node);
+    }
+    std::sort(nodes->begin(), nodes->end(), ByName(this));
+  }
+
+  int Compare(node_t node, const NameStore &other, node_t other_node) const {
+    const char *name = names_ + list_[node];
+    const char *other_name = other.names_ + other.list_[other_node];
+    uint32_t len = list_[node + 1] - list_[node];
+    uint32_t other_len = other.list_[other_node + 1] - other.list_[other_node];
+    int cmp = memcmp(name, other_name, std::min(len, other_len));
+    if (cmp)
+      return cmp;
+    return len < other_len ? -1 : (len > other_len ? 1 : 0);
+  }
+
+  File *file_;
+  char *names_;
+  uint32_t *list_;
+  void *map_;
+  size_t map_size_;
+  uint32_t num_bytes_, num_nodes_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(NameStore);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_NAME_STORE_H_
@@ -0,0 +1,117 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_NODE_ARRAY_H_
+#define SRC_NODE_ARRAY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "wikigraph_stubs_internal.h"
+#include "file_io.h"
+
+namespace wikigraph {
+
+// Values computed for every node of a graph (for example component of each
+// node) are saved in files similar to *.graph files:
+//
+//  [values of nodes 0 .. num_nodes][num_nodes][checksum][kNodeArrayMagic]
+//
+// Checksum identifies the graph, values of another graph are not loaded.
+const uint32_t kNodeArrayMagic = 0x4e415247;  // "GRAN"
+
+template<class T>
+void WriteNodeArray(File *f, const T *values, uint32_t num_nodes,
+    uint32_t checksum) {
+  f->write(values, sizeof(T), num_nodes + 1);
+  uint32_t trailer[3] = { num_nodes, checksum, kNodeArrayMagic };
+  f->write(trailer, sizeof(uint32_t), 3);
+}
+
+template<class T>
+bool ReadNodeArray(File *f, uint32_t num_nodes, uint32_t checksum,
+    T *values) {
+  f->seek(0, SEEK_END);
+  off_t size = f->tell();
+  off_t expected = sizeof(T) * (num_nodes + 1) + sizeof(uint32_t) * 3;
+  if (size != expected)
+    return false;
+  uint32_t trailer[3];
+  f->seek(-off_t(sizeof(trailer)), SEEK_END);
+  f->read(trailer, sizeof(uint32_t), 3);
+  if (trailer[0] != num_nodes || trailer[1] != checksum
+      || trailer[2] != kNodeArrayMagic)
+    return false;
+  f->seek(0, SEEK_SET);
+  return f->read(values, sizeof(T), num_nodes + 1) == num_nodes + 1;
+}
+
+// Several workers may save the same file, each one writes its own
+// temporary file which replaces the old file when complete.
+inline string TempFileName(const string &fname) {
+  char suffix[30];
+  snprintf(suffix, sizeof(suffix), ".%d.tmp", static_cast<int>(getpid()));
+  return fname + suffix;
+}
+
+template<class T>
+bool SaveNodeArray(const string &fname, const T *values, uint32_t num_nodes,
+    uint32_t checksum) {
+  string tmpname = TempFileName(fname);
+  SystemFile f;
+  if (!f.open(tmpname.c_str(), "wb"))
+    return false;
+  WriteNodeArray(&f, values, num_nodes, checksum);
+  f.close();
+  return rename(tmpname.c_str(), fname.c_str()) == 0;
+}
+
+template<class T>
+bool LoadNodeArray(const string &fname, uint32_t num_nodes,
+    uint32_t checksum, T *values) {
+  SystemFile f;
+  if (!f.open(fname.c_str(), "rb"))
+    return false;
+  bool loaded = ReadNodeArray(&f, num_nodes, checksum, values);
+  f.close();
+  return loaded;
+}
+
+// Values of another graph (for example the graph of the previous month, its
+// node ids are different), checksum is not checked. Returns the number of
+// nodes of that graph, 0 if the file is not a node array.
+template<class T>
+uint32_t ReadOtherNodeArray(File *f, vector<T> *values) {
+  uint32_t trailer[3];
+  f->seek(0, SEEK_END);
+  off_t size = f->tell();
+  if (size < off_t(sizeof(trailer)))
+    return 0;
+  f->seek(-off_t(sizeof(trailer)), SEEK_END);
+  f->read(trailer, sizeof(uint32_t), 3);
+  off_t expected = sizeof(T) * (off_t(trailer[0]) + 1) + sizeof(trailer);
+  if (trailer[2] != kNodeArrayMagic || size != expected)
+    return 0;
+  values->resize(size_t(trailer[0]) + 1);
+  f->seek(0, SEEK_SET);
+  if (f->read(&(*values)[0], sizeof(T), values->size()) != values->size())
+    return 0;
+  return trailer[0];
+}
+
+template<class T>
+uint32_t LoadOtherNodeArray(const string &fname, vector<T> *values) {
+  SystemFile f;
+  if (!f.open(fname.c_str(), "rb"))
+    return 0;
+  uint32_t loaded = ReadOtherNodeArray(&f, values);
+  f.close();
+  return loaded;
+}
+
+}  // namespace wikigraph
+
+#endif  // SRC_NODE_ARRAY_H_
@@ -0,0 +1,216 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_PAGERANK_H_
+#define SRC_PAGERANK_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+struct PageRankOptions {
+  PageRankOptions()
+  : damping(0.85), tolerance(1e-6), max_iterations(200),
+    gauss_seidel(false), single_precision(true), verbose(false) { }
+
+  double damping;  // probability of following a link
+  double tolerance;  // stop when L1 change of ranks is smaller
+  uint32_t max_iterations;
+  bool gauss_seidel;  // update ranks in place, single thread
+  bool single_precision;  // float instead of double ranks while iterating
+  bool verbose;  // print change of each iteration
+};
+
+// PageRank of valid nodes, links to and from invalid nodes are ignored.
+// A random surfer follows a random link with probability damping, otherwise
+// (or if the node has no links) it jumps to a random node, so ranks always
+// sum to 1.
+//
+// Ranks are pulled over the reverse graph: each node sums rank / out_degree
+// of nodes linking to it, plus the share of the jump and of rank of nodes
+// without links. With Jacobi iteration (default) new ranks are computed
+// from the old ones by all threads. Gauss-Seidel uses new ranks as soon as
+// they are known, which usually needs fewer iterations but runs in one
+// thread. Iteration starts from the given ranks, so ranks of a similar
+// graph (previous month) are a good start.
+template<class Real>
+class PageRankSolver {
+ public:
+  PageRankSolver(Graph *reverse, BitArray *invalid_node)
+  : reverse_(reverse), invalid_node_(invalid_node),
+    num_nodes_(reverse->num_nodes), num_valid_(0), num_iterations_(0),
+    delta_(0.0) {
+    inv_degree_ = new Real[num_nodes_ + 1];
+    vector<uint32_t> degree(num_nodes_ + 1, 0);
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (!Valid(node))
+        continue;
+      num_valid_++;
+      for (uint32_t e = reverse_->start(node); e < reverse_->end(node); e++)
+        degree[reverse_->edges[e]]++;
+    }
+    for (node_t node = 0; node <= num_nodes_; node++) {
+      bool links = node && Valid(node) && degree[node];
+      inv_degree_[node] = links ? Real(1.0) / degree[node] : Real(0.0);
+      if (node && Valid(node) && !degree[node])
+        dangling_.push_back(node);
+    }
+  }
+
+  ~PageRankSolver() {
+    delete[] inv_degree_;
+  }
+
+  // rank has num_nodes + 1 elements and holds the starting ranks (which
+  // need not sum to 1), returns the number of iterations.
+  uint32_t Run(const PageRankOptions &options, Real *rank) {
+    options_ = options;
+    Normalize(rank);
+    Real *start = rank;
+    Real *next = options.gauss_seidel ? NULL : new Real[num_nodes_ + 1];
+    for (num_iterations_ = 0; num_iterations_ < options.max_iterations; ) {
+      num_iterations_++;
+      if (options.gauss_seidel) {
+        delta_ = GaussSeidel(rank);
+      } else {
+        delta_ = Jacobi(rank, next);
+        std::swap(rank, next);
+      }
+      if (options.verbose)
+        printf("Iteration %d delta: %lg\n", static_cast<int>(num_iterations_),
+            delta_);
+      if (delta_ < options.tolerance)
+        break;
+    }
+    if (next) {
+      if (rank != start) {  // latest ranks are in our array
+        std::copy(rank, rank + num_nodes_ + 1, start);
+        std::swap(rank, next);
+      }
+      delete[] next;
+    }
+    return num_iterations_;
+  }
+
+  // L1 change of ranks in the last iteration
+  double delta() const {
+    return delta_;
+  }
+
+ private:
+  bool Valid(node_t node) const {
+    return !invalid_node_ || !invalid_node_->get_value(node);
+  }
+
+  // Ranks of valid nodes sum to 1, other nodes get 0
+  void Normalize(Real *rank) {
+    double sum = 0.0;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (!Valid(node) || !(rank[node] > 0))  // also NaN
+        rank[node] = 0;
+      sum += rank[node];
+    }
+    rank[0] = 0;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (!Valid(node))
+        continue;
+      rank[node] = sum > 0 ? rank[node] / sum : Real(1.0) / num_valid_;
+    }
+  }
+
+  double DanglingRank(const Real *rank) const {
+    double sum = 0.0;
+    for (size_t i = 0; i < dangling_.size(); i++)
+      sum += rank[dangling_[i]];
+    return sum;
+  }
+
+  // Rank which every valid node gets from jumps
+  double Base(double dangling) const {
+    const double d = options_.damping;
+    return ((1.0 - d) + d * dangling) / num_valid_;
+  }
+
+  inline double Pull(const Real *rank, node_t node) const {
+    double sum = 0.0;
+    for (uint32_t e = reverse_->start(node); e < reverse_->end(node); e++) {
+      node_t from = reverse_->edges[e];
+      sum += rank[from] * inv_degree_[from];  // 0 for invalid nodes
+    }
+    return options_.damping * sum;
+  }
+
+  struct JacobiBody {
+    const PageRankSolver *s;
+    const Real *rank;
+    Real *next;
+    double base;
+    vector<double> delta;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++) {
+        if (!s->Valid(node)) {
+          next[node] = 0;
+          continue;
+        }
+        next[node] = base + s->Pull(rank, node);
+        delta[thread] += std::fabs(next[node] - rank[node]);
+      }
+    }
+  };
+
+  double Jacobi(const Real *rank, Real *next) {
+    JacobiBody body;
+    body.s = this;
+    body.rank = rank;
+    body.next = next;
+    body.base = Base(DanglingRank(rank));
+    body.delta.resize(NumThreads());
+    next[0] = 0;
+    ParallelFor(1, num_nodes_ + 1, 4096, &body);
+    double delta = 0.0;
+    for (size_t i = 0; i < body.delta.size(); i++)
+      delta += body.delta[i];
+    return delta;
+  }
+
+  double GaussSeidel(Real *rank) {
+    // Rank of dangling nodes is kept up to date as they change
+    double dangling = DanglingRank(rank);
+    double delta = 0.0;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (!Valid(node))
+        continue;
+      Real value = Base(dangling) + Pull(rank, node);
+      if (!inv_degree_[node])
+        dangling += value - rank[node];
+      delta += std::fabs(value - rank[node]);
+      rank[node] = value;
+    }
+    // Sum drifts from 1 since dangling rank changed during the sweep
+    Normalize(rank);
+    return delta;
+  }
+
+  Graph *reverse_;
+  BitArray *invalid_node_;
+  uint32_t num_nodes_;
+  uint32_t num_valid_;
+  Real *inv_degree_;  // 1 / out_degree, 0 if node has no valid links
+  vector<node_t> dangling_;  // valid nodes without valid links
+  PageRankOptions options_;
+  uint32_t num_iterations_;
+  double delta_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PageRankSolver);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_PAGERANK_H_
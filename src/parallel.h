@@ -0,0 +1,251 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_PARALLEL_H_
+#define SRC_PARALLEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "wikigraph_stubs_internal.h"
+
+namespace wikigraph {
+
+// Number of threads used by parallel algorithms, 0 means one per core
+inline int &num_threads_setting() {
+  static int num_threads = 0;
+  return num_threads;
+}
+
+inline void SetNumThreads(int num_threads) {
+  num_threads_setting() = num_threads;
+}
+
+inline int NumThreads() {
+  int num_threads = num_threads_setting();
+  if (num_threads < 1)
+    num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  return std::max(num_threads, 1);
+}
+
+// Calls body(begin, end, thread) for chunks of range [begin, end) from
+// NumThreads() threads. Chunks are taken from a shared counter, so threads
+// which get cheap chunks take more of them. thread is in [0, NumThreads())
+// and can be used to index per-thread data. Body is a functor:
+//
+//   struct CountEdges {
+//     void operator()(uint32_t begin, uint32_t end, int thread) { ... }
+//   };
+template<class Body>
+class ParallelForRunner {
+ public:
+  ParallelForRunner(uint32_t begin, uint32_t end, uint32_t chunk, Body *body)
+  : next_(begin), end_(end), chunk_(std::max(chunk, 1u)), body_(body) { }
+
+  void Run(int num_threads) {
+    if (next_ >= end_)
+      return;
+    if (num_threads == 1 || end_ - next_ <= chunk_) {
+      (*body_)(next_, end_, 0);
+      return;
+    }
+    vector<Worker> workers(num_threads);
+    vector<pthread_t> threads(num_threads);
+    for (int i = 1; i < num_threads; i++) {
+      workers[i].runner = this;
+      workers[i].thread = i;
+      if (pthread_create(&threads[i], NULL, RunWorker, &workers[i])) {
+        perror("pthread_create");
+        exit(1);
+      }
+    }
+    // Calling thread works as well
+    workers[0].runner = this;
+    workers[0].thread = 0;
+    RunWorker(&workers[0]);
+    for (int i = 1; i < num_threads; i++)
+      pthread_join(threads[i], NULL);
+  }
+
+ private:
+  struct Worker {
+    ParallelForRunner *runner;
+    int thread;
+  };
+  static void *RunWorker(void *arg) {
+    Worker *worker = reinterpret_cast<Worker*>(arg);
+    ParallelForRunner *self = worker->runner;
+    while (1) {
+      uint64_t begin = __sync_fetch_and_add(&self->next_, self->chunk_);
+      if (begin >= self->end_)
+        break;
+      uint64_t end = std::min<uint64_t>(begin + self->chunk_, self->end_);
+      (*self->body_)(begin, end, worker->thread);
+    }
+    return NULL;
+  }
+
+  volatile uint64_t next_;  // 64-bit, so it can not overflow
+  uint32_t end_;
+  uint32_t chunk_;
+  Body *body_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ParallelForRunner);
+};
+
+template<class Body>
+void ParallelFor(uint32_t begin, uint32_t end, uint32_t chunk, Body *body) {
+  ParallelForRunner<Body> runner(begin, end, chunk, body);
+  runner.Run(NumThreads());
+}
+
+// Calls body(task, thread) for every task in [0, num_tasks) from
+// NumThreads() threads, for a few tasks of uneven cost (BFS from different
+// sources) where chunks of ParallelFor would leave threads idle at the end.
+// Every thread starts with its own block of tasks and takes them from the
+// back, a thread which runs out steals the front half of the block of
+// another thread. Body is a functor:
+//
+//   struct Search {
+//     void operator()(uint32_t task, int thread) { ... }
+//   };
+template<class Body>
+class WorkStealingRunner {
+ public:
+  WorkStealingRunner(uint32_t num_tasks, Body *body)
+  : num_tasks_(num_tasks), body_(body) { }
+
+  void Run(int num_threads) {
+    num_threads = std::min<uint32_t>(num_threads, num_tasks_);
+    if (num_threads <= 1) {
+      for (uint32_t task = 0; task < num_tasks_; task++)
+        (*body_)(task, 0);
+      return;
+    }
+    queues_.resize(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+      pthread_mutex_init(&queues_[i].lock, NULL);
+      queues_[i].front = uint64_t(num_tasks_) * i / num_threads;
+      queues_[i].back = uint64_t(num_tasks_) * (i + 1) / num_threads;
+    }
+    vector<Worker> workers(num_threads);
+    vector<pthread_t> threads(num_threads);
+    for (int i = 1; i < num_threads; i++) {
+      workers[i].runner = this;
+      workers[i].thread = i;
+      if (pthread_create(&threads[i], NULL, RunWorker, &workers[i])) {
+        perror("pthread_create");
+        exit(1);
+      }
+    }
+    // Calling thread works as well
+    workers[0].runner = this;
+    workers[0].thread = 0;
+    RunWorker(&workers[0]);
+    for (int i = 1; i < num_threads; i++)
+      pthread_join(threads[i], NULL);
+    for (int i = 0; i < num_threads; i++)
+      pthread_mutex_destroy(&queues_[i].lock);
+  }
+
+ private:
+  struct TaskQueue {
+    pthread_mutex_t lock;
+    uint32_t front, back;  // tasks [front, back)
+  };
+  struct Worker {
+    WorkStealingRunner *runner;
+    int thread;
+  };
+
+  static void *RunWorker(void *arg) {
+    Worker *worker = reinterpret_cast<Worker*>(arg);
+    WorkStealingRunner *self = worker->runner;
+    uint32_t task;
+    while (self->Pop(worker->thread, &task)
+        || self->Steal(worker->thread, &task))
+      (*self->body_)(task, worker->thread);
+    return NULL;
+  }
+
+  bool Pop(int thread, uint32_t *task) {
+    TaskQueue *queue = &queues_[thread];
+    pthread_mutex_lock(&queue->lock);
+    bool found = queue->front < queue->back;
+    if (found)
+      *task = --queue->back;
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+  }
+
+  // Takes the first of stolen tasks, the rest goes to the (empty) queue of
+  // thread. False when there is nothing left to steal.
+  bool Steal(int thread, uint32_t *task) {
+    int num_queues = queues_.size();
+    for (int i = 1; i < num_queues; i++) {
+      TaskQueue *victim = &queues_[(thread + i) % num_queues];
+      pthread_mutex_lock(&victim->lock);
+      uint32_t take = (victim->back - victim->front + 1) / 2;
+      uint32_t begin = victim->front;
+      victim->front += take;
+      pthread_mutex_unlock(&victim->lock);
+      if (!take)
+        continue;
+      *task = begin;
+      TaskQueue *queue = &queues_[thread];
+      pthread_mutex_lock(&queue->lock);
+      queue->front = begin + 1;
+      queue->back = begin + take;
+      pthread_mutex_unlock(&queue->lock);
+      return true;
+    }
+    return false;
+  }
+
+  uint32_t num_tasks_;
+  Body *body_;
+  vector<TaskQueue> queues_;  // of every thread
+ private:
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingRunner);
+};
+
+template<class Body>
+void ParallelTasks(uint32_t num_tasks, Body *body) {
+  WorkStealingRunner<Body> runner(num_tasks, body);
+  runner.Run(NumThreads());
+}
+
+// Atomic operations on shared arrays, GCC builtins
+template<class T>
+inline T AtomicLoad(const T *ptr) {  // no ordering, only a whole value
+  return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+template<class T>
+inline void AtomicStore(T *ptr, T val) {  // no ordering, only a whole value
+  __atomic_store_n(ptr, val, __ATOMIC_RELAXED);
+}
+
+template<class T>
+inline T AtomicAdd(T *ptr, T val) {  // returns previous value
+  return __sync_fetch_and_add(ptr, val);
+}
+
+template<class T>
+inline T AtomicOr(T *ptr, T val) {  // returns previous value
+  return __sync_fetch_and_or(ptr, val);
+}
+
+template<class T>
+inline bool AtomicCas(T *ptr, T old_val, T new_val) {
+  return __sync_bool_compare_and_swap(ptr, old_val, new_val);
+}
+
+}  // namespace wikigraph
+
+#endif  // SRC_PARALLEL_H_
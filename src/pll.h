@@ -0,0 +1,270 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_PLL_H_
+#define SRC_PLL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "graph.h"
+#include "centrality.h"
+#include "file_io.h"
+
+namespace wikigraph {
+
+// Exact distances between nodes of one strongly connected component from
+// pruned landmark labeling (Akiba, Iwata & Yoshida). Every node has an out
+// label (hubs it reaches, with distances) and an in label (hubs reaching
+// it), so that
+//
+//   d(s,t) = min over hubs h in out(s) and in(t) of d(s,h) + d(h,t)
+//
+// Nodes are hubs in order of decreasing degree. A BFS from each hub adds it
+// to labels of the nodes it visits, but stops at nodes whose distance is
+// already given by earlier hubs, so later searches visit very few nodes.
+// Hubs in labels are ranks, sorted, and a query merges two labels.
+//
+// Shortest paths between nodes of a strongly connected component stay in
+// the component, only its nodes are labeled. Distances are stored in one
+// byte, so the component must have diameter below kMaxDist.
+//
+// Saved labels are [in offsets][in hubs][in distances], the same for out,
+// and [num_nodes][checksum][kLabelsMagic].
+class PrunedLabeling {
+ public:
+  static const uint8_t kMaxDist = 255;
+  static const int32_t kUnreachable = -1;
+  static const uint32_t kLabelsMagic = 0x4c4c5050;  // "PPLL"
+
+  PrunedLabeling(Graph *graph, Graph *reverse)
+  : graph_(graph), reverse_(reverse), num_nodes_(graph->num_nodes) { }
+
+  // Labels of the nodes with the given label of component. Returns false
+  // if the component has a too long shortest path, then no node is labeled.
+  bool Build(const uint32_t *labels, uint32_t component) {
+    vector<pair<uint32_t, node_t> > order;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (labels[node] != component)
+        continue;
+      uint32_t degree = graph_->end(node) - graph_->start(node)
+          + reverse_->end(node) - reverse_->start(node);
+      order.push_back(std::make_pair(degree, node));
+    }
+    std::sort(order.begin(), order.end(),
+        std::greater<pair<uint32_t, node_t> >());
+
+    vector<Label> in(num_nodes_ + 1), out(num_nodes_ + 1);
+    BfsWorkspace w(num_nodes_);
+    vector<uint8_t> hub_dist(order.size(), uint8_t(kMaxDist));
+    bool fits = true;
+    for (uint32_t rank = 0; fits && rank < order.size(); rank++) {
+      node_t hub = order[rank].second;
+      fits = Search(graph_, labels, component, rank, hub, out[hub], &in, &w,
+          &hub_dist)
+          && Search(reverse_, labels, component, rank, hub, in[hub], &out, &w,
+          &hub_dist);
+    }
+    if (!fits) {
+      in.assign(num_nodes_ + 1, Label());
+      out.assign(num_nodes_ + 1, Label());
+    }
+    in_.Compact(&in);
+    out_.Compact(&out);
+    return fits;
+  }
+
+  // Whether node has labels (is in the component)
+  bool Labeled(node_t node) const {
+    return out_.size(node) > 0;
+  }
+
+  // Distance between labeled nodes, kUnreachable if a node is not labeled
+  int32_t Distance(node_t from, node_t to) const {
+    const uint32_t *a = out_.hubs(from), *a_end = a + out_.size(from);
+    const uint32_t *b = in_.hubs(to), *b_end = b + in_.size(to);
+    const uint8_t *da = out_.dists(from), *db = in_.dists(to);
+    int32_t best = kUnreachable;
+    while (a < a_end && b < b_end) {
+      if (*a < *b) {
+        a++;
+        da++;
+      } else if (*b < *a) {
+        b++;
+        db++;
+      } else {
+        if (best == kUnreachable || *da + *db < best)
+          best = *da + *db;
+        a++;
+        da++;
+        b++;
+        db++;
+      }
+    }
+    return best;
+  }
+
+  // Number of hubs in all labels
+  uint64_t num_entries() const {
+    return in_.num_entries() + out_.num_entries();
+  }
+
+  // Checksum identifies the graph, as in node arrays
+  void Write(File *f, uint32_t checksum) {
+    in_.Write(f, num_nodes_);
+    out_.Write(f, num_nodes_);
+    uint32_t trailer[3] = { num_nodes_, checksum, kLabelsMagic };
+    f->write(trailer, sizeof(uint32_t), 3);
+  }
+
+  // Labels saved by Write for the same graph
+  bool Read(File *f, uint32_t checksum) {
+    uint32_t trailer[3];
+    f->seek(0, SEEK_END);
+    off_t size = f->tell();
+    if (size < off_t(sizeof(trailer)))
+      return false;
+    f->seek(-off_t(sizeof(trailer)), SEEK_END);
+    f->read(trailer, sizeof(uint32_t), 3);
+    if (trailer[0] != num_nodes_ || trailer[1] != checksum
+        || trailer[2] != kLabelsMagic)
+      return false;
+    f->seek(0, SEEK_SET);
+    return in_.Read(f, num_nodes_) && out_.Read(f, num_nodes_)
+        && f->tell() == size - off_t(sizeof(trailer));
+  }
+
+ private:
+  // Label of one node while labels are built
+  struct Label {
+    vector<uint32_t> hubs;
+    vector<uint8_t> dists;
+  };
+
+  // Labels of all nodes in one direction, one after another
+  class Labels {
+   public:
+    Labels() { }
+
+    void Compact(vector<Label> *labels) {
+      offset_.assign(labels->size() + 1, 0);
+      for (size_t node = 0; node < labels->size(); node++)
+        offset_[node + 1] = offset_[node] + (*labels)[node].hubs.size();
+      hubs_.resize(offset_.back());
+      dists_.resize(offset_.back());
+      for (size_t node = 0; node < labels->size(); node++) {
+        Label *label = &(*labels)[node];
+        std::copy(label->hubs.begin(), label->hubs.end(),
+            hubs_.begin() + offset_[node]);
+        std::copy(label->dists.begin(), label->dists.end(),
+            dists_.begin() + offset_[node]);
+        vector<uint32_t>().swap(label->hubs);
+        vector<uint8_t>().swap(label->dists);
+      }
+    }
+
+    uint32_t size(node_t node) const {
+      return offset_[node + 1] - offset_[node];
+    }
+
+    const uint32_t *hubs(node_t node) const {
+      return &hubs_[0] + offset_[node];
+    }
+
+    const uint8_t *dists(node_t node) const {
+      return &dists_[0] + offset_[node];
+    }
+
+    uint64_t num_entries() const {
+      return hubs_.size();
+    }
+
+    void Write(File *f, uint32_t num_nodes) {
+      f->write(&offset_[0], sizeof(uint64_t), num_nodes + 2);
+      if (hubs_.empty())
+        return;
+      f->write(&hubs_[0], sizeof(uint32_t), hubs_.size());
+      f->write(&dists_[0], sizeof(uint8_t), dists_.size());
+    }
+
+    bool Read(File *f, uint32_t num_nodes) {
+      offset_.resize(num_nodes + 2);
+      if (f->read(&offset_[0], sizeof(uint64_t), num_nodes + 2)
+          != num_nodes + 2)
+        return false;
+      hubs_.resize(offset_.back());
+      dists_.resize(offset_.back());
+      if (hubs_.empty())
+        return true;
+      return f->read(&hubs_[0], sizeof(uint32_t), hubs_.size())
+          == hubs_.size()
+          && f->read(&dists_[0], sizeof(uint8_t), dists_.size())
+          == dists_.size();
+    }
+
+   private:
+    vector<uint64_t> offset_;  // of node
+    vector<uint32_t> hubs_;  // ranks, sorted in each label
+    vector<uint8_t> dists_;
+  };
+
+  // BFS from hub over links, hub is added to labels (one direction) of
+  // visited nodes. Hubs of the opposite label of hub are in hub_dist, a
+  // node is pruned when some earlier hub gives the same distance.
+  bool Search(Graph *links, const uint32_t *component_of, uint32_t component,
+      uint32_t rank, node_t hub, const Label &hub_label,
+      vector<Label> *labels, BfsWorkspace *w, vector<uint8_t> *hub_dist) {
+    for (size_t i = 0; i < hub_label.hubs.size(); i++)
+      (*hub_dist)[hub_label.hubs[i]] = hub_label.dists[i];
+    bool fits = true;
+    w->Start(hub);
+    for (uint32_t top = 0; top < w->size(); top++) {
+      node_t node = w->queue()[top];
+      int32_t dist = w->dist()[node];
+      Label *label = &(*labels)[node];
+      if (Covered(*label, *hub_dist, dist))
+        continue;
+      if (dist >= kMaxDist) {
+        fits = false;
+        break;
+      }
+      label->hubs.push_back(rank);
+      label->dists.push_back(dist);
+      for (uint32_t e = links->start(node); e < links->end(node); e++) {
+        node_t next = links->edges[e];
+        if (!w->Visited(next) && component_of[next] == component)
+          w->Visit(next, dist + 1);
+      }
+    }
+    for (size_t i = 0; i < hub_label.hubs.size(); i++)
+      (*hub_dist)[hub_label.hubs[i]] = kMaxDist;
+    return fits;
+  }
+
+  static bool Covered(const Label &label, const vector<uint8_t> &hub_dist,
+      int32_t dist) {
+    for (size_t i = 0; i < label.hubs.size(); i++) {
+      uint8_t other = hub_dist[label.hubs[i]];
+      if (other != kMaxDist && other + label.dists[i] <= dist)
+        return true;
+    }
+    return false;
+  }
+
+  Graph *graph_;
+  Graph *reverse_;
+  uint32_t num_nodes_;
+  Labels in_;  // hubs which reach node
+  Labels out_;  // hubs reached from node
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PrunedLabeling);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_PLL_H_
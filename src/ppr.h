@@ -0,0 +1,160 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_PPR_H_
+#define SRC_PPR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <utility>
+
+#include "graph.h"
+
+namespace wikigraph {
+
+// Personalized PageRank of a source node (random walk which restarts at the
+// source with probability alpha), approximated by forward push (Andersen,
+// Chung & Lang). Every node has an estimate p and a residual r, which is
+// probability mass not yet pushed. Pushing node u keeps alpha * r[u] in
+// p[u] and spreads the rest equally over out-links of u, mass of nodes
+// without out-links returns to the source. Only nodes with
+// r[u] >= epsilon * out_degree(u) are pushed, so a query touches only the
+// neighbourhood of the source and the error of each estimate is bounded
+// by the residuals left behind.
+//
+// Arrays are allocated once and only the touched entries are reset, so the
+// same object answers many queries quickly.
+class PersonalizedPageRank {
+  enum {
+    kTouched = 1,
+    kQueued = 2
+  };
+
+ public:
+  explicit PersonalizedPageRank(Graph *graph)
+  : graph_(graph), num_nodes_(graph->num_nodes), num_pushes_(0) {
+    p_ = new double[num_nodes_ + 1];
+    r_ = new double[num_nodes_ + 1];
+    state_ = new uint8_t[num_nodes_ + 1];
+    memset(p_, 0, sizeof(p_[0]) * (num_nodes_ + 1));
+    memset(r_, 0, sizeof(r_[0]) * (num_nodes_ + 1));
+    memset(state_, 0, num_nodes_ + 1);
+  }
+
+  ~PersonalizedPageRank() {
+    delete[] p_;
+    delete[] r_;
+    delete[] state_;
+  }
+
+  // Nodes (other than the source) with the highest estimates
+  vector<pair<double, node_t> > Run(node_t source, double alpha,
+      double epsilon, uint32_t how_many) {
+    Reset();
+    std::deque<node_t> queue;
+    Touch(source);
+    r_[source] = 1.0;
+    state_[source] |= kQueued;
+    queue.push_back(source);
+    while (!queue.empty()) {
+      node_t node = queue.front();
+      queue.pop_front();
+      state_[node] &= ~kQueued;
+      uint32_t degree = graph_->end(node) - graph_->start(node);
+      if (r_[node] < epsilon * std::max(degree, 1u))
+        continue;
+      num_pushes_++;
+      double mass = r_[node];
+      p_[node] += alpha * mass;
+      r_[node] = 0.0;
+      mass *= 1.0 - alpha;
+      if (!degree) {
+        Add(source, mass, epsilon, &queue);
+        continue;
+      }
+      double share = mass / degree;
+      for (uint32_t e = graph_->start(node); e < graph_->end(node); e++)
+        Add(graph_->edges[e], share, epsilon, &queue);
+    }
+
+    vector<pair<double, node_t> > ret;
+    for (size_t i = 0; i < touched_.size(); i++) {
+      node_t node = touched_[i];
+      if (node != source && p_[node] > 0.0)
+        ret.push_back(std::make_pair(p_[node], node));
+    }
+    how_many = std::min<size_t>(how_many, ret.size());
+    std::partial_sort(ret.begin(), ret.begin() + how_many, ret.end(),
+        std::greater< pair<double, node_t> >());
+    ret.resize(how_many);
+    return ret;
+  }
+
+  // Estimate and residual of node after the last Run
+  double estimate(node_t node) const {
+    return p_[node];
+  }
+
+  double residual(node_t node) const {
+    return r_[node];
+  }
+
+  // Pushes done by the last Run
+  uint32_t num_pushes() const {
+    return num_pushes_;
+  }
+
+  // Nodes touched by the last Run
+  uint32_t num_touched() const {
+    return touched_.size();
+  }
+
+ private:
+  void Reset() {
+    for (size_t i = 0; i < touched_.size(); i++) {
+      node_t node = touched_[i];
+      p_[node] = r_[node] = 0.0;
+      state_[node] = 0;
+    }
+    touched_.clear();
+    num_pushes_ = 0;
+  }
+
+  inline void Touch(node_t node) {
+    if (!(state_[node] & kTouched)) {
+      state_[node] |= kTouched;
+      touched_.push_back(node);
+    }
+  }
+
+  inline void Add(node_t node, double mass, double epsilon,
+      std::deque<node_t> *queue) {
+    Touch(node);
+    r_[node] += mass;
+    if (state_[node] & kQueued)
+      return;
+    uint32_t degree = graph_->end(node) - graph_->start(node);
+    if (r_[node] >= epsilon * std::max(degree, 1u)) {
+      state_[node] |= kQueued;
+      queue->push_back(node);
+    }
+  }
+
+  Graph *graph_;
+  uint32_t num_nodes_;
+  double *p_;
+  double *r_;
+  uint8_t *state_;
+  vector<node_t> touched_;
+  uint32_t num_pushes_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PersonalizedPageRank);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_PPR_H_
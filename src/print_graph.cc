@@ -3,15 +3,35 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include "graph.h"
+#include "name_store.h"
 
 namespace wikigraph {
 
-int print_graph(char *fname) {
+void print_node(node_t node, NameStore *names) {
+  if (names) {
+    printf("%"PRIu32" (%s)", node, names->name(node).c_str());
+  } else {
+    printf("%"PRIu32, node);
+  }
+}
+
+int print_graph(char *fname, char *names_fname) {
   SystemFile f;
   if (!f.open(fname, "rb")) {
     fprintf(stderr, "Could not open %s\n", fname);
     return 1;
   }
+  // Optionally, resolve node ids to names
+  SystemFile f_names;
+  NameStore *names = NULL;
+  if (names_fname) {
+    if (!f_names.open(names_fname, "rb")) {
+      fprintf(stderr, "Could not open %s\n", names_fname);
+      return 1;
+    }
+    names = new NameStore(&f_names);
+    names->Init(true);
+  }
   BufferedReader<uint32_t> reader(&f);
   StreamGraphReader graph(&reader);
   graph.init();
@@ -20,22 +40,28 @@ int print_graph(char *fname) {
   NodeStream node;
   while (graph.has_next()) {
     graph.next_node(&node);
-    printf("%"PRIu32": ", node.id);
+    print_node(node.id, names);
+    printf(": ");
     for (size_t i = 0; i < node.list.size(); i++) {
-      printf(" %"PRIu32, node.list[i]);
+      printf(" ");
+      print_node(node.list[i], names);
     }
     printf("\n");
   }
+  if (names) {
+    delete names;
+    f_names.close();
+  }
   return 0;
 }
 
 }  // namespace wikigraph
 
 int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    fprintf(stderr, "Usage: %s file.graph\n", argv[0]);
+  if (argc != 2 && argc != 3) {
+    fprintf(stderr, "Usage: %s file.graph [names.bin]\n", argv[0]);
     return 1;
   }
-  return wikigraph::print_graph(argv[1]);
+  return wikigraph::print_graph(argv[1], argc == 3 ? argv[2] : NULL);
 }
 
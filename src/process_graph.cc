@@ -7,19 +7,27 @@
 #include <cassert>
 #include <climits>
 
+#include <dirent.h>
+#include <fcntl.h>
 #include <getopt.h>
+#include <sys/file.h>
 #include <unistd.h>
 #include <time.h>
 
 #include <algorithm>
+#include <deque>
 #include <map>
 #include <string>
 
 #include "config.h"
 #include "wikigraph_stubs_internal.h"
 #include "redis.h"
+#include "redis_async.h"
 #include "file_io.h"
 #include "graph_algo.h"
+#include "name_store.h"
+#include "result_builder.h"
+#include "result_cache.h"
 
 namespace wikigraph {
 
@@ -29,54 +37,933 @@ void print_help(char *prg) {
   printf("-f N\tStart N background workers\n");
   printf("-r HOST\tName of the host of redis server, default:%s\n", REDIS_HOST);
   printf("-p PORT\tPort of redis server, default:%d\n", REDIS_PORT);
+  printf("-n FILE\tNames of nodes, default:names.bin (optional)\n");
+  printf("-t N\tThreads per worker, default: cores divided by workers\n");
+  printf("-s N\tSampled sources for centrality, default:%d\n",
+      CENTRALITY_SAMPLES);
+  printf("-w DIR\tPageRank starts from ranks of the previous month in DIR\n");
+  printf("-l\tLocal mode, read jobs from stdin and write results to stdout\n");
+  printf("-b\tWrite results in the binary encoding instead of JSON\n");
+  printf("-q N\tPrefetch N jobs, results are written without waiting\n");
   printf("-h\tShow this help\n");
   printf("\n");
   printf("Visit https://github.com/emiraga/wikigraph for more info.\n");
 }
 
-string graph_command(char *job, node_t node, CompleteGraphAlgo *graph,
-    uint32_t num_nodes, bool verbose) {
-  string result;
+// One of the graphs with everything that jobs on it need
+struct GraphContext {
+  CompleteGraphAlgo *graph;
+  const char *name;  // results are saved as <name>.<ext>, e.g. artlinks.scc
+  NameStore *names;  // NULL if names.bin is not available
+  uint32_t num_nodes;
+  uint32_t samples;  // for centrality estimates
+  const char *previous;  // directory of the previous month, or NULL
+  CompleteGraphAlgo *categories;  // directed category links, or NULL
+  node_t category_root;  // Contents, 0 if names are not loaded
+  bool verbose;
+};
+
+// Component labels are computed once and saved next to the graph, so that
+// other workers (and later runs) can load them.
+void load_scc(GraphContext *ctx) {
+  if (ctx->graph->HasSccLabels())
+    return;
+  string fname = string(ctx->name) + ".scc";
+  if (!ctx->graph->LoadSccLabels(fname)) {
+    ctx->graph->SccLabels();
+    ctx->graph->SaveSccLabels(fname);
+  }
+}
+
+void load_wcc(GraphContext *ctx) {
+  if (ctx->graph->HasWccLabels())
+    return;
+  string fname = string(ctx->name) + ".wcc";
+  if (!ctx->graph->LoadWccLabels(fname)) {
+    ctx->graph->WccLabels();
+    ctx->graph->SaveWccLabels(fname);
+  }
+}
+
+void load_communities(GraphContext *ctx) {
+  if (ctx->graph->HasCommunities())
+    return;
+  string fname = string(ctx->name) + ".lpa";
+  if (!ctx->graph->LoadCommunities(fname))
+    ctx->graph->SaveCommunities(fname, COMMUNITY_MAX_ITERATIONS);
+}
+
+void load_core(GraphContext *ctx) {
+  if (ctx->graph->HasCoreNumbers())
+    return;
+  string fname = string(ctx->name) + ".core";
+  if (!ctx->graph->LoadCoreNumbers(fname)) {
+    ctx->graph->CoreNumbers();
+    ctx->graph->SaveCoreNumbers(fname);
+  }
+}
+
+void load_triangles(GraphContext *ctx) {
+  if (ctx->graph->HasTriangles())
+    return;
+  string fname = string(ctx->name) + ".tri";
+  if (!ctx->graph->LoadTriangles(fname)) {
+    ctx->graph->Triangles();
+    ctx->graph->SaveTriangles(fname);
+  }
+}
+
+void load_landmarks(GraphContext *ctx) {
+  if (ctx->graph->HasLandmarks())
+    return;
+  string fname = string(ctx->name) + ".lmk";
+  if (!ctx->graph->LoadLandmarks(fname)) {
+    ctx->graph->Landmarks();
+    ctx->graph->SaveLandmarks(fname);
+  }
+}
+
+void load_distance_labels(GraphContext *ctx) {
+  if (ctx->graph->HasDistanceLabels())
+    return;
+  load_scc(ctx);
+  string fname = string(ctx->name) + ".pll";
+  if (!ctx->graph->LoadDistanceLabels(fname))
+    ctx->graph->SaveDistanceLabels(fname);
+}
+
+// Second node of jobs like P<node>,<node>, 0 if it is missing or invalid
+node_t second_node(const char *job, GraphContext *ctx) {
+  const char *comma = strchr(job, ',');
+  if (!comma || !isdigit(comma[1]))
+    return 0;
+  node_t node = atoi(comma + 1);
+  if (node < 1 || node > ctx->num_nodes)
+    return 0;
+  BitArray *invalid_node = ctx->graph->invalid_node();
+  if (invalid_node && invalid_node->get_value(node))
+    return 0;
+  return node;
+}
+
+// Ranks of the previous month are a good start, PageRank then needs only a
+// few iterations. Node ids follow the order of page.sql and change between
+// months, so ranks are moved to the nodes with the same names. Both months
+// need names.bin.
+void start_ranks(GraphContext *ctx, const string &fname) {
+  string dir = string(ctx->previous) + "/";
+  SystemFile f_names;
+  if (!ctx->names || !f_names.open((dir + "names.bin").c_str(), "rb"))
+    return;
+  NameStore previous(&f_names);
+  previous.Init(true);
+  f_names.close();
+  vector<node_t> previous_node;
+  ctx->names->Match(previous, &previous_node);
+  uint32_t matched = ctx->graph->StartRanks(dir + fname, previous_node);
+  if (ctx->verbose)
+    printf("Ranks of %u nodes from %s\n", matched, dir.c_str());
+}
+
+void load_ranks(GraphContext *ctx) {
+  if (ctx->graph->HasRanks())
+    return;
+  string fname = string(ctx->name) + ".rank";
+  if (ctx->graph->LoadRanks(fname))
+    return;
+  if (ctx->previous)
+    start_ranks(ctx, fname);
+  PageRankOptions options;
+  options.damping = PAGERANK_DAMPING;
+  options.tolerance = PAGERANK_TOLERANCE;
+  options.max_iterations = PAGERANK_MAX_ITERATIONS;
+  options.gauss_seidel = PAGERANK_GAUSS_SEIDEL;
+  options.single_precision = !PAGERANK_DOUBLE;
+  options.verbose = ctx->verbose;
+  ctx->graph->Ranks(options);
+  ctx->graph->SaveRanks(fname);
+}
+
+void graph_command(char *job, node_t node, GraphContext *ctx,
+    ResultBuilder *result) {
+  CompleteGraphAlgo *graph = ctx->graph;
   switch (job[0]) {
     case 'D': {  // count distances from node
-      vector<uint32_t> cntdist = graph->GetDistances(node);
-      result = "{\"count_dist\":" + util::to_json(cntdist) + "}";
+      result->Add("count_dist", graph->GetDistances(node));
     }
     break;
     case 'S': {  // Sizes of strongly connected components
-      vector<pii> components = util::count_items(graph->Scc());
-      result = "{\"components\":" + util::to_json(components) + "}";
+      load_scc(ctx);
+      result->Add("components", util::count_items(graph->Scc()));
+    }
+    break;
+    case 'C': {  // Strongly connected component of node
+      load_scc(ctx);
+      result->Add("scc", graph->SccLabels()[node]);
+      result->Add("size", graph->SccSize(node));
+    }
+    break;
+    case 'W': {  // Weakly connected components, or component of node
+      load_wcc(ctx);
+      if (!node) {
+        result->Add("components", util::count_items(graph->Wcc()));
+        break;
+      }
+      result->Add("wcc", graph->WccLabels()[node]);
+      result->Add("size", graph->WccSize(node));
+    }
+    break;
+    case 'X': {  // Diameter of the largest strongly connected component
+      load_scc(ctx);
+      DiameterSolver *diameter = graph->Diameter();
+      result->Add("diameter", diameter->diameter());
+      result->Add("size", diameter->size());
+      result->Add("bfs", diameter->num_bfs());
+    }
+    break;
+    case 'E': {  // Bounds of eccentricity of node
+      load_scc(ctx);
+      DiameterSolver *diameter = graph->Diameter();
+      if (!diameter->InComponent(node)) {
+        result->Error("Node is not in the largest component");
+        break;
+      }
+      result->Add("lower", diameter->lower(node));
+      result->Add("upper", diameter->upper(node));
+    }
+    break;
+    case 'B': {  // Betweenness centrality, estimated
+      uint32_t samples = ctx->samples;
+      double error;
+      vector<pair<double, node_t> > top = graph->Betweenness(
+          CENTRALITY_RESULTS, &samples, &error);
+      result->Add("betweenness", top);
+      result->Add("samples", samples);
+      result->Add("error", error);
+    }
+    break;
+    case 'O': {  // Closeness centrality, estimated and refined
+      load_scc(ctx);
+      result->Add("closeness", graph->SampledClosest(CENTRALITY_RESULTS,
+          ctx->samples));
+    }
+    break;
+    case 'T': {  // Closeness centrality, exact top nodes
+      load_scc(ctx);
+      uint32_t num_cut;
+      vector<pair<double, node_t> > top = graph->TopClosest(
+          CENTRALITY_RESULTS, &num_cut);
+      result->Add("closeness", top);
+      result->Add("cut", num_cut);
+    }
+    break;
+    case 'K': {  // Core numbers, or core number of node
+      load_core(ctx);
+      const uint32_t *core = graph->CoreNumbers();
+      if (node) {
+        result->Add("core", core[node]);
+        break;
+      }
+      BitArray *invalid_node = graph->invalid_node();
+      vector<uint32_t> cores;
+      for (node_t i = 1; i <= ctx->num_nodes; i++) {
+        if (!invalid_node || !invalid_node->get_value(i))
+          cores.push_back(core[i]);
+      }
+      vector<pii> histogram = util::count_items(cores);
+      result->Add("cores", histogram);
+      result->Add("degeneracy", histogram.empty() ? 0 : histogram.back().first);
+    }
+    break;
+    case 'M': {  // Communities, or community of node
+      load_communities(ctx);
+      if (!node) {
+        result->Add("communities",
+            util::count_items(graph->CommunitySizes(COMMUNITY_MAX_ITERATIONS)));
+        break;
+      }
+      result->Add("community",
+          graph->Communities(COMMUNITY_MAX_ITERATIONS)[node]);
+      result->Add("size", graph->CommunitySize(node, COMMUNITY_MAX_ITERATIONS));
+    }
+    break;
+    case 'G': {  // Triangles and clustering, of the graph or of node
+      load_triangles(ctx);
+      if (node) {
+        result->Add("triangles", graph->Triangles()[node]);
+        result->Add("clustering", graph->Clustering(node));
+        break;
+      }
+      uint64_t triangles;
+      double average, transitivity;
+      graph->ClusteringInfo(&triangles, &average, &transitivity);
+      result->Add("triangles", triangles);
+      result->Add("clustering", average);
+      result->Add("transitivity", transitivity);
+    }
+    break;
+    case 'Q': {  // Related nodes, by personalized PageRank of node
+      if (!node) {
+        result->Error("Node is required");
+        break;
+      }
+      uint32_t num_pushes;
+      vector<pair<double, node_t> > related = graph->Related(node,
+          PPR_ALPHA, PPR_EPSILON, PPR_RESULTS, &num_pushes);
+      result->Add("related", related);
+      result->Add("pushes", num_pushes);
     }
     break;
     case 'I': {  // Degree info
       pii degrees = graph->DegreeInfo(node);
-      char msg[50];
-      snprintf(msg, sizeof(msg),
-          "{\"in_degree\":%"PRIu32",\"out_degree\":%"PRIu32"}",
-          degrees.first, degrees.second);
-      result = string(msg);
+      result->Add("in_degree", degrees.first);
+      result->Add("out_degree", degrees.second);
     }
     break;
     case 'R': {  // Page Rank
-      vector<pair<double, node_t> > rankp =
-        graph->PageRank(PAGERANK_RESULTS, verbose);
-      result = "{\"ranks\":" + util::to_json(rankp) + "}";
+      load_ranks(ctx);
+      result->Add("ranks",
+          graph->PageRank(PAGERANK_RESULTS, PageRankOptions()));
+      result->Add("iterations", graph->num_iterations());
+    }
+    break;
+    case 'H': {  // HITS, top hubs and authorities
+      uint32_t iterations = graph->Hits(HITS_TOLERANCE, HITS_MAX_ITERATIONS);
+      if (ctx->verbose)
+        printf("HITS iterations: %"PRIu32"\n", iterations);
+      result->Add("hubs", graph->TopNodes(graph->hubs(), HITS_RESULTS));
+      result->Add("authorities",
+          graph->TopNodes(graph->authorities(), HITS_RESULTS));
+    }
+    break;
+    case 'A': {  // Categories above node
+      if (!ctx->categories) {
+        result->Error("Category hierarchy is not loaded");
+        break;
+      }
+      if (!node) {
+        result->Error("Node is required");
+        break;
+      }
+      CategoryHierarchy *hierarchy =
+          ctx->categories->Hierarchy(ctx->category_root);
+      result->Add("level", hierarchy->level(node));
+      // Nodes which are not below the root have no depth
+      if (hierarchy->depth(node) != CategoryHierarchy::kNoDepth)
+        result->Add("depth", hierarchy->depth(node));
+      result->Add("ancestors", hierarchy->CountAncestors(node));
+      result->Add("parents", hierarchy->Parents(node));
+      result->Add("top", hierarchy->TopAncestors(node));
+    }
+    break;
+    case 'P': {  // Distance between two nodes, P<from>,<to>
+      node_t target = second_node(job, ctx);
+      if (!node || !target) {
+        result->Error("Two nodes are required");
+        break;
+      }
+      load_landmarks(ctx);
+      int32_t lower, upper;
+      graph->Landmarks()->Bounds(node, target, &lower, &upper);
+      // Bounds are enough if they meet, otherwise search
+      int32_t distance = lower == upper ? lower : graph->Distance(node, target);
+      result->Add("lower", lower);
+      result->Add("upper", upper);
+      result->Add("distance", distance);
+    }
+    break;
+    case 'L': {  // Exact distance in the largest component, L<from>,<to>
+      node_t target = second_node(job, ctx);
+      if (!node || !target) {
+        result->Error("Two nodes are required");
+        break;
+      }
+      load_distance_labels(ctx);
+      PrunedLabeling *labeling = graph->DistanceLabels();
+      if (!labeling->num_entries()) {
+        result->Error("Distance labels are not available");
+        break;
+      }
+      if (!labeling->Labeled(node) || !labeling->Labeled(target)) {
+        result->Error("Node is not in the largest component");
+        break;
+      }
+      result->Add("distance", labeling->Distance(node, target));
+    }
+    break;
+    case 'N': {  // Name of the node
+      if (!ctx->names) {
+        result->Error("Names are not loaded");
+        break;
+      }
+      result->Add("name", ctx->names->name(node));
+    }
+    break;
+    default:
+      result->Error("Unknown command");
+  }
+}
+
+// Graphs and data that are shared by all jobs
+struct WorkerData {
+  GraphContext art;
+  GraphContext cat;
+  BitArray *is_category;
+  uint32_t num_nodes;
+  bool binary;  // results in the binary encoding, see result_builder.h
+  ResultCache *cache;  // results of earlier jobs, NULL if not kept
+  string cache_file;  // where this worker saves them, empty if it does not
+  string cache_stamp;  // what results depend on, see ResultCache
+  time_t cache_saved;
+};
+
+// Graph and node of a valid job for distances from a node (xD<node>),
+// which can be computed in a batch with other such jobs. NULL otherwise.
+GraphContext *distance_job(const char *job, WorkerData *w, node_t *node) {
+  if ((job[0] != 'a' && job[0] != 'c') || job[1] != 'D' || !isdigit(job[2]))
+    return NULL;
+  *node = atoi(job + 2);
+  if (*node < 1 || *node > w->num_nodes)
+    return NULL;
+  if (job[0] == 'c')
+    return &w->cat;
+  return w->is_category->get_value(*node) ? NULL : &w->art;
+}
+
+// Computes a single job and returns its result, no_result is set for jobs
+// which should not store any results.
+string compute_job(char *job, WorkerData *w, bool verbose, bool *no_result) {
+  ResultBuilder result(w->binary);
+  *no_result = false;
+
+  switch (job[0]) {
+    // command
+    case 'a': {  // for articles graph
+      node_t node = 0;
+      if (isdigit(job[2])) {
+        node = atoi(job+2);
+        if (node < 1 || node > w->num_nodes) {
+          result.Error("Node out of range");
+          break;
+        }
+        if (w->is_category->get_value(node)) {
+          result.Error("Node is category");
+          break;
+        }
+      }
+      w->art.verbose = verbose;
+      graph_command(job+1, node, &w->art, &result);
+    }
+    break;
+    // command
+    case 'c': {  // for categories graph
+      node_t node = 0;
+      if (isdigit(job[2])) {
+        node = atoi(job+2);
+        if (node < 1 || node > w->num_nodes) {
+          result.Error("Node out of range");
+          break;
+        }
+        // Category graph does not have limitation on which nodes it can be
+        // called.
+      }
+      w->cat.verbose = verbose;
+      graph_command(job+1, node, &w->cat, &result);
     }
     break;
+#ifdef DEBUG
+    // command
+    case '.': {  // Job that does not produce any result
+      *no_result = true;
+      // Used to test a crashing client
+    }
+    break;
+#endif
     default:
-      result = "{\"error\":\"Unknown command\"}";
+      result.Error("Unknown command");
   }
+  return result.str();
+}
+
+// Results which depend only on the graphs can be cached, names ('N') and
+// category trees ('A') come from other files.
+bool cacheable_job(const char *job) {
+  return (job[0] == 'a' || job[0] == 'c') && job[1] != 'N' && job[1] != 'A';
+}
+
+// Like compute_job, but results of jobs which were done before are taken
+// from the cache of worker.
+string run_job(char *job, WorkerData *w, bool verbose, bool *no_result) {
+  bool cacheable = w->cache && cacheable_job(job);
+  string result;
+  if (cacheable && w->cache->Get(job, &result)) {
+    *no_result = false;
+    return result;
+  }
+  result = compute_job(job, w, verbose, no_result);
+  if (cacheable && !*no_result)
+    w->cache->Put(job, result);
   return result;
 }
 
+// Adds results saved by all workers which ran on the same graphs, files are
+// results<N>.cache, one for each worker.
+void load_cache(WorkerData *w) {
+  DIR *dir = opendir(".");
+  if (!dir) {
+    perror("opendir");
+    return;
+  }
+  while (struct dirent *entry = readdir(dir)) {
+    int index, length = 0;
+    if (sscanf(entry->d_name, "results%d.cache%n", &index, &length) != 1
+        || !length || entry->d_name[length])
+      continue;
+    SystemFile f;
+    if (!f.open(entry->d_name, "rb"))
+      continue;
+    w->cache->Read(&f, w->cache_stamp);
+    f.close();
+  }
+  closedir(dir);
+}
+
+// Number N of results<N>.cache which this worker saves, the smallest one
+// which is not used by another running worker. Workers hold a lock of
+// results<N>.lock until they exit. Returns -1 if there is no lock file.
+int lock_cache_file() {
+  for (int i = 0; ; i++) {
+    char fname[30];
+    snprintf(fname, sizeof(fname), "results%d.lock", i);
+    int fd = open(fname, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      perror("open");
+      return -1;
+    }
+    if (!flock(fd, LOCK_EX | LOCK_NB))
+      return i;  // file stays open
+    close(fd);
+  }
+}
+
+// Saves the cache if there are new results and at least interval seconds
+// have passed since the last save.
+void save_cache(WorkerData *w, int interval) {
+  if (!w->cache || w->cache_file.empty() || !w->cache->changed()
+      || time(NULL) - w->cache_saved < interval)
+    return;
+  string tmpname = TempFileName(w->cache_file);
+  SystemFile f;
+  if (!f.open(tmpname.c_str(), "wb")) {
+    perror("fopen");
+    return;
+  }
+  w->cache->Write(&f, w->cache_stamp);
+  f.close();
+  if (rename(tmpname.c_str(), w->cache_file.c_str()))
+    perror("rename");
+  w->cache_saved = time(NULL);
+}
+
+// Jobs are read from stdin (one per line), and results are written to
+// stdout as "job<TAB>result". Binary results are written as
+// "job<TAB>size<NEWLINE>" followed by size bytes, JSON results always
+// start with '{'. Redis is not used at all.
+void local_loop(WorkerData *w) {
+  char line[101];
+  while (fgets(line, sizeof(line), stdin)) {
+    char *job = line;
+    job[strcspn(job, "\r\n")] = 0;
+    if (!job[0])
+      continue;
+
+    bool no_result;
+    string result = run_job(job, w, false, &no_result);
+    save_cache(w, RESULT_CACHE_SAVE);
+    if (no_result)
+      continue;
+    if (w->binary) {
+      printf("%s\t%u\n", job, static_cast<unsigned>(result.size()));
+      fwrite(result.data(), 1, result.size(), stdout);
+    } else {
+      printf("%s\t%s\n", job, result.c_str());
+    }
+    fflush(stdout);
+  }
+  save_cache(w, 0);
+}
+
+// Workers claim a job before they compute it, so that copies of the job
+// which the controller reschedules while it runs are skipped by all
+// workers. Jobs are claimed by
+//
+//   SET inflight:<job> 1 NX EX JOB_CLAIM_SECONDS
+//   GET result:<job>
+//
+// and the claim is deleted after the result is set. A job is computed if
+// it is claimed and has no result. If it has a result, the result is
+// announced again: the controller may have asked for the job just after
+// the result was set.
+bool job_claimed(redisReply *reply) {
+  if (reply->type == REDIS_REPLY_ERROR) {
+    // Redis older than 2.6.12
+    fprintf(stderr, "Can not claim jobs: %s\n", reply->str);
+    exit(1);
+  }
+  return reply->type != REDIS_REPLY_NIL;
+}
+
+// Take jobs from redis queue and store the results back into redis
+void redis_loop(redisContext *c, WorkerData *w, bool is_parent) {
+  while (1) {
+    // Wait for a job on the queue
+    redisReply *reply = redisCmd(c, "BRPOPLPUSH queue:jobs queue:running 0");
+
+    char job[101];
+    strncpy(job, reply->str, 100);
+    job[100] = 0;
+    freeReplyObject(reply);
+
+    if (is_parent) {
+      printf("Request: %s\n", job);
+    }
+
+    redisAppendCommand(c, "SET inflight:%s 1 NX EX %d", job,
+        JOB_CLAIM_SECONDS);
+    redisAppendCommand(c, "GET result:%s", job);
+    void *replies[2];
+    if (redisGetReply(c, &replies[0]) != REDIS_OK
+        || redisGetReply(c, &replies[1]) != REDIS_OK) {
+      fprintf(stderr, "Connection lost: %s\n", c->errstr);
+      exit(1);
+    }
+    redisReply *claim = reinterpret_cast<redisReply *>(replies[0]);
+    redisReply *done = reinterpret_cast<redisReply *>(replies[1]);
+    bool claimed = job_claimed(claim);
+    freeReplyObject(claim);
+    if (!claimed) {
+      freeReplyObject(done);
+      if (is_parent)
+        printf("Skipped, it is computed by another worker\n");
+      continue;
+    }
+    if (done->type == REDIS_REPLY_STRING) {
+      reply = redisCmd(c, "PUBLISH announce:%s %b", job, done->str,
+          static_cast<size_t>(done->len));
+      freeReplyObject(reply);
+      freeReplyObject(done);
+      reply = redisCmd(c, "DEL inflight:%s", job);
+      freeReplyObject(reply);
+      if (is_parent)
+        printf("Skipped, result is announced again\n");
+      continue;
+    }
+    freeReplyObject(done);
+
+    time_t t_start = clock();
+    bool no_result;
+    string result = run_job(job, w, is_parent, &no_result);
+    save_cache(w, RESULT_CACHE_SAVE);
+    if (no_result) {
+      reply = redisCmd(c, "DEL inflight:%s", job);
+      freeReplyObject(reply);
+      continue;
+    }
+
+    // Set results
+    reply = redisCmd(c, "SET result:%s %b", job,
+        result.c_str(), result.size());
+    freeReplyObject(reply);
+    // Announcing must come after settings the results.
+
+    // Announce the results to channel
+    reply = redisCmd(c, "PUBLISH announce:%s %b",
+        job, result.c_str(), result.size());
+    freeReplyObject(reply);
+
+    // Later copies of the job find the result
+    reply = redisCmd(c, "DEL inflight:%s", job);
+    freeReplyObject(reply);
+
+    if (is_parent) {
+      time_t t_end = clock();
+      string json;
+      ResultToJson(result, &json);
+      printf("Time to complete %.5lf: %s\n",
+          static_cast<double>(t_end - t_start)/CLOCKS_PER_SEC, json.c_str());
+    }
+  }
+}
+
+// Takes jobs like redis_loop, but does not wait for redis while there is
+// work: next jobs are fetched (on their own connection) while distance jobs
+// are computed, and results are written without waiting for the replies.
+// Fetched distance jobs of the same graph are computed together by all
+// threads, one for each of them. Fetched jobs are claimed as in redis_loop
+// before they are computed, without waiting for the replies.
+//
+// Prefetched jobs are already in queue:running, the controller starts to
+// wait for them when they are fetched and reschedules them if the worker is
+// lost. Only short jobs can wait here, so jobs are prefetched only while
+// distance jobs are computed, with RPOPLPUSH which does not block. A worker
+// waits for a new job (BRPOPLPUSH) only when it has nothing else, and
+// before any other job fetched jobs are given back to the queue.
+class AsyncWorker {
+ public:
+  AsyncWorker(WorkerData *w, bool verbose, int prefetch)
+  : w_(w), verbose_(verbose), prefetch_(prefetch), requested_(0),
+    unacked_(0), jobs_(NULL), results_(NULL) { }
+
+  void Run(redisAsyncContext *jobs, redisAsyncContext *results) {
+    jobs_ = jobs;
+    results_ = results;
+    loop_.Attach(jobs);
+    loop_.Attach(results);
+    redisAsyncSetDisconnectCallback(jobs, OnDisconnect);
+    redisAsyncSetDisconnectCallback(results, OnDisconnect);
+    while (1) {
+      // Results are not piled up if redis is slower than the worker
+      while (ready_.empty() || unacked_ >= kMaxUnacked) {
+        if (ready_.empty() && !requested_)
+          Request("BRPOPLPUSH queue:jobs queue:running 0");
+        loop_.Poll(-1);
+      }
+      vector<string> batch;
+      vector<node_t> sources;
+      GraphContext *ctx = TakeJobs(&batch, &sources);
+      if (ctx) {
+        // Fetch the next jobs and send the results while computing these
+        while (requested_ < prefetch_)
+          Request("RPOPLPUSH queue:jobs queue:running");
+      } else {
+        GiveBack();
+      }
+      loop_.Poll(0);
+
+      if (verbose_) {
+        printf("Request: %s", batch[0].c_str());
+        if (batch.size() > 1)
+          printf(" and %u more", static_cast<unsigned>(batch.size() - 1));
+        printf("\n");
+      }
+
+      time_t t_start = clock();
+      vector<string> results(batch.size());
+      if (ctx) {
+        // Only distances which are not cached are computed
+        vector<node_t> missing;
+        vector<size_t> index;
+        for (size_t i = 0; i < batch.size(); i++) {
+          if (!w_->cache || !w_->cache->Get(batch[i], &results[i])) {
+            missing.push_back(sources[i]);
+            index.push_back(i);
+          }
+        }
+        vector<vector<uint32_t> > counts;
+        if (!missing.empty())
+          ctx->graph->GetDistances(missing, &counts);
+        for (size_t i = 0; i < counts.size(); i++) {
+          ResultBuilder result(w_->binary);
+          result.Add("count_dist", counts[i]);
+          results[index[i]] = result.str();
+          if (w_->cache)
+            w_->cache->Put(batch[index[i]], results[index[i]]);
+        }
+      } else {
+        bool no_result;
+        vector<char> name(batch[0].begin(), batch[0].end());
+        name.push_back(0);
+        results[0] = run_job(&name[0], w_, verbose_, &no_result);
+        if (no_result) {
+          Release(batch[0]);
+          continue;
+        }
+      }
+
+      // Announcing comes after setting the results on the same connection
+      for (size_t i = 0; i < batch.size(); i++) {
+        redisAsyncCommand(results_, OnWritten, this, "SET result:%s %b",
+            batch[i].c_str(), results[i].data(), results[i].size());
+        redisAsyncCommand(results_, OnWritten, this, "PUBLISH announce:%s %b",
+            batch[i].c_str(), results[i].data(), results[i].size());
+        unacked_ += 2;
+        Release(batch[i]);
+      }
+      loop_.Poll(0);
+      save_cache(w_, RESULT_CACHE_SAVE);
+
+      if (verbose_) {
+        time_t t_end = clock();
+        string json;
+        ResultToJson(results.back(), &json);
+        printf("Time to complete %.5lf: %s\n",
+            static_cast<double>(t_end - t_start)/CLOCKS_PER_SEC, json.c_str());
+      }
+    }
+  }
+
+ private:
+  static const int kMaxUnacked = 64;  // commands with results
+
+  // Fetched job whose claim is not answered yet
+  struct Claim {
+    AsyncWorker *worker;
+    string job;
+    bool claimed;
+  };
+
+  void Request(const char *command) {
+    redisAsyncCommand(jobs_, OnJob, this, command);
+    requested_++;
+  }
+
+  // Jobs which are fetched would wait for a job which may take longer than
+  // the controller waits for them, they are pushed back to the end of the
+  // queue from which the next job is taken. The controller will still
+  // reschedule them if they are not done in time, the copies are skipped.
+  void GiveBack() {
+    // Jobs are fetched and claimed without blocking, replies come soon
+    while (requested_ > static_cast<int>(ready_.size()))
+      loop_.Poll(-1);
+    while (!ready_.empty()) {
+      Release(ready_.back());
+      redisAsyncCommand(results_, OnWritten, this, "RPUSH queue:jobs %s",
+          ready_.back().c_str());
+      unacked_++;
+      ready_.pop_back();
+      requested_--;
+    }
+  }
+
+  // Deletes the claim of job, after its result is set
+  void Release(const string &job) {
+    redisAsyncCommand(results_, OnWritten, this, "DEL inflight:%s",
+        job.c_str());
+    unacked_++;
+  }
+
+  // Takes the first fetched job, and if it is a distance job other fetched
+  // distance jobs of its graph, one for each thread. Results are written
+  // after every such batch, a larger one would keep all of them late.
+  // Returns the graph of distance jobs.
+  GraphContext *TakeJobs(vector<string> *batch, vector<node_t> *sources) {
+    batch->push_back(ready_.front());
+    ready_.pop_front();
+    requested_--;
+    node_t node;
+    GraphContext *ctx = distance_job(batch->back().c_str(), w_, &node);
+    if (ctx)
+      sources->push_back(node);
+    std::deque<string>::iterator it = ready_.begin();
+    while (it != ready_.end()) {
+      if (ctx && sources->size() < static_cast<size_t>(NumThreads())
+          && distance_job(it->c_str(), w_, &node) == ctx) {
+        batch->push_back(*it);
+        sources->push_back(node);
+        it = ready_.erase(it);
+        requested_--;
+      } else {
+        ++it;
+      }
+    }
+    return ctx;
+  }
+
+  static void OnJob(redisAsyncContext *ac, void *r, void *data) {
+    AsyncWorker *self = reinterpret_cast<AsyncWorker *>(data);
+    redisReply *reply = reinterpret_cast<redisReply *>(r);
+    if (!reply)  // connection is lost
+      return;
+    if (reply->type == REDIS_REPLY_NIL) {  // queue is empty
+      self->requested_--;
+      return;
+    }
+    assert(reply->type == REDIS_REPLY_STRING);
+    // The job is ready once it is claimed, on the connection which does not
+    // block
+    Claim *claim = new Claim;
+    claim->worker = self;
+    claim->job = string(reply->str, std::min(reply->len, 100));
+    claim->claimed = false;
+    redisAsyncCommand(self->results_, OnClaim, claim,
+        "SET inflight:%s 1 NX EX %d", claim->job.c_str(), JOB_CLAIM_SECONDS);
+    redisAsyncCommand(self->results_, OnClaimed, claim, "GET result:%s",
+        claim->job.c_str());
+  }
+
+  static void OnClaim(redisAsyncContext *ac, void *r, void *data) {
+    Claim *claim = reinterpret_cast<Claim *>(data);
+    redisReply *reply = reinterpret_cast<redisReply *>(r);
+    if (reply)
+      claim->claimed = job_claimed(reply);
+  }
+
+  // Result of a fetched job, it is computed if it is claimed and has none
+  static void OnClaimed(redisAsyncContext *ac, void *r, void *data) {
+    Claim *claim = reinterpret_cast<Claim *>(data);
+    redisReply *reply = reinterpret_cast<redisReply *>(r);
+    AsyncWorker *self = claim->worker;
+    if (!reply) {  // connection is lost
+      delete claim;
+      return;
+    }
+    if (!claim->claimed) {
+      self->requested_--;  // computed by another worker
+    } else if (reply->type == REDIS_REPLY_STRING) {
+      // Done already, the controller may be waiting for the announcement
+      redisAsyncCommand(self->results_, OnWritten, self,
+          "PUBLISH announce:%s %b", claim->job.c_str(), reply->str,
+          static_cast<size_t>(reply->len));
+      self->unacked_++;
+      self->Release(claim->job);
+      self->requested_--;
+    } else {
+      self->ready_.push_back(claim->job);
+    }
+    delete claim;
+  }
+
+  static void OnWritten(redisAsyncContext *ac, void *r, void *data) {
+    AsyncWorker *self = reinterpret_cast<AsyncWorker *>(data);
+    redisReply *reply = reinterpret_cast<redisReply *>(r);
+    self->unacked_--;
+    if (reply && reply->type == REDIS_REPLY_ERROR)
+      fprintf(stderr, "Redis error: %s\n", reply->str);
+  }
+
+  static void OnDisconnect(const redisAsyncContext *ac, int status) {
+    fprintf(stderr, "Connection lost: %s\n", ac->errstr ? ac->errstr : "");
+    exit(1);
+  }
+
+  WorkerData *w_;
+  bool verbose_;
+  int prefetch_;
+  int requested_;  // jobs which are fetched or waiting, not started yet
+  int unacked_;
+  std::deque<string> ready_;  // fetched jobs
+  redisAsyncContext *jobs_;
+  redisAsyncContext *results_;
+  RedisEventLoop loop_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(AsyncWorker);
+};
+
 int main(int argc, char *argv[]) {
   int fork_off = 0;
+  bool local = false;
 
   char redis_host[51] = REDIS_HOST;
   int redis_port = REDIS_PORT;
+  char names_file[256] = "names.bin";
+  int threads = 0;
+  uint32_t samples = CENTRALITY_SAMPLES;
+  char previous[256] = "";
+  bool binary = false;
+  int prefetch = 0;
 
   while (1) {
-    int option = getopt(argc, argv, "f:r:p:h");
+    int option = getopt(argc, argv, "f:r:p:n:t:s:w:q:lbh");
     if (option == -1)
       break;
     switch (option) {
@@ -89,6 +976,27 @@ int main(int argc, char *argv[]) {
       case 'p':
         redis_port = atoi(optarg);
       break;
+      case 'n':
+        strncpy(names_file, optarg, 255);
+      break;
+      case 't':
+        threads = atoi(optarg);
+      break;
+      case 's':
+        samples = atoi(optarg);
+      break;
+      case 'w':
+        strncpy(previous, optarg, 255);
+      break;
+      case 'l':
+        local = true;
+      break;
+      case 'b':
+        binary = true;
+      break;
+      case 'q':
+        prefetch = atoi(optarg);
+      break;
       case 'h':
         print_help(argv[0]);
         return 0;
@@ -98,10 +1006,14 @@ int main(int argc, char *argv[]) {
         return 1;
     }
   }
-  if (argc != optind) {
+  if (argc != optind || (local && fork_off)) {
     print_help(argv[0]);
     return 1;
   }
+  // Workers share the cores
+  if (!threads && fork_off)
+    threads = std::max(1, NumThreads() / fork_off);
+  SetNumThreads(threads);
 
   // Forking children into background
   bool is_parent = true;
@@ -117,8 +1029,10 @@ int main(int argc, char *argv[]) {
       return 0;
     }
   }
+  // Keep stdout clean for results in local mode
+  bool verbose = is_parent && !local;
 
-  if (is_parent) {
+  if (verbose) {
     printf("Loading...");
     fflush(stdout);
   }
@@ -130,6 +1044,8 @@ int main(int argc, char *argv[]) {
   }
   CompleteGraphAlgo cat_graph(&f_cat);
   cat_graph.Init(true);
+  // Stage6 writes every category link in both directions
+  cat_graph.set_symmetric(true);
   f_cat.close();
 
   // Check sanity of graph
@@ -160,10 +1076,83 @@ int main(int argc, char *argv[]) {
   // Check sanity of graph
   art_graph.SanityCheck();
 
-  if (is_parent) {
+  // Directed category links are optional, they are only needed for 'A' jobs
+  CompleteGraphAlgo *categories = NULL;
+  SystemFile f_catfw;
+  if (f_catfw.open("catlinks_fw.graph", "rb")) {
+    categories = new CompleteGraphAlgo(&f_catfw);
+    categories->Init(true);
+    f_catfw.close();
+  }
+
+  // Names are optional, they are only needed for 'N' jobs
+  NameStore *names = NULL;
+  SystemFile f_names;
+  if (f_names.open(names_file, "rb")) {
+    names = new NameStore(&f_names);
+    names->Init(true);
+    f_names.close();
+  }
+
+  if (verbose) {
     printf("done.\n");
   }
 
+  WorkerData w;
+  w.art.graph = &art_graph;
+  w.art.name = "artlinks";
+  w.art.names = names;
+  w.art.num_nodes = art_graph.num_nodes();
+  w.art.samples = samples;
+  w.art.previous = previous[0] ? previous : NULL;
+  w.art.categories = categories;
+  w.art.category_root = names ? names->Find(CATEGORY_ROOT) : 0;
+  w.cat.graph = &cat_graph;
+  w.cat.name = "catlinks";
+  w.cat.names = names;
+  w.cat.num_nodes = cat_graph.num_nodes();
+  w.cat.samples = samples;
+  w.cat.previous = previous[0] ? previous : NULL;
+  w.cat.categories = categories;
+  w.cat.category_root = w.art.category_root;
+  w.is_category = &is_category;
+  w.num_nodes = art_graph.num_nodes();
+  w.binary = binary;
+  w.cache = NULL;
+
+  if (w.num_nodes != cat_graph.num_nodes()
+      || (names && w.num_nodes != names->num_nodes())
+      || (categories && w.num_nodes != categories->num_nodes())) {
+    fprintf(stderr, "Number of nodes mismatch.\n");
+    exit(1);
+  }
+
+  if (RESULT_CACHE_MB > 0) {
+    // Results of another build, options or graphs are not loaded
+    char stamp[100];
+    snprintf(stamp, sizeof(stamp), "%s %s art:%08x cat:%08x s:%u b:%d w:",
+        __DATE__, __TIME__, art_graph.Checksum(), cat_graph.Checksum(),
+        samples, binary);
+    int index = lock_cache_file();
+    if (index >= 0) {
+      char fname[30];
+      snprintf(fname, sizeof(fname), "results%d.cache", index);
+      w.cache_file = fname;
+    }
+    w.cache = new ResultCache(size_t(RESULT_CACHE_MB) << 20);
+    w.cache_stamp = string(stamp) + previous;
+    w.cache_saved = time(NULL);
+    load_cache(&w);
+  }
+
+  if (local) {
+    local_loop(&w);
+    delete w.cache;
+    delete names;
+    delete categories;
+    return 0;
+  }
+
   // Connect to redis server over network (not unix-socket)
   redisContext *c;
   struct timeval timeout = { 1, 500000 };  // 1.5 seconds
@@ -179,8 +1168,7 @@ int main(int argc, char *argv[]) {
   uint32_t num_nodes = atoi(reply->str);
   freeReplyObject(reply);
 
-  if (num_nodes != art_graph.num_nodes()
-      || num_nodes != cat_graph.num_nodes()) {
+  if (num_nodes != w.num_nodes) {
     fprintf(stderr, "Number of nodes mismatch.\n");
     exit(1);
   }
@@ -189,86 +1177,19 @@ int main(int argc, char *argv[]) {
     printf("Number of nodes %d\n", num_nodes);
   }
 
-  while (1) {
-    // Wait for a job on the queue
-    redisReply *reply = redisCmd(c, "BRPOPLPUSH queue:jobs queue:running 0");
-
-    char job[101];
-    strncpy(job, reply->str, 100);
-    job[100] = 0;
-    freeReplyObject(reply);
-
-    if (is_parent) {
-      printf("Request: %s\n", job);
-    }
-
-    time_t t_start = clock();
-    string result;
-    bool no_result = false;
-
-    switch (job[0]) {
-      // command
-      case 'a': {  // for articles graph
-        node_t node = 0;
-        if (isdigit(job[2])) {
-          node = atoi(job+2);
-          if (node < 1 || node > num_nodes) {
-            result = "{\"error\":\"Node out of range\"}";
-            break;
-          }
-          if (is_category.get_value(node)) {
-            result = "{\"error\":\"Node is category\"}";
-            break;
-          }
-        }
-        result = graph_command(job+1, node, &art_graph, num_nodes, is_parent);
-      }
-      break;
-      // command
-      case 'c': {  // for categories graph
-        node_t node = 0;
-        if (isdigit(job[2])) {
-          node = atoi(job+2);
-          if (node < 1 || node > num_nodes) {
-            result = "{\"error\":\"Node out of range\"}";
-            break;
-          }
-          // Category graph does not have limitation on which nodes it can be
-          // called.
-        }
-        result = graph_command(job+1, node, &cat_graph, num_nodes, is_parent);
-      }
-      break;
-#ifdef DEBUG
-      // command
-      case '.': {  // Job that does not produce any result
-        no_result = true;
-        // Used to test a crashing client
-      }
-      break;
-#endif
-      default:
-        result = "{\"error\":\"Unknown command\"}";
-    }
-    if (no_result)
-      continue;
-
-    // Set results
-    reply = redisCmd(c, "SET result:%s %b", job,
-        result.c_str(), result.size());
-    freeReplyObject(reply);
-    // Announcing must come after settings the results.
-
-    // Announce the results to channel
-    reply = redisCmd(c, "PUBLISH announce:%s %b",
-        job, result.c_str(), result.size());
-    freeReplyObject(reply);
-
-    if (is_parent) {
-      time_t t_end = clock();
-      printf("Time to complete %.5lf: %s\n",
-          static_cast<double>(t_end - t_start)/CLOCKS_PER_SEC, result.c_str());
+  if (prefetch > 0) {
+    redisAsyncContext *jobs = redisAsyncConnect(redis_host, redis_port);
+    redisAsyncContext *results = redisAsyncConnect(redis_host, redis_port);
+    if (jobs->err || results->err) {
+      printf("Connection error: %s\n",
+          jobs->err ? jobs->errstr : results->errstr);
+      exit(1);
     }
+    redisFree(c);
+    AsyncWorker worker(&w, is_parent, prefetch);
+    worker.Run(jobs, results);
+  } else {
+    redis_loop(c, &w, is_parent);
   }
 
   return 0;
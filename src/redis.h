@@ -11,6 +11,7 @@
 #include <algorithm>
 
 #include "hiredis/hiredis.h"
+#include "result_builder.h"
 
 namespace wikigraph {
 
@@ -47,40 +48,26 @@ vector<pii> count_items(vector<uint32_t> v) {
 }
 
 string to_json(const vector<uint32_t> &v) {
-  string msg = "[";
-  for (size_t i = 0; i < v.size(); i++) {
-    if (i) msg += ",";
-    char msgpart[20];
-    snprintf(msgpart, sizeof(msgpart), "%"PRIu32, v[i]);
-    msg += string(msgpart);
-  }
-  msg += "]";
+  string msg;
+  append_json(&msg, v);
   return msg;
 }
 
 string to_json(const vector<pii> &v) {
-  string msg = "[";
-  for (size_t i = 0; i < v.size(); i++) {
-    if (i) msg += ",";
-    char msgpart[41];
-    snprintf(msgpart, sizeof(msgpart), "[%"PRIu32",%"PRIu32"]",
-        v[i].first, v[i].second);
-    msg += string(msgpart);
-  }
-  msg += "]";
+  string msg;
+  append_json(&msg, v);
   return msg;
 }
 
 string to_json(const vector<pair<double, node_t> > &v) {
-  string msg = "[";
-  for (size_t i = 0; i < v.size(); i++) {
-    if (i) msg += ",";
-    char msgpart[41];
-    snprintf(msgpart, sizeof(msgpart), "[%lf,%"PRIu32"]",
-        v[i].first, v[i].second);
-    msg += string(msgpart);
-  }
-  msg += "]";
+  string msg;
+  append_json(&msg, v);
+  return msg;
+}
+
+string to_json(const string &str) {
+  string msg;
+  append_json(&msg, str);
   return msg;
 }
 
@@ -0,0 +1,114 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_REDIS_ASYNC_H_
+#define SRC_REDIS_ASYNC_H_
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "wikigraph_stubs_internal.h"
+#include "hiredis/async.h"
+
+namespace wikigraph {
+
+// Event loop for asynchronous hiredis connections, built on poll() since
+// the adapters which come with hiredis need ae, libev or libevent.
+class RedisEventLoop {
+ public:
+  RedisEventLoop() { }
+
+  ~RedisEventLoop() {
+    for (size_t i = 0; i < events_.size(); i++)
+      delete events_[i];
+  }
+
+  // Events of connection are handled by this loop until it is freed
+  void Attach(redisAsyncContext *ac) {
+    Events *e = new Events;
+    e->context = ac;
+    e->reading = e->writing = false;
+    events_.push_back(e);
+    ac->ev.addRead = AddRead;
+    ac->ev.delRead = DelRead;
+    ac->ev.addWrite = AddWrite;
+    ac->ev.delWrite = DelWrite;
+    ac->ev.cleanup = Cleanup;
+    ac->ev.data = e;
+  }
+
+  // Writes and reads what it can on all connections, replies are given to
+  // their callbacks. Waits up to timeout milliseconds (-1 is forever) for a
+  // connection to be ready, 0 does not wait at all.
+  void Poll(int timeout) {
+    vector<pollfd> fds;
+    vector<Events *> ready;
+    for (size_t i = 0; i < events_.size(); i++) {
+      Events *e = events_[i];
+      if (!e->context || (!e->reading && !e->writing))
+        continue;
+      pollfd fd;
+      fd.fd = e->context->c.fd;
+      fd.events = (e->reading ? POLLIN : 0) | (e->writing ? POLLOUT : 0);
+      fd.revents = 0;
+      fds.push_back(fd);
+      ready.push_back(e);
+    }
+    if (fds.empty())
+      return;
+    if (poll(&fds[0], fds.size(), timeout) < 0) {
+      if (errno == EINTR)
+        return;
+      perror("poll");
+      exit(1);
+    }
+    for (size_t i = 0; i < fds.size(); i++) {
+      // Callbacks can free a connection
+      Events *e = ready[i];
+      if (e->context && e->writing && (fds[i].revents & POLLOUT))
+        redisAsyncHandleWrite(e->context);
+      if (e->context && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+        redisAsyncHandleRead(e->context);
+    }
+  }
+
+ private:
+  struct Events {
+    redisAsyncContext *context;  // NULL once it is freed
+    bool reading;
+    bool writing;
+  };
+
+  static void AddRead(void *data) {
+    reinterpret_cast<Events *>(data)->reading = true;
+  }
+
+  static void DelRead(void *data) {
+    reinterpret_cast<Events *>(data)->reading = false;
+  }
+
+  static void AddWrite(void *data) {
+    reinterpret_cast<Events *>(data)->writing = true;
+  }
+
+  static void DelWrite(void *data) {
+    reinterpret_cast<Events *>(data)->writing = false;
+  }
+
+  static void Cleanup(void *data) {
+    Events *e = reinterpret_cast<Events *>(data);
+    e->context = NULL;
+    e->reading = e->writing = false;
+  }
+
+  vector<Events *> events_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RedisEventLoop);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_REDIS_ASYNC_H_
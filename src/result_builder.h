@@ -0,0 +1,674 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_RESULT_BUILDER_H_
+#define SRC_RESULT_BUILDER_H_
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utility>
+
+#include "wikigraph_stubs_internal.h"
+
+namespace wikigraph {
+
+// Results of jobs are objects with a few named fields. They are written as
+// JSON (read by analyze.js), or in a binary encoding which is several times
+// smaller and cheaper to write and to read:
+//
+//   [kBinaryResult][field]...
+//   field: [type][length of key][key][value]
+//
+// Unsigned numbers are varints (7 bits per byte, low bits first), signed
+// ones are zigzag varints, doubles are 8 bytes (little endian). Lists are
+// [count][values], histograms (pairs sorted by value, as made by
+// util::count_items) store the difference from the previous value, and
+// scores of nodes are fixed-width [double][uint32] pairs. JSON results
+// always start with '{', so both kinds can be told apart.
+const char kBinaryResult = 1;
+
+enum ResultType {
+  kResultUnsigned = 1,
+  kResultSigned = 2,
+  kResultDouble = 3,
+  kResultString = 4,
+  kResultList = 5,
+  kResultHistogram = 6,
+  kResultScores = 7
+};
+
+// Fields with histograms. Pairs look the same in JSON as scores of nodes,
+// so JsonResultParser tells them apart by these names, and ResultBuilder
+// writes histograms only under them. Add new histogram fields here.
+const char *const kHistogramFields[] = { "components", "cores", "communities" };
+
+inline bool IsHistogramField(const char *key) {
+  size_t count = sizeof(kHistogramFields) / sizeof(kHistogramFields[0]);
+  for (size_t i = 0; i < count; i++) {
+    if (!strcmp(key, kHistogramFields[i]))
+      return true;
+  }
+  return false;
+}
+
+namespace util {
+
+inline void append_varint(string *out, uint64_t value) {
+  while (value >= 0x80) {
+    *out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  *out += static_cast<char>(value);
+}
+
+inline void append_fixed(string *out, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++, value >>= 8)
+    *out += static_cast<char>(value & 0xff);
+}
+
+// Decimal digits without snprintf, which is slow for many small numbers
+inline void append_decimal(string *out, uint64_t value) {
+  char digits[20];
+  int n = 0;
+  do {
+    digits[n++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  while (n)
+    *out += digits[--n];
+}
+
+inline void append_json(string *out, double value) {
+  char msg[30];
+  snprintf(msg, sizeof(msg), "%.9g", value);
+  *out += msg;
+}
+
+// Quoted JSON string, page titles are UTF-8 and only need few escapes
+inline void append_json(string *out, const string &str) {
+  *out += '"';
+  for (size_t i = 0; i < str.size(); i++) {
+    unsigned char c = str[i];
+    if (c == '"' || c == '\\') {
+      *out += '\\';
+      *out += c;
+    } else if (c < 0x20) {
+      char msg[7];
+      snprintf(msg, sizeof(msg), "\\u%04x", c);
+      *out += msg;
+    } else {
+      *out += c;
+    }
+  }
+  *out += '"';
+}
+
+inline void append_json(string *out, const vector<uint32_t> &v) {
+  *out += '[';
+  for (size_t i = 0; i < v.size(); i++) {
+    if (i) *out += ',';
+    append_decimal(out, v[i]);
+  }
+  *out += ']';
+}
+
+inline void append_json(string *out, const vector<pii> &v) {
+  *out += '[';
+  for (size_t i = 0; i < v.size(); i++) {
+    *out += i ? ",[" : "[";
+    append_decimal(out, v[i].first);
+    *out += ',';
+    append_decimal(out, v[i].second);
+    *out += ']';
+  }
+  *out += ']';
+}
+
+inline void append_json(string *out, const vector<pair<double, node_t> > &v) {
+  *out += '[';
+  for (size_t i = 0; i < v.size(); i++) {
+    *out += i ? ",[" : "[";
+    // Centrality values are small, keep significant digits
+    append_json(out, v[i].first);
+    *out += ',';
+    append_decimal(out, v[i].second);
+    *out += ']';
+  }
+  *out += ']';
+}
+
+}  // namespace util
+
+// Appends fields of one result, as JSON or binary
+//
+//   ResultBuilder result(binary);
+//   result.Add("scc", label);
+//   result.Add("size", size);
+//   return result.str();
+class ResultBuilder {
+ public:
+  explicit ResultBuilder(bool binary)
+  : binary_(binary), done_(false) {
+    out_ += binary_ ? kBinaryResult : '{';
+  }
+
+  void Add(const char *key, uint32_t value) {
+    Add(key, static_cast<uint64_t>(value));
+  }
+
+  void Add(const char *key, uint64_t value) {
+    if (Key(key, kResultUnsigned))
+      util::append_varint(&out_, value);
+    else
+      util::append_decimal(&out_, value);
+  }
+
+  void Add(const char *key, int32_t value) {
+    if (Key(key, kResultSigned)) {
+      util::append_varint(&out_,
+          (static_cast<uint32_t>(value) << 1) ^ (value < 0 ? ~0u : 0u));
+    } else {
+      if (value < 0)
+        out_ += '-';
+      util::append_decimal(&out_, value < 0 ? -int64_t(value) : value);
+    }
+  }
+
+  void Add(const char *key, double value) {
+    if (Key(key, kResultDouble)) {
+      uint64_t bits;
+      memcpy(&bits, &value, sizeof(bits));
+      util::append_fixed(&out_, bits, 8);
+    } else {
+      util::append_json(&out_, value);
+    }
+  }
+
+  void Add(const char *key, const string &value) {
+    if (Key(key, kResultString)) {
+      util::append_varint(&out_, value.size());
+      out_ += value;
+    } else {
+      util::append_json(&out_, value);
+    }
+  }
+
+  void Add(const char *key, const char *value) {
+    Add(key, string(value));
+  }
+
+  void Add(const char *key, const vector<uint32_t> &values) {
+    if (!Key(key, kResultList)) {
+      util::append_json(&out_, values);
+      return;
+    }
+    util::append_varint(&out_, values.size());
+    for (size_t i = 0; i < values.size(); i++)
+      util::append_varint(&out_, values[i]);
+  }
+
+  // Pairs of (value, count) sorted by value, key is in kHistogramFields
+  void Add(const char *key, const vector<pii> &histogram) {
+    assert(IsHistogramField(key));
+    if (!Key(key, kResultHistogram)) {
+      util::append_json(&out_, histogram);
+      return;
+    }
+    util::append_varint(&out_, histogram.size());
+    uint32_t previous = 0;
+    for (size_t i = 0; i < histogram.size(); i++) {
+      assert(histogram[i].first >= previous);
+      util::append_varint(&out_, histogram[i].first - previous);
+      util::append_varint(&out_, histogram[i].second);
+      previous = histogram[i].first;
+    }
+  }
+
+  void Add(const char *key, const vector<pair<double, node_t> > &scores) {
+    if (!Key(key, kResultScores)) {
+      util::append_json(&out_, scores);
+      return;
+    }
+    util::append_varint(&out_, scores.size());
+    out_.reserve(out_.size() + 12 * scores.size());
+    for (size_t i = 0; i < scores.size(); i++) {
+      uint64_t bits;
+      memcpy(&bits, &scores[i].first, sizeof(bits));
+      util::append_fixed(&out_, bits, 8);
+      util::append_fixed(&out_, scores[i].second, 4);
+    }
+  }
+
+  // Result with only an error message
+  void Error(const char *message) {
+    out_.resize(1);
+    Add("error", message);
+  }
+
+  const string &str() {
+    if (!binary_ && !done_)
+      out_ += '}';
+    done_ = true;
+    return out_;
+  }
+
+ private:
+  // Starts a field, returns true if the value is written in binary
+  bool Key(const char *key, ResultType type) {
+    assert(!done_);
+    size_t length = strlen(key);
+    if (binary_) {
+      out_ += static_cast<char>(type);
+      out_ += static_cast<char>(length);
+      out_.append(key, length);
+      return true;
+    }
+    if (out_.size() > 1)
+      out_ += ',';
+    out_ += '"';
+    out_.append(key, length);
+    out_ += "\":";
+    return false;
+  }
+
+  bool binary_;
+  bool done_;
+  string out_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ResultBuilder);
+};
+
+// Reads fields of a binary result one by one, Next() returns false at the
+// end or if the result is damaged (then ok() is false).
+//
+//   ResultReader reader(result);
+//   while (reader.Next())
+//     if (reader.key() == "count_dist") ... reader.list() ...
+class ResultReader {
+ public:
+  explicit ResultReader(const string &data)
+  : data_(data), pos_(1), ok_(IsBinary(data)), type_(0), number_(0),
+    real_(0.0) { }
+
+  static bool IsBinary(const string &result) {
+    return !result.empty() && result[0] == kBinaryResult;
+  }
+
+  bool Next() {
+    if (!ok_ || pos_ >= data_.size())
+      return false;
+    ok_ = false;
+    if (pos_ + 2 > data_.size())
+      return false;
+    type_ = static_cast<unsigned char>(data_[pos_++]);
+    size_t length = static_cast<unsigned char>(data_[pos_++]);
+    if (pos_ + length > data_.size())
+      return false;
+    key_.assign(data_, pos_, length);
+    pos_ += length;
+    uint64_t count;
+    switch (type_) {
+      case kResultUnsigned:
+        return ok_ = Varint(&number_);
+      case kResultSigned:
+        if (!Varint(&number_))
+          return false;
+        number_ = (number_ >> 1) ^ -(number_ & 1);
+        return ok_ = true;
+      case kResultDouble:
+        return ok_ = Double(&real_);
+      case kResultString:
+        if (!Varint(&count) || pos_ + count > data_.size())
+          return false;
+        text_.assign(data_, pos_, count);
+        pos_ += count;
+        return ok_ = true;
+      case kResultList:
+        if (!Varint(&count) || count > data_.size() - pos_)
+          return false;
+        list_.resize(count);
+        for (size_t i = 0; i < count; i++) {
+          if (!Varint(&number_))
+            return false;
+          list_[i] = number_;
+        }
+        return ok_ = true;
+      case kResultHistogram: {
+        if (!Varint(&count) || count > data_.size() - pos_)
+          return false;
+        histogram_.resize(count);
+        uint64_t value = 0;
+        for (size_t i = 0; i < count; i++) {
+          if (!Varint(&number_))
+            return false;
+          value += number_;
+          histogram_[i].first = value;
+          if (!Varint(&number_))
+            return false;
+          histogram_[i].second = number_;
+        }
+        return ok_ = true;
+      }
+      case kResultScores:
+        if (!Varint(&count) || count > (data_.size() - pos_) / 12)
+          return false;
+        scores_.resize(count);
+        for (size_t i = 0; i < count; i++) {
+          Double(&scores_[i].first);
+          scores_[i].second = Fixed(4);
+        }
+        return ok_ = true;
+      default:
+        return false;
+    }
+  }
+
+  bool ok() const {
+    return ok_;
+  }
+
+  int type() const {
+    return type_;
+  }
+
+  const string &key() const {
+    return key_;
+  }
+
+  uint64_t number() const {
+    return number_;
+  }
+
+  int64_t signed_number() const {
+    return static_cast<int64_t>(number_);
+  }
+
+  double real() const {
+    return real_;
+  }
+
+  const string &text() const {
+    return text_;
+  }
+
+  const vector<uint32_t> &list() const {
+    return list_;
+  }
+
+  const vector<pii> &histogram() const {
+    return histogram_;
+  }
+
+  const vector<pair<double, node_t> > &scores() const {
+    return scores_;
+  }
+
+ private:
+  bool Varint(uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; pos_ < data_.size() && shift < 64; shift += 7) {
+      unsigned char c = data_[pos_++];
+      *value |= static_cast<uint64_t>(c & 0x7f) << shift;
+      if (!(c & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  uint64_t Fixed(int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+      value |= static_cast<uint64_t>(
+          static_cast<unsigned char>(data_[pos_++])) << (8 * i);
+    return value;
+  }
+
+  bool Double(double *value) {
+    if (pos_ + 8 > data_.size())
+      return false;
+    uint64_t bits = Fixed(8);
+    memcpy(value, &bits, sizeof(bits));
+    return true;
+  }
+
+  const string &data_;
+  size_t pos_;
+  bool ok_;
+  int type_;
+  string key_;
+  uint64_t number_;
+  double real_;
+  string text_;
+  vector<uint32_t> list_;
+  vector<pii> histogram_;
+  vector<pair<double, node_t> > scores_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ResultReader);
+};
+
+// JSON of a result in either encoding, false if a binary result is damaged
+inline bool ResultToJson(const string &result, string *json) {
+  if (!ResultReader::IsBinary(result)) {
+    *json = result;
+    return true;
+  }
+  ResultReader reader(result);
+  ResultBuilder builder(false);
+  while (reader.Next()) {
+    const char *key = reader.key().c_str();
+    switch (reader.type()) {
+      case kResultUnsigned:
+        builder.Add(key, reader.number());
+        break;
+      case kResultSigned:
+        builder.Add(key, static_cast<int32_t>(reader.signed_number()));
+        break;
+      case kResultDouble:
+        builder.Add(key, reader.real());
+        break;
+      case kResultString:
+        builder.Add(key, reader.text());
+        break;
+      case kResultList:
+        builder.Add(key, reader.list());
+        break;
+      case kResultHistogram:
+        builder.Add(key, reader.histogram());
+        break;
+      case kResultScores:
+        builder.Add(key, reader.scores());
+        break;
+    }
+  }
+  if (!reader.ok())
+    return false;
+  *json = builder.str();
+  return true;
+}
+
+// Parses JSON results written by ResultBuilder (or by older workers) into
+// the binary encoding, so that readers handle only one of them. Numbers
+// are unsigned, signed or double as written, lists of pairs are histograms
+// in fields of kHistogramFields, otherwise scores.
+class JsonResultParser {
+ public:
+  explicit JsonResultParser(const string &json)
+  : json_(json), pos_(0), result_(true) { }
+
+  // False if the text is not a result
+  bool Parse(string *binary) {
+    if (!Skip('{'))
+      return false;
+    if (!Skip('}')) {
+      do {
+        string key;
+        if (!String(&key) || !Skip(':') || !Value(key.c_str()))
+          return false;
+      } while (Skip(','));
+      if (!Skip('}'))
+        return false;
+    }
+    *binary = result_.str();
+    return true;
+  }
+
+ private:
+  bool Skip(char c) {
+    if (pos_ < json_.size() && json_[pos_] == c) {
+      pos_++;
+      return true;
+    }
+    return false;
+  }
+
+  bool Value(const char *key) {
+    if (pos_ >= json_.size())
+      return false;
+    if (json_[pos_] == '"') {
+      string text;
+      if (!String(&text))
+        return false;
+      result_.Add(key, text);
+      return true;
+    }
+    if (json_[pos_] == '[')
+      return Array(key);
+    Number number;
+    if (!Read(&number))
+      return false;
+    if (number.integer && !number.negative)
+      result_.Add(key, number.value);
+    else if (number.integer && number.real >= -2147483648.0)
+      result_.Add(key, static_cast<int32_t>(number.real));
+    else
+      result_.Add(key, number.real);
+    return true;
+  }
+
+  bool Array(const char *key) {
+    Skip('[');
+    vector<uint32_t> list;
+    vector<pair<double, node_t> > pairs;
+    bool histogram = IsHistogramField(key);
+    Number first, second;
+    if (!Skip(']')) {
+      do {
+        if (Skip('[')) {
+          if (!Read(&first) || !Skip(',') || !Read(&second) || !Skip(']')
+              || !second.integer || second.negative
+              || (histogram && (!first.integer || first.negative)))
+            return false;
+          pairs.push_back(std::make_pair(first.real, second.value));
+        } else {
+          if (!Read(&first) || !first.integer || first.negative)
+            return false;
+          list.push_back(first.value);
+        }
+      } while (Skip(','));
+      if (!Skip(']') || (!list.empty() && !pairs.empty()))
+        return false;
+    }
+    if (pairs.empty()) {
+      result_.Add(key, list);
+    } else if (histogram) {
+      vector<pii> counts;
+      for (size_t i = 0; i < pairs.size(); i++)
+        counts.push_back(pii(pairs[i].first, pairs[i].second));
+      result_.Add(key, counts);
+    } else {
+      result_.Add(key, pairs);
+    }
+    return true;
+  }
+
+  struct Number {
+    double real;
+    uint64_t value;
+    bool integer;
+    bool negative;
+  };
+
+  bool Read(Number *number) {
+    const char *start = json_.c_str() + pos_;
+    char *end;
+    number->real = strtod(start, &end);
+    if (end == start)
+      return false;
+    number->negative = *start == '-';
+    number->integer = true;
+    for (const char *c = start; c < end; c++) {
+      if (!isdigit(*c) && *c != '-')
+        number->integer = false;
+    }
+    number->value = number->integer && !number->negative
+        ? strtoull(start, NULL, 10) : 0;
+    pos_ += end - start;
+    return true;
+  }
+
+  bool String(string *text) {
+    if (!Skip('"'))
+      return false;
+    while (pos_ < json_.size() && json_[pos_] != '"') {
+      char c = json_[pos_++];
+      if (c != '\\') {
+        *text += c;
+        continue;
+      }
+      if (pos_ >= json_.size())
+        return false;
+      c = json_[pos_++];
+      if (c == 'u') {
+        if (pos_ + 4 > json_.size())
+          return false;
+        unsigned code = strtoul(json_.substr(pos_, 4).c_str(), NULL, 16);
+        pos_ += 4;
+        AppendUtf8(text, code);
+      } else {
+        const char *from = "\"\\/bfnrt", *to = "\"\\/\b\f\n\r\t";
+        const char *found = strchr(from, c);
+        if (!found || !c)
+          return false;
+        *text += to[found - from];
+      }
+    }
+    return Skip('"');
+  }
+
+  static void AppendUtf8(string *text, unsigned code) {
+    if (code < 0x80) {
+      *text += static_cast<char>(code);
+    } else if (code < 0x800) {
+      *text += static_cast<char>(0xc0 | (code >> 6));
+      *text += static_cast<char>(0x80 | (code & 0x3f));
+    } else {
+      *text += static_cast<char>(0xe0 | (code >> 12));
+      *text += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+      *text += static_cast<char>(0x80 | (code & 0x3f));
+    }
+  }
+
+  const string &json_;
+  size_t pos_;
+  ResultBuilder result_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(JsonResultParser);
+};
+
+// Binary encoding of a result in either encoding, false if it is damaged
+inline bool ResultToBinary(const string &result, string *binary) {
+  if (ResultReader::IsBinary(result)) {
+    *binary = result;
+    return true;
+  }
+  JsonResultParser parser(result);
+  return parser.Parse(binary);
+}
+
+}  // namespace wikigraph
+
+#endif  // SRC_RESULT_BUILDER_H_
@@ -0,0 +1,168 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_RESULT_CACHE_H_
+#define SRC_RESULT_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "wikigraph_stubs_internal.h"
+#include "file_io.h"
+
+namespace wikigraph {
+
+// Results of jobs kept by a worker, so that jobs which are issued again
+// (the controller reschedules jobs, report sections ask for the same nodes)
+// are not computed again. When results take more than capacity bytes the
+// least recently used ones are dropped.
+//
+// Saved file: [kCacheMagic][stamp size][stamp][number of results] and for
+// each result, most recently used first, [key size][value size][key][value].
+// Stamp describes everything results depend on (graph checksums, options),
+// results saved with a different stamp are not loaded.
+class ResultCache {
+ public:
+  static const uint32_t kCacheMagic = 0x48434552;  // "RECH"
+
+  explicit ResultCache(size_t capacity)
+  : capacity_(capacity), bytes_(0), changed_(false) { }
+
+  // Marks the result as recently used
+  bool Get(const string &key, string *value) {
+    Index::iterator it = index_.find(key);
+    if (it == index_.end())
+      return false;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    *value = it->second->second;
+    return true;
+  }
+
+  void Put(const string &key, const string &value) {
+    Add(key, value);
+    changed_ = true;
+  }
+
+  void Write(File *f, const string &stamp) {
+    WriteString(f, stamp, kCacheMagic);
+    uint32_t count = entries_.size();
+    f->write(&count, sizeof(uint32_t), 1);
+    for (Entries::iterator it = entries_.begin(); it != entries_.end();
+        ++it) {
+      uint32_t sizes[2] = { static_cast<uint32_t>(it->first.size()),
+          static_cast<uint32_t>(it->second.size()) };
+      f->write(sizes, sizeof(uint32_t), 2);
+      f->write(it->first.data(), 1, sizes[0]);
+      f->write(it->second.data(), 1, sizes[1]);
+    }
+    changed_ = false;
+  }
+
+  // Adds results saved by Write with the same stamp, as less recently used
+  // than the results which are already here. False if the file has a
+  // different stamp or is damaged (results before the damage are added).
+  bool Read(File *f, const string &stamp) {
+    string saved;
+    uint32_t count;
+    if (!ReadString(f, &saved, kCacheMagic) || saved != stamp
+        || f->read(&count, sizeof(uint32_t), 1) != 1)
+      return false;
+    string key, value;
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t sizes[2];
+      if (f->read(sizes, sizeof(uint32_t), 2) != 2
+          || uint64_t(sizes[0]) + sizes[1] > capacity_
+          || !ReadBytes(f, sizes[0], &key)
+          || !ReadBytes(f, sizes[1], &value))
+        return false;
+      if (!index_.count(key))
+        AddOldest(key, value);
+    }
+    return true;
+  }
+
+  // Results were added since the last Write
+  bool changed() const {
+    return changed_;
+  }
+
+  size_t size() const {
+    return index_.size();
+  }
+
+  size_t bytes() const {
+    return bytes_;
+  }
+
+ private:
+  typedef std::list<pair<string, string> > Entries;
+  typedef std::map<string, Entries::iterator> Index;
+  static const size_t kEntryOverhead = 64;  // list and map nodes
+  static const uint32_t kMaxStamp = 1 << 16;
+
+  static size_t Cost(const string &key, const string &value) {
+    return key.size() + value.size() + kEntryOverhead;
+  }
+
+  void Add(const string &key, const string &value) {
+    Index::iterator it = index_.find(key);
+    if (it != index_.end()) {
+      bytes_ -= Cost(key, it->second->second);
+      entries_.erase(it->second);
+    }
+    entries_.push_front(std::make_pair(key, value));
+    index_[key] = entries_.begin();
+    bytes_ += Cost(key, value);
+    Evict();
+  }
+
+  // Loaded results are older than the ones used by this worker
+  void AddOldest(const string &key, const string &value) {
+    if (bytes_ + Cost(key, value) > capacity_)
+      return;
+    entries_.push_back(std::make_pair(key, value));
+    index_[key] = --entries_.end();
+    bytes_ += Cost(key, value);
+  }
+
+  void Evict() {
+    while (bytes_ > capacity_ && !entries_.empty()) {
+      bytes_ -= Cost(entries_.back().first, entries_.back().second);
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+  }
+
+  static void WriteString(File *f, const string &str, uint32_t magic) {
+    uint32_t header[2] = { magic, static_cast<uint32_t>(str.size()) };
+    f->write(header, sizeof(uint32_t), 2);
+    f->write(str.data(), 1, str.size());
+  }
+
+  static bool ReadString(File *f, string *str, uint32_t magic) {
+    uint32_t header[2];
+    return f->read(header, sizeof(uint32_t), 2) == 2 && header[0] == magic
+        && header[1] <= kMaxStamp && ReadBytes(f, header[1], str);
+  }
+
+  static bool ReadBytes(File *f, uint32_t size, string *out) {
+    out->resize(size);
+    return !size || f->read(&(*out)[0], 1, size) == size;
+  }
+
+  size_t capacity_;
+  size_t bytes_;
+  bool changed_;
+  Entries entries_;  // most recently used first
+  Index index_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ResultCache);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_RESULT_CACHE_H_
@@ -0,0 +1,299 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_SCC_H_
+#define SRC_SCC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+// Strongly connected components with parallel Forward-Backward-Trim:
+//
+//  1. Trim: a node without incoming or outgoing edges (from the nodes which
+//     are left) is a component by itself. Repeated a few times.
+//  2. BFS forwards and backwards from a pivot with large degrees, nodes
+//     reached by both form the giant component.
+//  3. Remaining nodes are either reached forwards only, backwards only or
+//     not at all. A component can not span two of these sets, so each set
+//     is solved by Tarjan's algorithm in its own thread.
+//
+// Component is labeled by its smallest node, invalid nodes are labeled 0.
+class SccSolver {
+  static const int kTrimPasses = 5;
+  static const uint32_t kUnused = UINT32_MAX;  // label of invalid nodes
+  enum {
+    kForward = 1,
+    kBackward = 2,
+    kGiant = kForward | kBackward
+  };
+
+ public:
+  // reverse is the transposed graph
+  SccSolver(Graph *graph, Graph *reverse, BitArray *invalid_node)
+  : graph_(graph), reverse_(reverse), invalid_node_(invalid_node),
+    num_nodes_(graph->num_nodes) { }
+
+  // labels has num_nodes + 1 elements
+  void Run(uint32_t *labels) {
+    label_ = labels;
+    mark_ = new uint8_t[num_nodes_ + 1];
+    flag_ = new uint8_t[num_nodes_ + 1];
+    memset(mark_, 0, num_nodes_ + 1);
+    memset(flag_, 0, num_nodes_ + 1);
+
+    label_[0] = kUnused;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      bool invalid = invalid_node_ && invalid_node_->get_value(node);
+      label_[node] = invalid ? kUnused : 0;
+    }
+
+    Trim();
+    node_t pivot = Pivot();
+    if (pivot) {
+      Reach(graph_, pivot, kForward);
+      Reach(reverse_, pivot, kBackward);
+      LabelGiant();
+    }
+    SolveRest();
+
+    for (node_t node = 0; node <= num_nodes_; node++) {
+      if (label_[node] == kUnused)
+        label_[node] = 0;
+    }
+    delete[] mark_;
+    delete[] flag_;
+  }
+
+ private:
+  // Nodes which are not labeled yet
+  inline bool Active(node_t node) const {
+    return label_[node] == 0;
+  }
+
+  struct TrimBody {
+    SccSolver *s;
+    vector<uint32_t> trimmed;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++) {
+        if (!s->Active(node))
+          continue;
+        if (!s->HasActiveEdge(s->graph_, node)
+            || !s->HasActiveEdge(s->reverse_, node)) {
+          s->flag_[node] = 1;
+          trimmed[thread]++;
+        }
+      }
+    }
+  };
+  bool HasActiveEdge(Graph *graph, node_t node) const {
+    node_t *target = &graph->edges[graph->start(node)];
+    node_t *end = &graph->edges[graph->end(node)];
+    for ( ; target < end; target++) {
+      if (*target != node && Active(*target))
+        return true;
+    }
+    return false;
+  }
+
+  void Trim() {
+    for (int pass = 0; pass < kTrimPasses; pass++) {
+      TrimBody body;
+      body.s = this;
+      body.trimmed.resize(NumThreads());
+      ParallelFor(1, num_nodes_ + 1, 4096, &body);
+      uint32_t trimmed = 0;
+      for (size_t i = 0; i < body.trimmed.size(); i++)
+        trimmed += body.trimmed[i];
+      if (!trimmed)
+        break;
+      // Labels are set after the pass, so that the pass sees the same graph
+      // in all threads
+      for (node_t node = 1; node <= num_nodes_; node++) {
+        if (flag_[node]) {
+          label_[node] = node;
+          flag_[node] = 0;
+        }
+      }
+    }
+  }
+
+  // Active node with the largest product of degrees
+  node_t Pivot() {
+    node_t pivot = 0;
+    uint64_t best = 0;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (!Active(node))
+        continue;
+      uint64_t out_degree = graph_->end(node) - graph_->start(node);
+      uint64_t in_degree = reverse_->end(node) - reverse_->start(node);
+      uint64_t score = (out_degree + 1) * (in_degree + 1);
+      if (!pivot || score > best) {
+        pivot = node;
+        best = score;
+      }
+    }
+    return pivot;
+  }
+
+  // One level of BFS, nodes of the next level are collected per thread
+  struct ReachBody {
+    SccSolver *s;
+    Graph *graph;
+    uint8_t bit;
+    const vector<node_t> *frontier;
+    vector<vector<node_t> > next;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (uint32_t i = begin; i < end; i++) {
+        node_t node = (*frontier)[i];
+        node_t *target = &graph->edges[graph->start(node)];
+        node_t *last = &graph->edges[graph->end(node)];
+        for ( ; target < last; target++) {
+          if (!s->Active(*target)
+              || (AtomicLoad(&s->mark_[*target]) & bit))
+            continue;
+          if (!(AtomicOr<uint8_t>(&s->mark_[*target], bit) & bit))
+            next[thread].push_back(*target);
+        }
+      }
+    }
+  };
+
+  void Reach(Graph *graph, node_t start, uint8_t bit) {
+    vector<node_t> frontier(1, start);
+    mark_[start] |= bit;
+    while (!frontier.empty()) {
+      ReachBody body;
+      body.s = this;
+      body.graph = graph;
+      body.bit = bit;
+      body.frontier = &frontier;
+      body.next.resize(NumThreads());
+      ParallelFor(0, frontier.size(), 256, &body);
+      frontier.clear();
+      for (size_t i = 0; i < body.next.size(); i++)
+        frontier.insert(frontier.end(), body.next[i].begin(),
+            body.next[i].end());
+    }
+  }
+
+  void LabelGiant() {
+    node_t smallest = 0;
+    for (node_t node = 1; node <= num_nodes_; node++) {
+      if (mark_[node] == kGiant) {
+        if (!smallest)
+          smallest = node;
+        label_[node] = smallest;
+      }
+    }
+  }
+
+  // Tarjan's algorithm on each of the sets of remaining nodes
+  struct TarjanBody {
+    SccSolver *s;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (uint32_t group = begin; group < end; group++)
+        s->Tarjan(group);
+    }
+  };
+
+  void SolveRest() {
+    index_ = new int32_t[num_nodes_ + 1];
+    low_ = new int32_t[num_nodes_ + 1];
+    memset(index_, 0, sizeof(index_[0]) * (num_nodes_ + 1));
+    // flag_ is used as "node is on stack"
+    TarjanBody body;
+    body.s = this;
+    ParallelFor(0, kGiant, 1, &body);
+    delete[] index_;
+    delete[] low_;
+  }
+
+  // Node belongs to the group and was not labeled before Tarjan started.
+  // Other groups are not touched, they belong to other threads.
+  inline bool InGroup(node_t node, uint8_t group) const {
+    return mark_[node] == group && (index_[node] || !label_[node]);
+  }
+
+  void Tarjan(uint8_t group) {
+    vector<node_t> call, stack;
+    vector<uint32_t> edge;  // next edge of nodes in call
+    int32_t counter = 0;
+    for (node_t root = 1; root <= num_nodes_; root++) {
+      if (!InGroup(root, group) || index_[root])
+        continue;
+      Visit(root, ++counter, &call, &edge, &stack);
+      while (!call.empty()) {
+        node_t node = call.back();
+        uint32_t i = edge.back();
+        uint32_t end = graph_->end(node);
+        bool descend = false;
+        for ( ; i < end; i++) {
+          node_t target = graph_->edges[i];
+          if (!InGroup(target, group))
+            continue;
+          if (!index_[target]) {
+            edge.back() = i + 1;
+            Visit(target, ++counter, &call, &edge, &stack);
+            descend = true;
+            break;
+          } else if (flag_[target]) {
+            low_[node] = std::min(low_[node], index_[target]);
+          }
+        }
+        if (descend)
+          continue;
+        // All edges of node are done
+        call.pop_back();
+        edge.pop_back();
+        if (!call.empty())
+          low_[call.back()] = std::min(low_[call.back()], low_[node]);
+        if (low_[node] == index_[node]) {
+          // Found a component, it is on top of the stack
+          size_t first = stack.size();
+          node_t smallest = node;
+          do {
+            first--;
+            smallest = std::min(smallest, stack[first]);
+          } while (stack[first] != node);
+          for (size_t j = first; j < stack.size(); j++) {
+            flag_[stack[j]] = 0;
+            label_[stack[j]] = smallest;
+          }
+          stack.resize(first);
+        }
+      }
+    }
+  }
+
+  void Visit(node_t node, int32_t index, vector<node_t> *call,
+      vector<uint32_t> *edge, vector<node_t> *stack) {
+    index_[node] = low_[node] = index;
+    flag_[node] = 1;
+    stack->push_back(node);
+    call->push_back(node);
+    edge->push_back(graph_->start(node));
+  }
+
+  Graph *graph_;
+  Graph *reverse_;
+  BitArray *invalid_node_;
+  uint32_t num_nodes_;
+
+  uint32_t *label_;
+  uint8_t *mark_;  // kForward, kBackward bits
+  uint8_t *flag_;  // trimmed in Trim, on stack in Tarjan
+  int32_t *index_, *low_;  // Tarjan
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SccSolver);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_SCC_H_
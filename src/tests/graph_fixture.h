@@ -0,0 +1,56 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_TESTS_GRAPH_FIXTURE_H_
+#define SRC_TESTS_GRAPH_FIXTURE_H_
+
+#include <cstdlib>
+#include <algorithm>
+
+#include "graph.h"
+#include "tests/mock_file_io.h"
+
+namespace wikigraph {
+
+// Graph file in memory, edges are given as "1>2 2>3 3>1"
+class MemoryGraph {
+ public:
+  MemoryGraph(uint32_t num_nodes, const char *edges) {
+    vector<pii> list;
+    const char *p = edges;
+    while (*p) {
+      char *next;
+      uint32_t from = strtoul(p, &next, 10);
+      if (next == p) {
+        p++;
+        continue;
+      }
+      assert(*next == '>');
+      p = next + 1;
+      uint32_t to = strtoul(p, &next, 10);
+      p = next;
+      list.push_back(pii(from, to));
+    }
+    Write(num_nodes, list);
+  }
+  MemoryGraph(uint32_t num_nodes, vector<pii> list) {
+    Write(num_nodes, list);
+  }
+  StringFile file;
+ private:
+  void Write(uint32_t num_nodes, vector<pii> list) {
+    std::sort(list.begin(), list.end());
+    BufferedWriter writer(&file);
+    GraphBuffWriter graph(&writer, num_nodes);
+    for (size_t i = 0; i < list.size(); i++) {
+      graph.start_node(list[i].first);
+      graph.add_edge(list[i].second);
+    }
+    graph.finish();
+    writer.finish();
+    file.seek(0, SEEK_SET);
+  }
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_TESTS_GRAPH_FIXTURE_H_
@@ -3,6 +3,8 @@
 #ifndef SRC_TESTS_MOCK_FILE_IO_H_
 #define SRC_TESTS_MOCK_FILE_IO_H_
 
+#include <algorithm>
+
 #include "gmock/gmock.h"
 #include "file_io.h"
 
@@ -93,6 +95,55 @@ class StubFile : public File {
   }
 };
 
+// In-memory file which supports both writing and reading
+class StringFile : public File {
+ public:
+  string data_;
+  off_t pos_;
+
+  StringFile() : pos_(0) { }
+
+  bool open(const char *path, const char *mode) {
+    assert(false);
+  }
+  size_t write(const void *ptr, size_t size, size_t nmemb) {
+    const char *p = reinterpret_cast<const char*>(ptr);
+    size_t len = size * nmemb;
+    if (static_cast<size_t>(pos_) + len > data_.size())
+      data_.resize(pos_ + len);
+    data_.replace(pos_, len, p, len);
+    pos_ += len;
+    return nmemb;
+  }
+  size_t read(void *ptr, size_t size, size_t nmemb) {
+    size_t len = std::min(size * nmemb, data_.size() - pos_);
+    memcpy(ptr, data_.data() + pos_, len);
+    pos_ += len;
+    return len / size;
+  }
+  int seek(off_t off, int whence) {
+    if (whence == SEEK_CUR) pos_ += off;
+    else if (whence == SEEK_SET) pos_ = off;
+    else if (whence == SEEK_END) pos_ = data_.size() + off;
+    return 0;
+  }
+  int close() {
+    return 0;
+  }
+  off_t tell() {
+    return pos_;
+  }
+  bool eof() {
+    return static_cast<size_t>(pos_) >= data_.size();
+  }
+  double get_progress() {
+    return 100.0 * pos_ / data_.size();
+  }
+  int fdno() {
+    return -1;
+  }
+};
+
 }  // namespace wikigraph
 
 #endif  // SRC_TESTS_MOCK_FILE_IO_H_
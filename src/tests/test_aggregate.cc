@@ -0,0 +1,98 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include <map>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "aggregate.h"
+#include "tests/mock_file_io.h"
+
+namespace wikigraph {
+
+class SetRecorder : public ResultVisitor {
+ public:
+  void Set(const string &key, const string &value) {
+    keys.push_back(key);
+    values[key] = value;
+  }
+  vector<string> keys;
+  std::map<string, string> values;
+};
+
+TEST(Aggregate, ReadAof) {
+  StringFile file;
+  file.data_ = "*2\r\n$6\r\nSELECT\r\n$1\r\n0\r\n"
+      "*3\r\n$3\r\nset\r\n$9\r\nresult:aR\r\n$12\r\n{\"ranks\":[]}\r\n"
+      "*3\r\n$5\r\nLPUSH\r\n$5\r\nqueue\r\n$3\r\naD1\r\n"
+      "*3\r\n$3\r\nSET\r\n$3\r\nn:1\r\n$6\r\na:A\r\nB\r\n";
+  SetRecorder recorder;
+  ASSERT_TRUE(ReadAof(&file, &recorder));
+  ASSERT_EQ(2u, recorder.keys.size());
+  ASSERT_EQ("{\"ranks\":[]}", recorder.values["result:aR"]);
+  ASSERT_EQ("a:A\r\nB", recorder.values["n:1"]);
+
+  // Commands before the damage are read
+  file.data_.resize(file.data_.size() - 5);
+  file.seek(0, SEEK_SET);
+  SetRecorder damaged;
+  ASSERT_FALSE(ReadAof(&file, &damaged));
+  ASSERT_EQ(1u, damaged.keys.size());
+}
+
+TEST(Aggregate, ReadLocalResults) {
+  ResultBuilder binary(true);
+  uint32_t dist[3] = { 1, 2, 1 };
+  binary.Add("count_dist", vector<uint32_t>(dist, dist + 3));
+  StringFile file;
+  char size[20];
+  snprintf(size, sizeof(size), "%u\n",
+      static_cast<unsigned>(binary.str().size()));
+  file.data_ = "aD1\t{\"count_dist\":[1,2,1]}\naD2\t";
+  file.data_ += size + binary.str();
+  file.data_ += "aI2\t{\"in_degree\":1,\"out_degree\":2}\n";
+  SetRecorder recorder;
+  ASSERT_TRUE(ReadLocalResults(&file, &recorder));
+  ASSERT_EQ(3u, recorder.keys.size());
+  ASSERT_EQ(binary.str(), recorder.values["result:aD2"]);
+  ASSERT_EQ("{\"in_degree\":1,\"out_degree\":2}",
+      recorder.values["result:aI2"]);
+}
+
+TEST(Aggregate, Distances) {
+  vector<string> results;
+  results.push_back("{\"count_dist\":[1,2,1]}");  // reaches 4 of 4
+  ResultBuilder binary(true);
+  uint32_t dist[2] = { 1, 1 };
+  binary.Add("count_dist", vector<uint32_t>(dist, dist + 2));
+  results.push_back(binary.str());
+  results.push_back("{\"error\":\"Node is a category\"}");
+  results.push_back("{\"count_dist\":[1,");
+  vector<const string *> pointers;
+  for (int repeat = 0; repeat < 1000; repeat++) {
+    for (size_t i = 0; i < results.size(); i++)
+      pointers.push_back(&results[i]);
+  }
+
+  SetNumThreads(4);
+  DistanceSummary summary;
+  DistanceAggregator aggregator(&pointers, 4);
+  aggregator.Run(&summary);
+  SetNumThreads(0);
+  ASSERT_EQ(4000u, summary.nodes_done);
+  ASSERT_EQ(2000u, summary.nodes_done_proper);
+  ASSERT_EQ(1000u, summary.num_damaged);
+  ASSERT_EQ(1000u, summary.num_canreachscc);
+  ASSERT_EQ(4000u, summary.reachable_sum);
+  ASSERT_EQ(5000u, summary.distance_sum);
+  ASSERT_EQ(3u, summary.spectrum.size());
+  ASSERT_EQ(2000u, summary.spectrum[0]);
+  ASSERT_EQ(3000u, summary.spectrum[1]);
+  ASSERT_EQ(1000u, summary.spectrum[2]);
+
+  DistanceStat stat(vector<uint32_t>(dist, dist + 2));
+  ASSERT_EQ(1u, stat.reachable);
+  ASSERT_DOUBLE_EQ(1.0, stat.closeness());
+}
+
+}  // namespace wikigraph
@@ -0,0 +1,121 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include <algorithm>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "graph_algo.h"
+#include "tests/graph_fixture.h"
+
+namespace wikigraph {
+
+TEST(CategoryHierarchy, Cycle) {
+  // 1 is the root, 2 and 3 are below it and in a cycle, 4 is an article
+  MemoryGraph g(4, "2>1 3>1 2>3 3>2 4>2");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  CategoryHierarchy *h = algo.Hierarchy(0);
+  ASSERT_EQ(1u, h->num_dropped());
+  ASSERT_EQ(0u, h->level(1));
+  ASSERT_EQ(0u, h->depth(1));
+  ASSERT_EQ(1u, h->depth(2));
+  ASSERT_EQ(1u, h->depth(3));
+  // One of 2 and 3 is under the other one
+  ASSERT_EQ(3u, h->level(2) + h->level(3));
+  ASSERT_EQ(2u, h->depth(4));
+  ASSERT_EQ(3u, h->CountAncestors(4));
+  ASSERT_EQ(0u, h->CountAncestors(1));
+  ASSERT_TRUE(vector<node_t>(1, 2) == h->Parents(4));
+}
+
+TEST(CategoryHierarchy, Root) {
+  // 1 is the root, 5 is another category without parents, 4 is under both
+  MemoryGraph g(5, "2>1 3>2 4>3 4>5");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  CategoryHierarchy *h = algo.Hierarchy(1);
+  ASSERT_EQ(0u, h->depth(1));
+  ASSERT_EQ(3u, h->depth(4));
+  ASSERT_EQ(static_cast<uint32_t>(CategoryHierarchy::kNoDepth), h->depth(5));
+  ASSERT_EQ(4u, h->CountAncestors(4));
+  ASSERT_EQ(4u, h->CountAncestors(4));  // remembered
+}
+
+TEST(CategoryHierarchy, TopBelowRoot) {
+  // Categories 1..200 have no parents and one article each, 201 is the
+  // root with categories 202..210 below it, 211..219 are their articles
+  const node_t root = 201;
+  vector<pii> edges;
+  for (node_t node = 1; node <= 200; node++)
+    edges.push_back(pii(node + 219, node));
+  for (node_t node = 202; node <= 210; node++) {
+    edges.push_back(pii(node, root));
+    edges.push_back(pii(node + 9, node));
+  }
+  std::sort(edges.begin(), edges.end());
+  MemoryGraph g(419, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  CategoryHierarchy *h = algo.Hierarchy(root);
+  ASSERT_LT(static_cast<uint32_t>(CategoryHierarchy::kTopCategories), 200u);
+  ASSERT_EQ(10u, h->top().size());
+  ASSERT_EQ(root, h->top()[0]);
+  for (size_t t = 1; t < h->top().size(); t++)
+    ASSERT_EQ(201 + t, h->top()[t]);
+  vector<node_t> expected;
+  expected.push_back(root);
+  expected.push_back(202);
+  ASSERT_TRUE(expected == h->TopAncestors(211));
+  ASSERT_TRUE(h->TopAncestors(220).empty());
+}
+
+TEST(CategoryHierarchy, Random) {
+  const int n = 600;
+  srand(3);
+  vector<pii> edges;
+  for (int i = 0; i < 3 * n; i++) {
+    node_t from = rand() % n + 1;
+    node_t to = rand() % (n / 3) + 1;  // only some nodes are categories
+    if (from != to)
+      edges.push_back(pii(from, to));
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  CategoryHierarchy *h = algo.Hierarchy(0);
+  ASSERT_GT(h->num_dropped(), 0u);
+  size_t num_top = CategoryHierarchy::kTopCategories;
+  ASSERT_EQ(num_top, h->top().size());
+
+  for (node_t node = 1; node <= n; node++) {
+    // Ancestors by BFS over parents which were kept
+    vector<bool> seen(n + 1, false);
+    vector<node_t> queue(1, node);
+    seen[node] = true;
+    for (size_t i = 0; i < queue.size(); i++) {
+      vector<node_t> parents = h->Parents(queue[i]);
+      for (size_t j = 0; j < parents.size(); j++) {
+        // Levels decrease towards the roots
+        ASSERT_LT(h->level(parents[j]), h->level(queue[i]));
+        ASSERT_LE(h->depth(queue[i]), h->depth(parents[j]) + 1);
+        if (!seen[parents[j]]) {
+          seen[parents[j]] = true;
+          queue.push_back(parents[j]);
+        }
+      }
+    }
+    ASSERT_EQ(queue.size() - 1, h->CountAncestors(node));
+
+    vector<node_t> expected;
+    for (size_t t = 0; t < h->top().size(); t++) {
+      if (h->top()[t] != node && seen[h->top()[t]])
+        expected.push_back(h->top()[t]);
+    }
+    ASSERT_TRUE(expected == h->TopAncestors(node));
+  }
+}
+
+}  // namespace wikigraph
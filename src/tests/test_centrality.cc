@@ -0,0 +1,169 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "graph_algo.h"
+#include "tests/graph_fixture.h"
+
+namespace wikigraph {
+
+TEST(BfsWorkspace, Reuse) {
+  MemoryGraph g(5, "1>2 2>3 3>4 5>1");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  BfsWorkspace w(5);
+  w.Bfs(algo.graph(), 1);
+  ASSERT_EQ(4u, w.size());
+  ASSERT_EQ(3, w.dist()[4]);
+  ASSERT_FALSE(w.Visited(5));
+  w.Bfs(algo.graph(), 3);
+  ASSERT_EQ(2u, w.size());
+  ASSERT_FALSE(w.Visited(1));
+  ASSERT_EQ(1, w.dist()[4]);
+}
+
+TEST(SampledBetweenness, Diamond) {
+  MemoryGraph g(5, "1>2 1>3 2>4 3>4 4>5");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  uint32_t samples = 10;
+  double error;
+  // All nodes are sampled, so the result is exact
+  vector<pair<double, node_t> > top = algo.Betweenness(2, &samples, &error);
+  ASSERT_EQ(5u, samples);
+  ASSERT_EQ(2u, top.size());
+  // 4 is on paths from 1, 2 and 3 to 5, normalized by 4 * 3
+  ASSERT_EQ(4u, top[0].second);
+  ASSERT_DOUBLE_EQ(3.0 / 12, top[0].first);
+  // Half of paths from 1 to 4 and 5
+  ASSERT_DOUBLE_EQ(1.0 / 12, top[1].first);
+  ASSERT_GT(error, 0.0);
+}
+
+// Compare with betweenness from counts of all shortest paths
+TEST(SampledBetweenness, Random) {
+  const int n = 40;
+  SetNumThreads(4);
+  srand(5);
+  vector<pii> edges;
+  vector<vector<int> > adj(n + 1);
+  for (int i = 0; i < 3 * n; i++) {
+    int from = rand() % n + 1, to = rand() % n + 1;
+    if (from == to)
+      continue;
+    edges.push_back(pii(from, to));
+    adj[from].push_back(to);
+  }
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  uint32_t samples = n;
+  double error;
+  vector<pair<double, node_t> > top = algo.Betweenness(n, &samples, &error);
+
+  // Distances and number of shortest paths between all pairs
+  vector<vector<int> > dist(n + 1, vector<int>(n + 1, -1));
+  vector<vector<double> > paths(n + 1, vector<double>(n + 1, 0.0));
+  for (int s = 1; s <= n; s++) {
+    vector<int> queue(1, s);
+    dist[s][s] = 0;
+    paths[s][s] = 1.0;
+    for (size_t top = 0; top < queue.size(); top++) {
+      int node = queue[top];
+      for (size_t j = 0; j < adj[node].size(); j++) {
+        int next = adj[node][j];
+        if (dist[s][next] == -1) {
+          dist[s][next] = dist[s][node] + 1;
+          queue.push_back(next);
+        }
+        if (dist[s][next] == dist[s][node] + 1)
+          paths[s][next] += paths[s][node];
+      }
+    }
+  }
+  vector<double> expected(n + 1, 0.0);
+  for (int v = 1; v <= n; v++) {
+    for (int s = 1; s <= n; s++) {
+      for (int t = 1; t <= n; t++) {
+        if (s == v || t == v || s == t || dist[s][v] < 0 || dist[v][t] < 0)
+          continue;
+        if (dist[s][v] + dist[v][t] == dist[s][t])
+          expected[v] += paths[s][v] * paths[v][t] / paths[s][t];
+      }
+    }
+  }
+  ASSERT_EQ(static_cast<size_t>(n), top.size());
+  for (size_t i = 0; i < top.size(); i++) {
+    ASSERT_NEAR(expected[top[i].second] / ((n - 1) * (n - 2)),
+        top[i].first, 1e-9);
+  }
+  SetNumThreads(0);
+}
+
+TEST(SampledCloseness, Exact) {
+  // 6 is close to 7, but does not reach the largest component
+  MemoryGraph g(7, "1>2 2>3 3>4 4>1 1>3 5>1 6>7");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  vector<pair<double, node_t> > top = algo.SampledClosest(2, 7);
+  ASSERT_EQ(2u, top.size());
+  // Distances from 1: 1, 1, 2 and from 4: 1, 2, 2
+  ASSERT_EQ(1u, top[0].second);
+  ASSERT_DOUBLE_EQ(4.0 / 3, top[0].first);
+  ASSERT_EQ(4u, top[1].second);
+  ASSERT_DOUBLE_EQ(5.0 / 3, top[1].first);
+}
+
+TEST(TopkCloseness, Simple) {
+  MemoryGraph g(7, "1>2 2>3 3>4 4>1 1>3 5>1 6>7");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  uint32_t num_cut;
+  vector<pair<double, node_t> > top = algo.TopClosest(2, &num_cut);
+  ASSERT_EQ(2u, top.size());
+  ASSERT_EQ(1u, top[0].second);
+  ASSERT_DOUBLE_EQ(4.0 / 3, top[0].first);
+  ASSERT_EQ(4u, top[1].second);
+  ASSERT_DOUBLE_EQ(5.0 / 3, top[1].first);
+}
+
+// Compare with averages from complete BFS of every node
+TEST(TopkCloseness, Random) {
+  const int n = 3000;
+  const uint32_t k = 20;
+  SetNumThreads(4);
+  srand(6);
+  vector<pii> edges;
+  for (int i = 0; i < 3 * n; i++)
+    edges.push_back(pii(rand() % n + 1, rand() % n + 1));
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  uint32_t num_cut;
+  vector<pair<double, node_t> > top = algo.TopClosest(k, &num_cut);
+
+  vector<node_t> nodes = NodesReaching(algo.Reverse(), algo.SccLabels(),
+      algo.LargestScc());
+  vector<pair<double, node_t> > expected;
+  BfsWorkspace w(n);
+  for (size_t i = 0; i < nodes.size(); i++) {
+    w.Bfs(algo.graph(), nodes[i]);
+    uint64_t sum = 0;
+    for (uint32_t j = 0; j < w.size(); j++)
+      sum += w.dist()[w.queue()[j]];
+    expected.push_back(std::make_pair(
+          static_cast<double>(sum) / (w.size() - 1), nodes[i]));
+  }
+  std::sort(expected.begin(), expected.end());
+  ASSERT_EQ(k, top.size());
+  for (uint32_t i = 0; i < k; i++) {
+    ASSERT_EQ(expected[i].second, top[i].second);
+    ASSERT_DOUBLE_EQ(expected[i].first, top[i].first);
+  }
+  // Most searches are cut off
+  ASSERT_GT(num_cut, nodes.size() / 2);
+  SetNumThreads(0);
+}
+
+}  // namespace wikigraph
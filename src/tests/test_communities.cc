@@ -0,0 +1,93 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include <map>
+#include <numeric>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "graph_algo.h"
+#include "tests/graph_fixture.h"
+
+namespace wikigraph {
+
+TEST(LabelPropagation, Cliques) {
+  // Two cliques of 5 joined by 5>6, 11 is invalid
+  vector<pii> edges;
+  for (node_t a = 1; a <= 5; a++) {
+    for (node_t b = 1; b <= 5; b++) {
+      if (a != b) {
+        edges.push_back(pii(a, b));
+        edges.push_back(pii(a + 5, b + 5));
+      }
+    }
+  }
+  edges.push_back(pii(5, 6));
+  edges.push_back(pii(11, 1));
+  edges.push_back(pii(11, 6));
+  MemoryGraph g(11, edges);
+  BitArray invalid(12);
+  invalid.set_true(11);
+  CompleteGraphAlgo algo(&g.file, &invalid);
+  algo.Init(false);
+  // Computed on first use by any of them
+  ASSERT_EQ(5u, algo.CommunitySize(3, 30));
+  const uint32_t *community = algo.Communities(30);
+  for (node_t node = 1; node <= 5; node++) {
+    ASSERT_EQ(1u, community[node]);
+    ASSERT_EQ(6u, community[node + 5]);
+  }
+  ASSERT_EQ(0u, community[11]);
+  ASSERT_EQ(0u, algo.CommunitySize(11, 30));
+  ASSERT_EQ(2u, algo.CommunitySizes(30).size());
+}
+
+TEST(LabelPropagation, Planted) {
+  // Dense groups of 50 nodes with a few links between groups
+  const int n = 400, group = 50;
+  srand(31);
+  vector<pii> edges;
+  for (node_t node = 1; node <= n; node++) {
+    node_t first = (node - 1) / group * group + 1;
+    for (int i = 0; i < 8; i++)
+      edges.push_back(pii(node, first + rand() % group));
+    if (rand() % 4 == 0)
+      edges.push_back(pii(node, rand() % n + 1));
+  }
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  SetNumThreads(4);
+  const uint32_t *community = algo.Communities(30);
+  SetNumThreads(0);
+
+  // Most nodes of each group are in one community of their own
+  std::map<uint32_t, int> groups_of;
+  for (node_t first = 1; first <= n; first += group) {
+    std::map<uint32_t, int> count;
+    int largest = 0;
+    uint32_t label = 0;
+    for (node_t node = first; node < first + group; node++) {
+      if (++count[community[node]] > largest) {
+        largest = count[community[node]];
+        label = community[node];
+      }
+    }
+    ASSERT_GE(largest, group * 9 / 10);
+    ASSERT_EQ(1, ++groups_of[label]);
+  }
+
+  // Every node is in a community, saved labels are loaded
+  vector<uint32_t> sizes = algo.CommunitySizes(30);
+  ASSERT_EQ(static_cast<uint32_t>(n),
+      std::accumulate(sizes.begin(), sizes.end(), 0u));
+  StringFile file;
+  WriteNodeArray(&file, community, n, algo.Checksum());
+  uint32_t *loaded = new uint32_t[n + 1];
+  ASSERT_TRUE(ReadNodeArray(&file, n, algo.Checksum(), loaded));
+  for (node_t node = 1; node <= n; node++)
+    ASSERT_EQ(community[node], loaded[node]);
+  delete[] loaded;
+}
+
+}  // namespace wikigraph
@@ -0,0 +1,73 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "dump_cache.h"
+#include "tests/mock_file_io.h"
+
+namespace wikigraph {
+
+TEST(DumpCache, WriteRead) {
+  StringFile f;
+  if (1) {  // Destroy writer before reading
+    DumpCacheWriter w(&f);
+    w.write_uint(12);
+    w.write_string("Main_Page");
+    w.write_string("");
+    w.write_string("1234");
+    w.write_uint(7);
+    w.finish(42);
+  }
+  ASSERT_EQ(0u, f.data_.size() % 4);
+
+  DumpCacheReader r(&f);
+  ASSERT_TRUE(r.init(42));
+  string str;
+  ASSERT_EQ(12u, r.read_uint());
+  r.read_string(&str);
+  ASSERT_EQ("Main_Page", str);
+  r.read_string(&str);
+  ASSERT_EQ("", str);
+  r.read_string(&str);
+  ASSERT_EQ("1234", str);
+  ASSERT_TRUE(r.has_next());
+  ASSERT_EQ(7u, r.read_uint());
+  ASSERT_FALSE(r.has_next());
+}
+
+TEST(DumpCache, Stale) {
+  StringFile f;
+  if (1) {
+    DumpCacheWriter w(&f);
+    w.write_uint(1);
+    w.finish(42);
+  }
+  DumpCacheReader r(&f);
+  ASSERT_FALSE(r.init(43));
+}
+
+TEST(DumpCache, Incomplete) {
+  StringFile f;
+  if (1) {
+    DumpCacheWriter w(&f);
+    w.write_uint(1);
+    w.write_uint(2);
+    w.finish(42);
+  }
+  string complete = f.data_;
+  // Trailer is missing
+  f.data_ = complete.substr(0, 8);
+  DumpCacheReader r1(&f);
+  ASSERT_FALSE(r1.init(42));
+  // Data is missing
+  f.data_ = complete.substr(4);
+  DumpCacheReader r2(&f);
+  ASSERT_FALSE(r2.init(42));
+  // Empty file
+  f.data_.clear();
+  DumpCacheReader r3(&f);
+  ASSERT_FALSE(r3.init(42));
+}
+
+}  // namespace wikigraph
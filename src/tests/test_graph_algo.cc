@@ -4,6 +4,7 @@
 #include "gtest/gtest.h"
 
 #include "graph_algo.h"
+#include "tests/graph_fixture.h"
 #include "tests/mock_file_io.h"
 
 using ::testing::_;
@@ -91,5 +92,268 @@ TEST(CompleteGraphAlgo, PageRankSimple) {
   ASSERT_EQ(2u, res[2].second);
 }
 
+TEST(CompleteGraphAlgo, Reverse) {
+  MemoryGraph g(4, "1>2 1>3 2>3 4>3 4>1");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  Graph *r = algo.Reverse();
+  ASSERT_EQ(5u, r->num_edges);
+  ASSERT_EQ(1u, r->end(1) - r->start(1));
+  ASSERT_EQ(4u, r->edges[r->start(1)]);
+  ASSERT_EQ(1u, r->end(2) - r->start(2));
+  ASSERT_EQ(3u, r->end(3) - r->start(3));
+  ASSERT_EQ(1u, r->edges[r->start(3)]);
+  ASSERT_EQ(2u, r->edges[r->start(3) + 1]);
+  ASSERT_EQ(4u, r->edges[r->start(3) + 2]);
+  ASSERT_EQ(0u, r->end(4) - r->start(4));
+}
+
+TEST(CompleteGraphAlgo, SccLabels) {
+  MemoryGraph g(8, "1>2 2>3 3>1 3>4 4>5 5>4 6>6 7>1");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  const uint32_t *labels = algo.SccLabels();
+  uint32_t expected[9] = {0, 1, 1, 1, 4, 4, 6, 7, 8};
+  for (int i = 0; i <= 8; i++)
+    ASSERT_EQ(expected[i], labels[i]);
+  ASSERT_EQ(3u, algo.SccSize(2));
+  ASSERT_EQ(2u, algo.SccSize(5));
+  ASSERT_EQ(1u, algo.SccSize(8));
+  // Sizes in order of labels
+  vector<uint32_t> sizes = algo.Scc();
+  ASSERT_EQ(5u, sizes.size());
+  ASSERT_EQ(3u, sizes[0]);
+  ASSERT_EQ(2u, sizes[1]);
+}
+
+TEST(CompleteGraphAlgo, SccInvalidNodes) {
+  MemoryGraph g(5, "1>2 2>1 2>4 4>2");
+  BitArray invalid(6);
+  invalid.set_true(3);
+  invalid.set_true(5);
+  CompleteGraphAlgo algo(&g.file, &invalid);
+  algo.Init(false);
+  const uint32_t *labels = algo.SccLabels();
+  ASSERT_EQ(1u, labels[4]);
+  ASSERT_EQ(0u, labels[3]);
+  ASSERT_EQ(0u, labels[5]);
+  ASSERT_EQ(1u, algo.Scc().size());
+  ASSERT_EQ(3u, algo.Scc()[0]);
+}
+
+// Compare with components from transitive closure on random graphs
+TEST(CompleteGraphAlgo, SccRandom) {
+  const int n = 60;
+  SetNumThreads(4);
+  srand(1);
+  for (int round = 0; round < 20; round++) {
+    vector<pii> edges;
+    bool reach[n + 1][n + 1];
+    memset(reach, 0, sizeof(reach));
+    int num_edges = rand() % (3 * n);
+    for (int i = 0; i < num_edges; i++) {
+      int from = rand() % n + 1, to = rand() % n + 1;
+      edges.push_back(pii(from, to));
+      reach[from][to] = true;
+    }
+    for (int k = 1; k <= n; k++)
+      for (int i = 1; i <= n; i++)
+        for (int j = 1; j <= n; j++)
+          reach[i][j] |= reach[i][k] && reach[k][j];
+
+    MemoryGraph g(n, edges);
+    CompleteGraphAlgo algo(&g.file);
+    algo.Init(false);
+    const uint32_t *labels = algo.SccLabels();
+    for (int i = 1; i <= n; i++) {
+      uint32_t smallest = i;
+      for (int j = 1; j < i; j++) {
+        if (reach[i][j] && reach[j][i]) {
+          smallest = j;
+          break;
+        }
+      }
+      ASSERT_EQ(smallest, labels[i]);
+    }
+  }
+  SetNumThreads(0);
+}
+
+// Large enough that all steps run in several threads
+TEST(CompleteGraphAlgo, SccThreads) {
+  const int n = 50000;
+  srand(2);
+  vector<pii> edges;
+  for (int i = 0; i < 2 * n; i++)
+    edges.push_back(pii(rand() % n + 1, rand() % n + 1));
+  MemoryGraph g(n, edges);
+
+  SetNumThreads(1);
+  CompleteGraphAlgo algo1(&g.file);
+  algo1.Init(false);
+  vector<uint32_t> labels(algo1.SccLabels(), algo1.SccLabels() + n + 1);
+  SetNumThreads(4);
+  g.file.seek(0, SEEK_SET);
+  CompleteGraphAlgo algo4(&g.file);
+  algo4.Init(false);
+  for (int i = 0; i <= n; i++)
+    ASSERT_EQ(labels[i], algo4.SccLabels()[i]);
+  SetNumThreads(0);
+}
+
+// Distances from a batch of sources are the same as from one at a time
+TEST(CompleteGraphAlgo, DistancesBatch) {
+  const int n = 3000;
+  srand(3);
+  vector<pii> edges;
+  for (int i = 0; i < 2 * n; i++)
+    edges.push_back(pii(rand() % (n - 300) + 301, rand() % n + 1));
+  for (int i = 1; i <= 300; i++)  // long path, some distances over 100
+    edges.push_back(pii(i, i + 1));
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  vector<node_t> sources;
+  for (node_t node = 1; node <= n; node += 7)
+    sources.push_back(node);
+  sources.push_back(1);
+  vector<vector<uint32_t> > counts;
+  SetNumThreads(4);
+  algo.GetDistances(sources, &counts);
+  SetNumThreads(0);
+  ASSERT_EQ(sources.size(), counts.size());
+  for (size_t i = 0; i < sources.size(); i++)
+    ASSERT_TRUE(algo.GetDistances(sources[i]) == counts[i]);
+  ASSERT_LT(100u, counts.back().size());
+}
+
+TEST(CompleteGraphAlgo, WccLabels) {
+  MemoryGraph g(9, "2>1 3>2 5>4 4>5 6>6 8>7 9>7");
+  BitArray invalid(10);
+  invalid.set_true(9);
+  CompleteGraphAlgo algo(&g.file, &invalid);
+  algo.Init(false);
+  const uint32_t *labels = algo.WccLabels();
+  uint32_t expected[10] = {0, 1, 1, 1, 4, 4, 6, 7, 7, 0};
+  for (int i = 0; i <= 9; i++)
+    ASSERT_EQ(expected[i], labels[i]);
+  ASSERT_EQ(3u, algo.WccSize(3));
+  ASSERT_EQ(2u, algo.WccSize(8));
+  ASSERT_EQ(0u, algo.WccSize(9));
+  vector<uint32_t> sizes = algo.Wcc();
+  ASSERT_EQ(4u, sizes.size());
+  ASSERT_EQ(3u, sizes[0]);
+  ASSERT_EQ(1u, sizes[2]);
+}
+
+// Compare with connected components found by BFS on the undirected graph
+TEST(CompleteGraphAlgo, WccRandom) {
+  const int n = 30000;
+  SetNumThreads(4);
+  srand(3);
+  vector<pii> edges;
+  vector<vector<int> > adj(n + 1);
+  for (int i = 0; i < n / 2; i++) {
+    int from = rand() % n + 1, to = rand() % n + 1;
+    edges.push_back(pii(from, to));
+    adj[from].push_back(to);
+    adj[to].push_back(from);
+  }
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  const uint32_t *labels = algo.WccLabels();
+
+  vector<uint32_t> expected(n + 1, 0);
+  for (int i = 1; i <= n; i++) {
+    if (expected[i])
+      continue;
+    vector<int> queue(1, i);
+    expected[i] = i;
+    for (size_t top = 0; top < queue.size(); top++) {
+      for (size_t j = 0; j < adj[queue[top]].size(); j++) {
+        int next = adj[queue[top]][j];
+        if (!expected[next]) {
+          expected[next] = i;
+          queue.push_back(next);
+        }
+      }
+    }
+  }
+  for (int i = 1; i <= n; i++)
+    ASSERT_EQ(expected[i], labels[i]);
+  SetNumThreads(0);
+}
+
+TEST(CompleteGraphAlgo, Diameter) {
+  // Cycle 1..5 with a shortcut, 6 and 7 are outside of the component
+  MemoryGraph g(7, "1>2 2>3 3>4 4>5 5>1 1>3 5>6 7>1");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  DiameterSolver *diameter = algo.Diameter();
+  ASSERT_EQ(5u, diameter->size());
+  ASSERT_EQ(4u, diameter->diameter());  // from 2 to 1
+  ASSERT_FALSE(diameter->InComponent(6));
+  ASSERT_TRUE(diameter->InComponent(2));
+  ASSERT_LE(diameter->lower(2), 4u);
+  ASSERT_GE(diameter->upper(2), 4u);
+}
+
+// Compare with eccentricities from BFS of every node in the component
+TEST(CompleteGraphAlgo, DiameterRandom) {
+  const int n = 300;
+  srand(4);
+  for (int round = 0; round < 10; round++) {
+    vector<pii> edges;
+    vector<vector<int> > adj(n + 1);
+    for (int i = 0; i < 2 * n; i++) {
+      int from = rand() % n + 1, to = rand() % n + 1;
+      edges.push_back(pii(from, to));
+      adj[from].push_back(to);
+    }
+    MemoryGraph g(n, edges);
+    CompleteGraphAlgo algo(&g.file);
+    algo.Init(false);
+    DiameterSolver *diameter = algo.Diameter();
+
+    uint32_t expected = 0;
+    for (int i = 1; i <= n; i++) {
+      if (!diameter->InComponent(i))
+        continue;
+      vector<int> dist(n + 1, -1);
+      vector<int> queue(1, i);
+      dist[i] = 0;
+      uint32_t ecc = 0;
+      for (size_t top = 0; top < queue.size(); top++) {
+        int node = queue[top];
+        for (size_t j = 0; j < adj[node].size(); j++) {
+          int next = adj[node][j];
+          if (dist[next] == -1 && diameter->InComponent(next)) {
+            dist[next] = dist[node] + 1;
+            ecc = dist[next];
+            queue.push_back(next);
+          }
+        }
+      }
+      ASSERT_EQ(diameter->size(), queue.size());
+      ASSERT_LE(diameter->lower(i), ecc);
+      ASSERT_GE(diameter->upper(i), ecc);
+      expected = std::max(expected, ecc);
+    }
+    ASSERT_EQ(expected, diameter->diameter());
+    ASSERT_LT(diameter->num_bfs(), 2u * diameter->size());
+  }
+}
+
+TEST(CompleteGraphAlgo, Checksum) {
+  MemoryGraph g1(3, "1>2 2>3");
+  MemoryGraph g2(3, "1>2 2>1");
+  CompleteGraphAlgo algo1(&g1.file);
+  algo1.Init(false);
+  CompleteGraphAlgo algo2(&g2.file);
+  algo2.Init(false);
+  ASSERT_NE(algo1.Checksum(), algo2.Checksum());
+}
+
 }  // namespace wikigraph
 
@@ -0,0 +1,86 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include <cmath>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "graph_algo.h"
+#include "tests/graph_fixture.h"
+
+namespace wikigraph {
+
+TEST(Hits, Bipartite) {
+  // 1 and 2 link to 3 and 4, 5 links only to 3
+  MemoryGraph g(5, "1>3 1>4 2>3 2>4 5>3");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  ASSERT_GT(algo.Hits(1e-9, 100), 0u);
+  ASSERT_EQ(0u, algo.Hits(1e-9, 100));  // already computed
+  const float *hubs = algo.hubs();
+  const float *authorities = algo.authorities();
+  ASSERT_NEAR(1.0, hubs[1] + hubs[2] + hubs[5], 1e-6);
+  ASSERT_EQ(0.0f, hubs[3]);
+  ASSERT_EQ(0.0f, authorities[1]);
+  ASSERT_NEAR(hubs[1], hubs[2], 1e-6);
+  ASSERT_GT(hubs[1], hubs[5]);
+  ASSERT_GT(authorities[3], authorities[4]);
+
+  vector<pair<double, node_t> > top = algo.TopNodes(authorities, 10);
+  ASSERT_EQ(5u, top.size());
+  ASSERT_EQ(3u, top[0].second);
+  ASSERT_EQ(4u, top[1].second);
+}
+
+TEST(Hits, Random) {
+  const int n = 200;
+  srand(11);
+  vector<pii> edges;
+  for (int i = 0; i < 4 * n; i++)
+    edges.push_back(pii(rand() % n + 1, rand() % n + 1));
+  MemoryGraph g(n, edges);
+  BitArray invalid(n + 1);
+  invalid.set_true(5);
+  CompleteGraphAlgo algo(&g.file, &invalid);
+  algo.Init(false);
+  Graph *graph = algo.graph();
+
+  // Dense power iteration
+  vector<double> hub(n + 1, 1.0), auth(n + 1);
+  hub[5] = 0.0;
+  for (int iter = 0; iter < 500; iter++) {
+    std::fill(auth.begin(), auth.end(), 0.0);
+    double sum = 0.0;
+    for (node_t node = 1; node <= n; node++) {
+      for (uint32_t e = graph->start(node); e < graph->end(node); e++) {
+        if (graph->edges[e] != 5)
+          auth[graph->edges[e]] += hub[node];
+      }
+    }
+    for (node_t node = 1; node <= n; node++)
+      sum += auth[node];
+    for (node_t node = 1; node <= n; node++)
+      auth[node] /= sum;
+    sum = 0.0;
+    for (node_t node = 1; node <= n; node++) {
+      hub[node] = 0.0;
+      for (uint32_t e = graph->start(node); e < graph->end(node); e++) {
+        if (node != 5)
+          hub[node] += auth[graph->edges[e]];
+      }
+      sum += hub[node];
+    }
+    for (node_t node = 1; node <= n; node++)
+      hub[node] /= sum;
+  }
+
+  SetNumThreads(4);
+  algo.Hits(1e-8, 500);
+  SetNumThreads(0);
+  for (node_t node = 1; node <= n; node++) {
+    ASSERT_NEAR(hub[node], algo.hubs()[node], 1e-5);
+    ASSERT_NEAR(auth[node], algo.authorities()[node], 1e-5);
+  }
+}
+
+}  // namespace wikigraph
@@ -0,0 +1,110 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "graph_algo.h"
+#include "tests/graph_fixture.h"
+
+namespace wikigraph {
+
+TEST(CompleteGraphAlgo, Undirected) {
+  MemoryGraph g(4, "1>2 2>1 2>3 3>3 4>2");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  Graph *u = algo.Undirected();
+  ASSERT_EQ(6u, u->num_edges);
+  ASSERT_EQ(3u, u->end(2) - u->start(2));
+  ASSERT_EQ(1u, u->end(3) - u->start(3));  // without self-link
+  ASSERT_EQ(2u, u->edges[u->start(4)]);
+
+}
+
+TEST(CompleteGraphAlgo, UndirectedSymmetric) {
+  // Lists are not sorted and have duplicates, like in catlinks.graph
+  StringFile file;
+  BufferedWriter writer(&file);
+  GraphBuffWriter graph(&writer, 3);
+  graph.start_node(1);
+  graph.add_edge(3);
+  graph.add_edge(2);
+  graph.add_edge(3);
+  graph.start_node(2);
+  graph.add_edge(1);
+  graph.start_node(3);
+  graph.add_edge(1);
+  graph.add_edge(1);
+  graph.finish();
+  writer.finish();
+  file.seek(0, SEEK_SET);
+
+  CompleteGraphAlgo algo(&file);
+  algo.Init(false);
+  algo.set_symmetric(true);
+  Graph *u = algo.Undirected();
+  ASSERT_EQ(4u, u->num_edges);
+  ASSERT_EQ(2u, u->edges[u->start(1)]);
+  ASSERT_EQ(3u, u->edges[u->start(1) + 1]);
+  ASSERT_EQ(1u, u->end(3) - u->start(3));
+}
+
+TEST(KCore, Simple) {
+  // Triangle with a tail, clique of 4 and a single node
+  MemoryGraph g(10, "1>2 2>3 3>1 3>4 4>5 6>7 6>8 6>9 7>8 7>9 8>9");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  uint32_t expected[11] = {0, 2, 2, 2, 1, 1, 3, 3, 3, 3, 0};
+  const uint32_t *core = algo.CoreNumbers();
+  for (int i = 0; i <= 10; i++)
+    ASSERT_EQ(expected[i], core[i]);
+
+  uint32_t parallel[11];
+  KCore kcore(algo.Undirected(), NULL);
+  kcore.RunParallel(parallel);
+  for (int i = 0; i <= 10; i++)
+    ASSERT_EQ(expected[i], parallel[i]);
+}
+
+// Both variants against removing nodes of the smallest degree one by one
+TEST(KCore, Random) {
+  const int n = 2000;
+  SetNumThreads(4);
+  srand(7);
+  vector<pii> edges;
+  for (int i = 0; i < 4 * n; i++)
+    edges.push_back(pii(rand() % n + 1, rand() % n + 1));
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  Graph *u = algo.Undirected();
+
+  vector<uint32_t> deg(n + 1), expected(n + 1);
+  vector<bool> done(n + 1, false);
+  for (int i = 1; i <= n; i++)
+    deg[i] = u->end(i) - u->start(i);
+  uint32_t k = 0;
+  for (int step = 0; step < n; step++) {
+    int best = 0;
+    for (int i = 1; i <= n; i++) {
+      if (!done[i] && (!best || deg[i] < deg[best]))
+        best = i;
+    }
+    k = std::max(k, deg[best]);
+    expected[best] = k;
+    done[best] = true;
+    for (uint32_t e = u->start(best); e < u->end(best); e++)
+      deg[u->edges[e]]--;
+  }
+
+  vector<uint32_t> buckets(n + 1), parallel(n + 1);
+  KCore kcore(u, NULL);
+  kcore.RunBuckets(&buckets[0]);
+  kcore.RunParallel(&parallel[0]);
+  for (int i = 1; i <= n; i++) {
+    ASSERT_EQ(expected[i], buckets[i]);
+    ASSERT_EQ(expected[i], parallel[i]);
+  }
+  SetNumThreads(0);
+}
+
+}  // namespace wikigraph
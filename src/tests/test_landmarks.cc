@@ -0,0 +1,77 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "graph_algo.h"
+#include "tests/graph_fixture.h"
+
+namespace wikigraph {
+
+const int32_t kUnreachable = LandmarkIndex::kUnreachable;
+
+TEST(LandmarkIndex, Unreachable) {
+  // 4 and 5 can not reach 1, 2, 3
+  MemoryGraph g(5, "1>2 2>3 3>1 1>4 4>5 5>4");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  LandmarkIndex *index = algo.Landmarks();
+  ASSERT_FALSE(index->landmarks().empty());
+  int32_t lower, upper;
+  index->Bounds(1, 5, &lower, &upper);
+  ASSERT_LE(lower, 2);
+  ASSERT_GE(upper, 2);
+  ASSERT_EQ(2, algo.Distance(1, 5));
+  ASSERT_EQ(kUnreachable, algo.Distance(5, 1));
+  ASSERT_EQ(0, algo.Distance(3, 3));
+}
+
+TEST(LandmarkIndex, Random) {
+  const int n = 300;
+  srand(17);
+  vector<pii> edges;
+  for (int i = 0; i < 2 * n; i++)
+    edges.push_back(pii(rand() % n + 1, rand() % n + 1));
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  SetNumThreads(4);
+  LandmarkIndex *index = algo.Landmarks();
+  SetNumThreads(0);
+  ASSERT_EQ(static_cast<size_t>(LandmarkIndex::kLandmarks),
+      index->landmarks().size());
+
+  // Index made from the saved rows is the same
+  LandmarkIndex copy(algo.graph(), algo.Reverse(), NULL);
+  LandmarkIndex::Row *rows = new LandmarkIndex::Row[n + 1];
+  memcpy(rows, index->rows(), sizeof(rows[0]) * (n + 1));
+  copy.Set(rows);
+  ASSERT_TRUE(index->landmarks() == copy.landmarks());
+
+  BfsWorkspace w(n);
+  int exact = 0;
+  for (node_t s = 1; s <= n; s++) {
+    w.Bfs(algo.graph(), s);
+    for (node_t t = 1; t <= n; t++) {
+      int32_t dist = w.Visited(t) ? w.dist()[t] : kUnreachable;
+      ASSERT_EQ(dist, algo.Distance(s, t));
+      int32_t lower, upper;
+      copy.Bounds(s, t, &lower, &upper);
+      if (lower == kUnreachable) {
+        ASSERT_EQ(kUnreachable, dist);
+        continue;
+      }
+      if (upper != kUnreachable) {
+        ASSERT_NE(kUnreachable, dist);
+        ASSERT_GE(upper, dist);
+      }
+      if (dist != kUnreachable) {
+        ASSERT_LE(lower, dist);
+      }
+      exact += lower == upper;
+    }
+  }
+  ASSERT_GT(exact, 0);
+}
+
+}  // namespace wikigraph
@@ -0,0 +1,76 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "name_store.h"
+#include "tests/mock_file_io.h"
+
+namespace wikigraph {
+
+TEST(NameStore, WriteRead) {
+  StringFile f;
+  if (1) {  // Destroy writer before reading
+    NameStoreWriter w(&f, 5);
+    w.add_name(1, "a:", "Main_Page");
+    w.add_name(2, "c:", "Hidden_categories");
+    w.add_name(4, "a:", "It's");
+  }
+  // names are padded to 4 bytes, offset list has 5+2 entries
+  ASSERT_EQ(0u, f.data_.size() % 4);
+
+  NameStore names(&f);
+  names.Init(false);
+  ASSERT_EQ(5u, names.num_nodes());
+  ASSERT_EQ("a:Main_Page", names.name(1));
+  ASSERT_EQ("c:Hidden_categories", names.name(2));
+  ASSERT_EQ("", names.name(3));
+  ASSERT_EQ("a:It's", names.name(4));
+  ASSERT_EQ("", names.name(5));
+  // Out of range
+  ASSERT_EQ("", names.name(0));
+  ASSERT_EQ("", names.name(6));
+}
+
+TEST(NameStore, Empty) {
+  StringFile f;
+  if (1) {
+    NameStoreWriter w(&f, 2);
+  }
+  NameStore names(&f);
+  names.Init(false);
+  ASSERT_EQ(2u, names.num_nodes());
+  ASSERT_EQ("", names.name(1));
+  ASSERT_EQ("", names.name(2));
+}
+
+TEST(NameStore, Match) {
+  StringFile previous_file, current_file;
+  if (1) {
+    NameStoreWriter previous(&previous_file, 4);
+    previous.add_name(1, "a:", "Main_Page");
+    previous.add_name(2, "a:", "Deleted");
+    previous.add_name(3, "a:", "Main");
+    previous.add_name(4, "c:", "Main_Page");
+  }
+  if (1) {  // Page added before the others, one deleted
+    NameStoreWriter current(&current_file, 5);
+    current.add_name(1, "a:", "Added");
+    current.add_name(2, "a:", "Main_Page");
+    current.add_name(3, "a:", "Main");
+    current.add_name(4, "c:", "Main_Page");
+  }
+  NameStore previous(&previous_file), current(&current_file);
+  previous.Init(false);
+  current.Init(false);
+  vector<node_t> previous_node;
+  current.Match(previous, &previous_node);
+  ASSERT_EQ(6u, previous_node.size());
+  ASSERT_EQ(0u, previous_node[1]);
+  ASSERT_EQ(1u, previous_node[2]);
+  ASSERT_EQ(3u, previous_node[3]);
+  ASSERT_EQ(4u, previous_node[4]);
+  ASSERT_EQ(0u, previous_node[5]);  // without a name
+}
+
+}  // namespace wikigraph
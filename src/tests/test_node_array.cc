@@ -0,0 +1,52 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "node_array.h"
+#include "tests/mock_file_io.h"
+
+namespace wikigraph {
+
+TEST(NodeArray, WriteRead) {
+  StringFile f;
+  uint32_t values[4] = {0, 7, 8, 9};
+  WriteNodeArray(&f, values, 3, 42);
+
+  uint32_t read[4] = {0};
+  ASSERT_TRUE(ReadNodeArray(&f, 3, 42, read));
+  for (int i = 0; i < 4; i++)
+    ASSERT_EQ(values[i], read[i]);
+  // Another graph
+  ASSERT_FALSE(ReadNodeArray(&f, 3, 43, read));
+  ASSERT_FALSE(ReadNodeArray(&f, 4, 42, read));
+}
+
+TEST(NodeArray, Doubles) {
+  StringFile f;
+  double values[3] = {0.0, 0.25, 0.75};
+  WriteNodeArray(&f, values, 2, 1);
+  double read[3];
+  ASSERT_TRUE(ReadNodeArray(&f, 2, 1, read));
+  ASSERT_EQ(0.75, read[2]);
+  // Values of another type
+  uint32_t wrong[3];
+  ASSERT_FALSE(ReadNodeArray(&f, 2, 1, wrong));
+}
+
+TEST(NodeArray, Other) {
+  StringFile f;
+  float values[4] = {0.0f, 0.5f, 0.25f, 0.25f};
+  WriteNodeArray(&f, values, 3, 42);
+  // Checksum does not matter
+  vector<float> read;
+  ASSERT_EQ(3u, ReadOtherNodeArray(&f, &read));
+  ASSERT_EQ(4u, read.size());
+  ASSERT_EQ(0.5f, read[1]);
+  ASSERT_EQ(0.25f, read[3]);
+  // Values of another type
+  vector<double> wrong;
+  ASSERT_EQ(0u, ReadOtherNodeArray(&f, &wrong));
+}
+
+}  // namespace wikigraph
@@ -0,0 +1,131 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include <cmath>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "graph_algo.h"
+#include "tests/graph_fixture.h"
+
+namespace wikigraph {
+
+// Dense power iteration, nodes without links jump to a random node
+vector<double> ReferenceRanks(Graph *graph, double damping) {
+  uint32_t n = graph->num_nodes;
+  vector<double> rank(n + 1, 1.0 / n);
+  rank[0] = 0.0;
+  for (int iter = 0; iter < 1000; iter++) {
+    vector<double> next(n + 1, 0.0);
+    double jump = 1.0 - damping;
+    for (node_t node = 1; node <= n; node++) {
+      uint32_t degree = graph->end(node) - graph->start(node);
+      if (!degree)
+        jump += damping * rank[node];
+      for (uint32_t e = graph->start(node); e < graph->end(node); e++)
+        next[graph->edges[e]] += damping * rank[node] / degree;
+    }
+    for (node_t node = 1; node <= n; node++)
+      next[node] += jump / n;
+    rank = next;
+  }
+  return rank;
+}
+
+class PageRankTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    srand(5);
+    vector<pii> edges;
+    for (int i = 0; i < 3 * kNodes; i++) {
+      node_t from = rand() % kNodes + 1;
+      if (from % 7 == 0)
+        continue;  // some nodes have no links
+      edges.push_back(pii(from, rand() % kNodes + 1));
+    }
+    g_ = new MemoryGraph(kNodes, edges);
+  }
+
+  virtual void TearDown() {
+    delete g_;
+  }
+
+  static const int kNodes = 300;
+  MemoryGraph *g_;
+};
+
+TEST_F(PageRankTest, Options) {
+  for (int option = 0; option < 4; option++) {
+    PageRankOptions options;
+    options.damping = 0.8;
+    options.tolerance = 1e-7;
+    options.gauss_seidel = option & 1;
+    options.single_precision = option & 2;
+    CompleteGraphAlgo algo(&g_->file);
+    algo.Init(false);
+    vector<double> expected = ReferenceRanks(algo.graph(), 0.8);
+    const float *ranks = algo.Ranks(options);
+    double sum = 0.0;
+    for (node_t node = 1; node <= kNodes; node++) {
+      ASSERT_NEAR(expected[node], ranks[node], 1e-5);
+      sum += ranks[node];
+    }
+    ASSERT_NEAR(1.0, sum, 1e-5);
+    ASSERT_GT(algo.num_iterations(), 1u);
+    ASSERT_LT(algo.num_iterations(), options.max_iterations);
+  }
+}
+
+TEST_F(PageRankTest, Threads) {
+  CompleteGraphAlgo algo(&g_->file);
+  algo.Init(false);
+  PageRankSolver<double> solver(algo.Reverse(), NULL);
+  vector<double> one(kNodes + 1, 1.0), four(kNodes + 1, 1.0);
+  SetNumThreads(1);
+  solver.Run(PageRankOptions(), &one[0]);
+  SetNumThreads(4);
+  solver.Run(PageRankOptions(), &four[0]);
+  SetNumThreads(0);
+  for (node_t node = 1; node <= kNodes; node++)
+    ASSERT_NEAR(one[node], four[node], 1e-12);
+}
+
+TEST_F(PageRankTest, WarmStart) {
+  CompleteGraphAlgo algo(&g_->file);
+  algo.Init(false);
+  PageRankSolver<double> solver(algo.Reverse(), NULL);
+  vector<double> ranks(kNodes + 1, 1.0);
+  uint32_t cold = solver.Run(PageRankOptions(), &ranks[0]);
+
+  // Next month has a few more links
+  Graph *graph = algo.graph();
+  vector<pii> edges;
+  for (node_t node = 1; node <= kNodes; node++) {
+    for (uint32_t e = graph->start(node); e < graph->end(node); e++)
+      edges.push_back(pii(node, graph->edges[e]));
+  }
+  edges.push_back(pii(kNodes, 1));
+  edges.push_back(pii(1, kNodes));
+  MemoryGraph next_month(kNodes, edges);
+  CompleteGraphAlgo next_algo(&next_month.file);
+  next_algo.Init(false);
+  PageRankSolver<double> next_solver(next_algo.Reverse(), NULL);
+  uint32_t warm = next_solver.Run(PageRankOptions(), &ranks[0]);
+  ASSERT_LT(warm + 3, cold);
+}
+
+TEST(PageRank, InvalidNodes) {
+  // 3 is a category, 2 links only to it so it has no valid links
+  MemoryGraph g(4, "1>2 1>3 2>3 3>1 4>1");
+  BitArray invalid(5);
+  invalid.set_true(3);
+  CompleteGraphAlgo algo(&g.file, &invalid);
+  algo.Init(false);
+  const float *ranks = algo.Ranks(PageRankOptions());
+  ASSERT_EQ(0.0f, ranks[3]);
+  ASSERT_NEAR(1.0, ranks[1] + ranks[2] + ranks[4], 1e-6);
+  ASSERT_GT(ranks[2], ranks[1]);
+  ASSERT_GT(ranks[1], ranks[4]);
+}
+
+}  // namespace wikigraph
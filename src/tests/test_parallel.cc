@@ -0,0 +1,85 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "parallel.h"
+
+namespace wikigraph {
+
+struct MarkRange {
+  vector<uint32_t> *visits;
+  vector<uint64_t> sums;  // per thread
+  void operator()(uint32_t begin, uint32_t end, int thread) {
+    for (uint32_t i = begin; i < end; i++) {
+      AtomicAdd<uint32_t>(&(*visits)[i], 1);
+      sums[thread] += i;
+    }
+  }
+};
+
+TEST(ParallelFor, EachIndexOnce) {
+  for (int threads = 1; threads <= 4; threads++) {
+    SetNumThreads(threads);
+    vector<uint32_t> visits(10000);
+    MarkRange body;
+    body.visits = &visits;
+    body.sums.resize(threads);
+    ParallelFor(3, 9999, 7, &body);
+    uint64_t sum = 0;
+    for (int i = 0; i < threads; i++)
+      sum += body.sums[i];
+    ASSERT_EQ(uint64_t(9998) * 9999 / 2 - 3, sum);
+    for (uint32_t i = 0; i < visits.size(); i++)
+      ASSERT_EQ(i >= 3 && i < 9999 ? 1u : 0u, visits[i]);
+  }
+  SetNumThreads(0);
+}
+
+TEST(ParallelFor, Empty) {
+  MarkRange body;
+  body.visits = NULL;
+  ParallelFor(5, 5, 1, &body);
+}
+
+// The first task of thread 0 waits until other threads have run some of
+// its tasks, which they can only get by stealing
+struct BlockedTasks {
+  vector<uint32_t> *visits;
+  uint32_t first_block;  // tasks [0, first_block) start in thread 0
+  uint32_t stolen;
+  bool wait;
+  void operator()(uint32_t task, int thread) {
+    AtomicAdd<uint32_t>(&(*visits)[task], 1);
+    if (thread != 0 && task < first_block)
+      AtomicAdd<uint32_t>(&stolen, 1);
+    if (thread == 0 && wait) {
+      wait = false;
+      for (int i = 0; i < 10000 && !AtomicLoad(&stolen); i++)
+        usleep(1000);
+    }
+  }
+};
+
+TEST(ParallelTasks, Stealing) {
+  for (int threads = 1; threads <= 4; threads++) {
+    SetNumThreads(threads);
+    vector<uint32_t> visits(400);
+    BlockedTasks body;
+    body.visits = &visits;
+    body.first_block = visits.size() / threads;
+    body.stolen = 0;
+    body.wait = threads > 1;
+    ParallelTasks(visits.size(), &body);
+    for (uint32_t i = 0; i < visits.size(); i++)
+      ASSERT_EQ(1u, visits[i]);
+    if (threads > 1) {
+      ASSERT_GT(body.stolen, 0u);
+    }
+  }
+  SetNumThreads(0);
+  BlockedTasks body;
+  ParallelTasks(0, &body);
+}
+
+}  // namespace wikigraph
@@ -0,0 +1,63 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "graph_algo.h"
+#include "tests/graph_fixture.h"
+
+namespace wikigraph {
+
+TEST(PrunedLabeling, Component) {
+  // 1, 2, 3, 4 are the largest component, 5 and 6 are outside
+  MemoryGraph g(6, "1>2 2>3 3>4 4>1 2>4 4>5 5>6 6>5");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  PrunedLabeling *labeling = algo.DistanceLabels();
+  ASSERT_TRUE(labeling->Labeled(1));
+  ASSERT_TRUE(labeling->Labeled(4));
+  ASSERT_FALSE(labeling->Labeled(5));
+  ASSERT_EQ(2, labeling->Distance(1, 4));
+  ASSERT_EQ(1, labeling->Distance(4, 1));
+  ASSERT_EQ(3, labeling->Distance(3, 2));
+  ASSERT_EQ(0, labeling->Distance(2, 2));
+}
+
+TEST(PrunedLabeling, Random) {
+  const int n = 400;
+  srand(23);
+  vector<pii> edges;
+  for (int i = 0; i < 3 * n; i++)
+    edges.push_back(pii(rand() % n + 1, rand() % n + 1));
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  PrunedLabeling *labeling = algo.DistanceLabels();
+  const uint32_t *scc = algo.SccLabels();
+  uint32_t largest = algo.LargestScc();
+  ASSERT_GT(algo.SccSize(largest), n / 2u);
+  // Labels are much smaller than all pairs
+  ASSERT_LT(labeling->num_entries(), uint64_t(n) * n / 4);
+
+  // Labels read back give the same distances
+  StringFile file;
+  labeling->Write(&file, algo.Checksum());
+  PrunedLabeling copy(algo.graph(), algo.Reverse());
+  ASSERT_FALSE(copy.Read(&file, algo.Checksum() + 1));
+  ASSERT_TRUE(copy.Read(&file, algo.Checksum()));
+
+  BfsWorkspace w(n);
+  for (node_t s = 1; s <= n; s++) {
+    ASSERT_EQ(scc[s] == largest, copy.Labeled(s));
+    if (scc[s] != largest)
+      continue;
+    w.Bfs(algo.graph(), s);
+    for (node_t t = 1; t <= n; t++) {
+      if (scc[t] != largest)
+        continue;
+      ASSERT_EQ(w.dist()[t], copy.Distance(s, t));
+    }
+  }
+}
+
+}  // namespace wikigraph
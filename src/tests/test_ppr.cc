@@ -0,0 +1,80 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "graph_algo.h"
+#include "tests/graph_fixture.h"
+
+namespace wikigraph {
+
+// Compare with power iteration of the random walk with restart
+TEST(PersonalizedPageRank, PowerIteration) {
+  const int n = 200;
+  const double alpha = 0.15, epsilon = 1e-6;
+  srand(9);
+  vector<pii> edges;
+  for (int i = 0; i < 4 * n; i++)
+    edges.push_back(pii(rand() % n + 1, rand() % n + 1));
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  Graph *graph = algo.graph();
+
+  PersonalizedPageRank ppr(graph);
+  for (node_t source = 1; source <= 3; source++) {
+    vector<double> rank(n + 1, 0.0);
+    rank[source] = 1.0;
+    for (int iter = 0; iter < 200; iter++) {
+      vector<double> next(n + 1, 0.0);
+      next[source] = alpha;
+      for (int node = 1; node <= n; node++) {
+        uint32_t degree = graph->end(node) - graph->start(node);
+        double mass = (1.0 - alpha) * rank[node];
+        if (!degree) {
+          next[source] += mass;
+          continue;
+        }
+        for (uint32_t e = graph->start(node); e < graph->end(node); e++)
+          next[graph->edges[e]] += mass / degree;
+      }
+      rank = next;
+    }
+
+    vector<pair<double, node_t> > top = ppr.Run(source, alpha, epsilon, 10);
+    ASSERT_EQ(10u, top.size());
+    // Error of every node is at most the sum of residuals left
+    double residuals = 0.0;
+    for (int node = 1; node <= n; node++)
+      residuals += ppr.residual(node);
+    for (int node = 1; node <= n; node++) {
+      ASSERT_LE(ppr.estimate(node), rank[node] + 1e-12);
+      ASSERT_GE(ppr.estimate(node) + residuals, rank[node]);
+    }
+    for (size_t i = 1; i < top.size(); i++) {
+      ASSERT_NE(source, top[i].second);
+      ASSERT_GE(top[i - 1].first, top[i].first);
+    }
+  }
+}
+
+TEST(PersonalizedPageRank, Local) {
+  // 4 and 5 can not be reached from 1
+  MemoryGraph g(5, "1>2 2>3 3>1 4>5 5>4");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  uint32_t num_pushes;
+  vector<pair<double, node_t> > related = algo.Related(1, 0.15, 1e-4, 10,
+      &num_pushes);
+  ASSERT_EQ(2u, related.size());
+  ASSERT_EQ(2u, related[0].second);
+  ASSERT_EQ(3u, related[1].second);
+  ASSERT_GT(num_pushes, 0u);
+
+  // Arrays are reused by the next query
+  related = algo.Related(4, 0.15, 1e-4, 10, &num_pushes);
+  ASSERT_EQ(1u, related.size());
+  ASSERT_EQ(5u, related[0].second);
+}
+
+}  // namespace wikigraph
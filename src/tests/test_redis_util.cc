@@ -47,5 +47,18 @@ TEST(to_json, VPII) {
   ASSERT_EQ("[[1,2],[3,4],[1,3]]", util::to_json(vdata));
 }
 
+TEST(to_json, VPDI) {
+  vector<pair<double, node_t> > vdata;
+  vdata.push_back(std::make_pair(0.5, 3u));
+  vdata.push_back(std::make_pair(0.0000123456789, 7u));
+  ASSERT_EQ("[[0.5,3],[1.23456789e-05,7]]", util::to_json(vdata));
+}
+
+TEST(to_json, String) {
+  ASSERT_EQ("\"a:Main_Page\"", util::to_json(string("a:Main_Page")));
+  ASSERT_EQ("\"a:\\\"Q\\\\\"", util::to_json(string("a:\"Q\\")));
+  ASSERT_EQ("\"\\u0001\"", util::to_json(string("\x01")));
+}
+
 }  // namespace wikigraph
 
@@ -0,0 +1,142 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "result_builder.h"
+
+namespace wikigraph {
+
+// Adds the same fields to a JSON and a binary result
+void AddFields(ResultBuilder *result) {
+  uint32_t dist[5] = { 1, 5, 130, 20000, 0 };
+  result->Add("count_dist", vector<uint32_t>(dist, dist + 5));
+  vector<pii> histogram;
+  histogram.push_back(pii(1, 3000000));
+  histogram.push_back(pii(2, 17));
+  histogram.push_back(pii(400, 1));
+  result->Add("components", histogram);
+  vector<pair<double, node_t> > scores;
+  scores.push_back(std::make_pair(0.5, 3u));
+  scores.push_back(std::make_pair(1.23456789e-05, 7u));
+  result->Add("ranks", scores);
+  result->Add("size", 300u);
+  result->Add("triangles", uint64_t(1) << 40);
+  result->Add("lower", int32_t(-1));
+  result->Add("upper", int32_t(12));
+  result->Add("clustering", 0.25);
+  result->Add("name", string("a:\"Quoted\""));
+}
+
+TEST(ResultBuilder, Json) {
+  ResultBuilder result(false);
+  AddFields(&result);
+  ASSERT_EQ("{\"count_dist\":[1,5,130,20000,0],"
+      "\"components\":[[1,3000000],[2,17],[400,1]],"
+      "\"ranks\":[[0.5,3],[1.23456789e-05,7]],\"size\":300,"
+      "\"triangles\":1099511627776,\"lower\":-1,\"upper\":12,"
+      "\"clustering\":0.25,\"name\":\"a:\\\"Quoted\\\"\"}", result.str());
+
+  ResultBuilder empty(false);
+  ASSERT_EQ("{}", empty.str());
+}
+
+TEST(ResultBuilder, Binary) {
+  ResultBuilder json(false), binary(true);
+  AddFields(&json);
+  AddFields(&binary);
+  ASSERT_TRUE(ResultReader::IsBinary(binary.str()));
+  ASSERT_FALSE(ResultReader::IsBinary(json.str()));
+  ASSERT_LT(binary.str().size(), json.str().size());
+
+  string decoded;
+  ASSERT_TRUE(ResultToJson(binary.str(), &decoded));
+  ASSERT_EQ(json.str(), decoded);
+  ASSERT_TRUE(ResultToJson(json.str(), &decoded));
+  ASSERT_EQ(json.str(), decoded);
+
+  ResultReader reader(binary.str());
+  ASSERT_TRUE(reader.Next());
+  ASSERT_EQ("count_dist", reader.key());
+  ASSERT_EQ(kResultList, reader.type());
+  ASSERT_EQ(20000u, reader.list()[3]);
+  ASSERT_TRUE(reader.Next());
+  ASSERT_EQ(400u, reader.histogram()[2].first);
+
+  // Every shorter result is damaged
+  const string &full = binary.str();
+  for (size_t size = 2; size < full.size(); size++) {
+    string part = full.substr(0, size);
+    ResultReader damaged(part);
+    while (damaged.Next()) { }
+    if (damaged.ok())  // ends at a field boundary
+      continue;
+    ASSERT_FALSE(ResultToJson(part, &decoded));
+  }
+}
+
+TEST(ResultBuilder, Error) {
+  ResultBuilder json(false), binary(true);
+  json.Add("size", 3u);
+  json.Error("Node is required");
+  ASSERT_EQ("{\"error\":\"Node is required\"}", json.str());
+  binary.Add("size", 3u);
+  binary.Error("Node is required");
+  string decoded;
+  ASSERT_TRUE(ResultToJson(binary.str(), &decoded));
+  ASSERT_EQ(json.str(), decoded);
+}
+
+TEST(ResultBuilder, ParseJson) {
+  ResultBuilder json(false), binary(true);
+  AddFields(&json);
+  AddFields(&binary);
+  string parsed, decoded;
+  // Non-negative numbers are unsigned in JSON, so only JSON is the same
+  ASSERT_TRUE(ResultToBinary(json.str(), &parsed));
+  ASSERT_TRUE(ResultReader::IsBinary(parsed));
+  ASSERT_TRUE(ResultToJson(parsed, &decoded));
+  ASSERT_EQ(json.str(), decoded);
+  ASSERT_TRUE(ResultToBinary(binary.str(), &parsed));
+  ASSERT_EQ(binary.str(), parsed);
+
+  // Written by older workers
+  ASSERT_TRUE(ResultToBinary("{\"name\":\"\\u00e9\\n\",\"list\":[]}",
+      &parsed));
+  ResultReader reader(parsed);
+  ASSERT_TRUE(reader.Next());
+  ASSERT_EQ("\xc3\xa9\n", reader.text());
+  ASSERT_TRUE(reader.Next());
+  ASSERT_EQ(kResultList, reader.type());
+  ASSERT_FALSE(reader.Next());
+  ASSERT_TRUE(reader.ok());
+
+  // Pairs are decoded by the field, not by their values
+  ASSERT_TRUE(ResultToBinary("{\"betweenness\":[[0,12]],\"cores\":[[1,5]]}",
+      &parsed));
+  ResultReader pairs(parsed);
+  ASSERT_TRUE(pairs.Next());
+  ASSERT_EQ(kResultScores, pairs.type());
+  ASSERT_TRUE(pairs.Next());
+  ASSERT_EQ(kResultHistogram, pairs.type());
+  ASSERT_FALSE(pairs.Next());
+  ASSERT_TRUE(pairs.ok());
+  ASSERT_FALSE(ResultToBinary("{\"cores\":[[0.5,1]]}", &parsed));
+
+  // Every histogram written as JSON is read back as one
+  size_t count = sizeof(kHistogramFields) / sizeof(kHistogramFields[0]);
+  for (size_t i = 0; i < count; i++) {
+    ResultBuilder result(false);
+    result.Add(kHistogramFields[i], vector<pii>(1, pii(0, 12)));
+    ASSERT_TRUE(ResultToBinary(result.str(), &parsed));
+    ResultReader histogram(parsed);
+    ASSERT_TRUE(histogram.Next());
+    ASSERT_EQ(kResultHistogram, histogram.type());
+  }
+
+  ASSERT_FALSE(ResultToBinary("", &parsed));
+  ASSERT_FALSE(ResultToBinary("{\"size\":", &parsed));
+  ASSERT_FALSE(ResultToBinary("{\"list\":[1,[2,3]]}", &parsed));
+}
+
+}  // namespace wikigraph
@@ -0,0 +1,71 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "result_cache.h"
+#include "tests/mock_file_io.h"
+
+namespace wikigraph {
+
+TEST(ResultCache, LeastRecentlyUsed) {
+  // Room for three results
+  ResultCache cache(3 * (3 + 9 + 64));
+  string value;
+  ASSERT_FALSE(cache.Get("aD1", &value));
+  cache.Put("aD1", "{\"a\":\"1\"}");
+  cache.Put("aD2", "{\"a\":\"2\"}");
+  cache.Put("aD3", "{\"a\":\"3\"}");
+  ASSERT_TRUE(cache.Get("aD1", &value));
+  ASSERT_EQ("{\"a\":\"1\"}", value);
+  cache.Put("aD4", "{\"a\":\"4\"}");  // drops aD2
+  ASSERT_EQ(3u, cache.size());
+  ASSERT_FALSE(cache.Get("aD2", &value));
+  ASSERT_TRUE(cache.Get("aD3", &value));
+  ASSERT_TRUE(cache.Get("aD4", &value));
+  cache.Put("aD4", "{\"a\":\"5\"}");
+  ASSERT_TRUE(cache.Get("aD4", &value));
+  ASSERT_EQ("{\"a\":\"5\"}", value);
+  ASSERT_EQ(3u, cache.size());
+
+  // Too large to be kept
+  cache.Put("aR", string(1000, 'x'));
+  ASSERT_EQ(0u, cache.size());
+  ASSERT_EQ(0u, cache.bytes());
+}
+
+TEST(ResultCache, WriteRead) {
+  ResultCache cache(1 << 20);
+  cache.Put("aD1", "{\"count_dist\":[1]}");
+  cache.Put("cS", string("\x01\x00\x05", 3));
+  ASSERT_TRUE(cache.changed());
+  StringFile file;
+  cache.Write(&file, "art 1 cat 2");
+  ASSERT_FALSE(cache.changed());
+
+  file.seek(0, SEEK_SET);
+  ResultCache other(1 << 20);
+  ASSERT_FALSE(other.Read(&file, "art 1 cat 3"));
+  ASSERT_EQ(0u, other.size());
+
+  // Results of this worker are kept longer than loaded ones
+  ResultCache loaded(2 * (3 + 18 + 64));
+  loaded.Put("aD2", "{\"count_dist\":[2]}");
+  file.seek(0, SEEK_SET);
+  ASSERT_TRUE(loaded.Read(&file, "art 1 cat 2"));
+  string value;
+  ASSERT_TRUE(loaded.Get("aD2", &value));
+  ASSERT_TRUE(loaded.Get("cS", &value));
+  ASSERT_EQ(string("\x01\x00\x05", 3), value);
+  ASSERT_FALSE(loaded.Get("aD1", &value));
+
+  // Damaged file
+  file.data_.resize(file.data_.size() - 1);
+  file.seek(0, SEEK_SET);
+  ResultCache damaged(1 << 20);
+  ASSERT_FALSE(damaged.Read(&file, "art 1 cat 2"));
+  ASSERT_EQ(1u, damaged.size());
+  ASSERT_FALSE(damaged.changed());
+}
+
+}  // namespace wikigraph
@@ -0,0 +1,64 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "graph_algo.h"
+#include "tests/graph_fixture.h"
+
+namespace wikigraph {
+
+TEST(TriangleCounter, Simple) {
+  // Two triangles sharing the edge 1-2, and a tail
+  MemoryGraph g(5, "1>2 2>3 3>1 1>4 4>2 4>5");
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  const uint64_t *triangles = algo.Triangles();
+  uint64_t expected[6] = {0, 2, 2, 1, 1, 0};
+  for (int i = 0; i <= 5; i++)
+    ASSERT_EQ(expected[i], triangles[i]);
+  ASSERT_DOUBLE_EQ(2.0 / 3, algo.Clustering(1));
+  ASSERT_DOUBLE_EQ(1.0 / 3, algo.Clustering(4));
+  ASSERT_DOUBLE_EQ(0.0, algo.Clustering(5));
+
+  uint64_t num_triangles;
+  double average, transitivity;
+  algo.ClusteringInfo(&num_triangles, &average, &transitivity);
+  ASSERT_EQ(2u, num_triangles);
+  ASSERT_DOUBLE_EQ((2.0 / 3 + 2.0 / 3 + 1 + 1.0 / 3) / 5, average);
+  // 3 + 3 + 1 + 3 paths of length 2
+  ASSERT_DOUBLE_EQ(6.0 / 10, transitivity);
+}
+
+// Compare with checking every pair of neighbours
+TEST(TriangleCounter, Random) {
+  const int n = 3000;
+  SetNumThreads(4);
+  srand(8);
+  vector<pii> edges;
+  for (int i = 0; i < 5 * n; i++) {
+    // Some nodes with high degree, so both intersections are used
+    int from = i % 10 ? rand() % n + 1 : rand() % 5 + 1;
+    edges.push_back(pii(from, rand() % n + 1));
+  }
+  MemoryGraph g(n, edges);
+  CompleteGraphAlgo algo(&g.file);
+  algo.Init(false);
+  const uint64_t *triangles = algo.Triangles();
+
+  Graph *u = algo.Undirected();
+  for (int node = 1; node <= n; node++) {
+    uint64_t expected = 0;
+    for (uint32_t i = u->start(node); i < u->end(node); i++) {
+      for (uint32_t j = i + 1; j < u->end(node); j++) {
+        if (std::binary_search(u->edges + u->start(u->edges[i]),
+              u->edges + u->end(u->edges[i]), u->edges[j]))
+          expected++;
+      }
+    }
+    ASSERT_EQ(expected, triangles[node]);
+  }
+  SetNumThreads(0);
+}
+
+}  // namespace wikigraph
@@ -0,0 +1,206 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_TOPK_CLOSENESS_H_
+#define SRC_TOPK_CLOSENESS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+#include "graph.h"
+#include "centrality.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+// Exact top-k closeness (smallest average distance to reachable nodes)
+// without a complete BFS from every node (Bergamini et al.). Candidates are
+// searched in order of decreasing degree, so good nodes are found early.
+// After each BFS level the average distance of the node is bounded from
+// below, and the search is cut off once the bound is worse than the k-th
+// best average found so far.
+//
+// After levels up to d+1 are found (n nodes, sum of distances S), each of
+// the remaining r - n reachable nodes is at distance d+2 or more, and at
+// most U of them (edges leaving level d+1) are at distance d+2:
+//
+//   sum >= S + (d+2) * min(U, r-n) + (d+3) * max(0, r-n-U)
+//
+// Every candidate reaches the component, so it reaches at least as many
+// nodes as the component does, which bounds r from below. The bound on
+// the average grows with r, so the smallest possible r is used.
+//
+// Threads share the current top-k under a mutex, the k-th best value is
+// read without locking at the start of every BFS. Ties are broken by node,
+// so the result does not depend on the order of threads.
+class TopkCloseness {
+ public:
+  // Only nodes which reach the component are ranked
+  TopkCloseness(Graph *graph, Graph *reverse, const uint32_t *labels,
+      uint32_t component)
+  : graph_(graph), reverse_(reverse), labels_(labels),
+    component_(component), num_nodes_(graph->num_nodes), how_many_(0),
+    min_reach_(0), threshold_(0), num_cut_(0) {
+    pthread_mutex_init(&lock_, NULL);
+    SetThreshold(HUGE_VAL);
+  }
+
+  ~TopkCloseness() {
+    pthread_mutex_destroy(&lock_);
+  }
+
+  // Nodes with the smallest average distance, sorted
+  vector<pair<double, node_t> > Run(uint32_t how_many) {
+    how_many_ = how_many;
+    vector<node_t> nodes = NodesReaching(reverse_, labels_, component_);
+    if (nodes.empty() || !how_many)
+      return vector<pair<double, node_t> >();
+
+    // Nodes reached from the component
+    BfsWorkspaces workspaces(num_nodes_);
+    node_t member = 1;
+    while (labels_[member] != component_)
+      member++;
+    workspaces.get(0)->Bfs(graph_, member);
+    min_reach_ = workspaces.get(0)->size();
+
+    vector<pair<uint32_t, node_t> > order;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      node_t node = nodes[i];
+      uint32_t degree = graph_->end(node) - graph_->start(node);
+      order.push_back(std::make_pair(UINT32_MAX - degree, node));
+    }
+    std::sort(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); i++)
+      nodes[i] = order[i].second;
+
+    CandidateBody body = { this, &nodes, &workspaces };
+    ParallelFor(0, nodes.size(), 16, &body);
+
+    vector<pair<double, node_t> > ret;
+    while (!top_.empty()) {
+      ret.push_back(top_.top());
+      top_.pop();
+    }
+    std::reverse(ret.begin(), ret.end());
+    return ret;
+  }
+
+  // Number of searches which were cut off
+  uint32_t num_cut() const {
+    return num_cut_;
+  }
+
+ private:
+  struct CandidateBody {
+    TopkCloseness *s;
+    const vector<node_t> *nodes;
+    BfsWorkspaces *workspaces;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (uint32_t i = begin; i < end; i++)
+        s->Candidate((*nodes)[i], workspaces->get(thread));
+    }
+  };
+
+  void Candidate(node_t node, BfsWorkspace *w) {
+    double threshold = Threshold();
+    double avg;
+    if (!PrunedBfs(node, threshold, w, &avg)) {
+      AtomicAdd<uint32_t>(&num_cut_, 1);
+      return;
+    }
+    pthread_mutex_lock(&lock_);
+    pair<double, node_t> item(avg, node);
+    if (top_.size() < how_many_) {
+      top_.push(item);
+    } else if (item < top_.top()) {
+      top_.pop();
+      top_.push(item);
+    }
+    if (top_.size() == how_many_)
+      SetThreshold(top_.top().first);
+    pthread_mutex_unlock(&lock_);
+  }
+
+  // Returns false if the BFS was cut off, otherwise the average distance
+  bool PrunedBfs(node_t start, double threshold, BfsWorkspace *w,
+      double *avg) {
+    node_t *queue = w->queue();
+    w->Start(start);
+    uint64_t sum = 0;
+    uint32_t top = 0;
+    for (int32_t level = 0; top < w->size(); level++) {
+      // Expand all nodes at distance level, count edges out of the next
+      uint32_t level_end = w->size();
+      uint64_t next_edges = 0;
+      for ( ; top < level_end; top++) {
+        node_t node = queue[top];
+        node_t *target = &graph_->edges[graph_->start(node)];
+        node_t *end = &graph_->edges[graph_->end(node)];
+        for ( ; target < end; target++) {
+          if (!w->Visited(*target)) {
+            w->Visit(*target, level + 1);
+            sum += level + 1;
+            next_edges += graph_->end(*target) - graph_->start(*target);
+          }
+        }
+      }
+      if (w->size() == level_end)
+        break;  // nothing new, search is complete
+      if (threshold == HUGE_VAL)
+        continue;
+      // Bound the average, levels up to level+1 are known
+      uint64_t found = w->size();
+      uint64_t reach = std::max<uint64_t>(min_reach_, found);
+      uint64_t rest = reach - found;
+      uint64_t near = std::min(rest, next_edges);
+      uint64_t bound = sum + (level + 2) * near + (level + 3) * (rest - near);
+      if (static_cast<double>(bound) / (reach - 1) > threshold)
+        return false;
+    }
+    *avg = w->size() > 1 ? static_cast<double>(sum) / (w->size() - 1)
+        : HUGE_VAL;
+    return true;
+  }
+
+  double Threshold() {
+    uint64_t bits = AtomicLoad(&threshold_);
+    double threshold;
+    memcpy(&threshold, &bits, sizeof(threshold));
+    return threshold;
+  }
+
+  // Called with lock_ held (or before threads start)
+  void SetThreshold(double threshold) {
+    uint64_t bits, old_bits;
+    memcpy(&bits, &threshold, sizeof(bits));
+    do {
+      old_bits = AtomicLoad(&threshold_);
+    } while (!AtomicCas(&threshold_, old_bits, bits));
+  }
+
+  Graph *graph_;
+  Graph *reverse_;
+  const uint32_t *labels_;
+  uint32_t component_;
+  uint32_t num_nodes_;
+  uint32_t how_many_;
+  uint32_t min_reach_;  // nodes reached from the component
+
+  pthread_mutex_t lock_;
+  std::priority_queue<pair<double, node_t> > top_;  // worst on top
+  uint64_t threshold_;  // bits of double, k-th best average
+  uint32_t num_cut_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TopkCloseness);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_TOPK_CLOSENESS_H_
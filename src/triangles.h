@@ -0,0 +1,171 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_TRIANGLES_H_
+#define SRC_TRIANGLES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+// Exact number of triangles each node is part of, in an undirected graph
+// (each edge is given in both directions, lists are sorted and without
+// duplicates, see CompleteGraphAlgo::Undirected).
+//
+// Every edge is oriented from the node of smaller degree to the node of
+// larger degree (ties by node), so each triangle is found exactly once and
+// no node has more than O(sqrt(E)) oriented edges. For an oriented edge
+// v->u, nodes in both oriented lists of v and u close a triangle. Lists are
+// sorted, they are intersected by merging, or by binary search of the
+// shorter list in the longer one when sizes differ a lot.
+class TriangleCounter {
+  static const uint32_t kGallopRatio = 32;
+
+ public:
+  explicit TriangleCounter(Graph *graph)
+  : graph_(graph), num_nodes_(graph->num_nodes), triangles_(NULL) { }
+
+  // triangles has num_nodes + 1 elements, returns the number of triangles
+  uint64_t Run(uint64_t *triangles) {
+    triangles_ = triangles;
+    memset(triangles_, 0, sizeof(uint64_t) * (num_nodes_ + 1));
+    Orient();
+    CountBody count;
+    count.s = this;
+    count.total.resize(NumThreads());
+    ParallelFor(1, num_nodes_ + 1, 256, &count);
+    oriented_.release();
+    uint64_t total = 0;
+    for (size_t i = 0; i < count.total.size(); i++)
+      total += count.total[i];
+    return total;
+  }
+
+ private:
+  inline bool Before(node_t a, node_t b) const {
+    uint32_t deg_a = graph_->end(a) - graph_->start(a);
+    uint32_t deg_b = graph_->end(b) - graph_->start(b);
+    return deg_a < deg_b || (deg_a == deg_b && a < b);
+  }
+
+  // Oriented list of node, sorted since the whole list is
+  void Collect(node_t node, vector<node_t> *list) {
+    list->clear();
+    for (uint32_t e = graph_->start(node); e < graph_->end(node); e++) {
+      if (Before(node, graph_->edges[e]))
+        list->push_back(graph_->edges[e]);
+    }
+  }
+
+  struct OrientBody {
+    TriangleCounter *s;
+    bool fill;  // count sizes in the first pass, copy in the second
+    vector<vector<node_t> > links;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      Graph *oriented = &s->oriented_;
+      for (node_t node = begin; node < end; node++) {
+        s->Collect(node, &links[thread]);
+        if (fill)
+          std::copy(links[thread].begin(), links[thread].end(),
+              oriented->edges + oriented->start(node));
+        else
+          oriented->list[node + 1] = links[thread].size();
+      }
+    }
+  };
+
+  void Orient() {
+    oriented_.num_nodes = num_nodes_;
+    oriented_.list = new uint32_t[num_nodes_ + 2];
+    memset(oriented_.list, 0, sizeof(uint32_t) * (num_nodes_ + 2));
+    OrientBody body;
+    body.s = this;
+    body.fill = false;
+    body.links.resize(NumThreads());
+    ParallelFor(1, num_nodes_ + 1, 4096, &body);
+    for (node_t node = 1; node <= num_nodes_; node++)
+      oriented_.list[node + 1] += oriented_.list[node];
+    oriented_.num_edges = oriented_.list[num_nodes_ + 1];
+    oriented_.edges = new node_t[oriented_.num_edges];
+    body.fill = true;
+    ParallelFor(1, num_nodes_ + 1, 4096, &body);
+  }
+
+  struct CountBody {
+    TriangleCounter *s;
+    vector<uint64_t> total;  // per thread
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++)
+        total[thread] += s->CountNode(node);
+    }
+  };
+
+  uint64_t CountNode(node_t v) {
+    Graph *o = &oriented_;
+    node_t *v_begin = o->edges + o->start(v);
+    node_t *v_end = o->edges + o->end(v);
+    uint64_t found = 0;
+    for (node_t *u = v_begin; u < v_end; u++) {
+      uint64_t common = Intersect(v_begin, v_end, o->edges + o->start(*u),
+          o->edges + o->end(*u));
+      if (common) {
+        AtomicAdd<uint64_t>(&triangles_[*u], common);
+        found += common;
+      }
+    }
+    if (found)
+      AtomicAdd<uint64_t>(&triangles_[v], found);
+    return found;
+  }
+
+  // Number of common nodes, each one is a third node of a triangle
+  uint64_t Intersect(node_t *a, node_t *a_end, node_t *b, node_t *b_end) {
+    size_t a_size = a_end - a, b_size = b_end - b;
+    if (a_size > b_size) {
+      std::swap(a, b);
+      std::swap(a_end, b_end);
+      std::swap(a_size, b_size);
+    }
+    uint64_t common = 0;
+    if (a_size * kGallopRatio < b_size) {
+      for ( ; a < a_end && b < b_end; a++) {
+        b = std::lower_bound(b, b_end, *a);
+        if (b < b_end && *b == *a) {
+          AtomicAdd<uint64_t>(&triangles_[*a], 1);
+          common++;
+        }
+      }
+    } else {
+      while (a < a_end && b < b_end) {
+        if (*a < *b) {
+          a++;
+        } else if (*b < *a) {
+          b++;
+        } else {
+          AtomicAdd<uint64_t>(&triangles_[*a], 1);
+          common++;
+          a++;
+          b++;
+        }
+      }
+    }
+    return common;
+  }
+
+  Graph *graph_;
+  uint32_t num_nodes_;
+  uint64_t *triangles_;
+  Graph oriented_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(TriangleCounter);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_TRIANGLES_H_
@@ -0,0 +1,112 @@
+// Copyright 2011 Emir Habul, see file COPYING
+
+#ifndef SRC_WCC_H_
+#define SRC_WCC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace wikigraph {
+
+// Weakly connected components with a concurrent union-find. Edges are
+// processed by all threads at once, roots are linked with compare-and-swap
+// from the larger node to the smaller one, so the root of every set is its
+// smallest node. Paths are shortened (halving) while searching for roots.
+//
+// Component is labeled by its smallest node, invalid nodes are labeled 0.
+class WccSolver {
+ public:
+  WccSolver(Graph *graph, BitArray *invalid_node)
+  : graph_(graph), invalid_node_(invalid_node),
+    num_nodes_(graph->num_nodes) { }
+
+  // labels has num_nodes + 1 elements, it is used as the parent array
+  void Run(uint32_t *labels) {
+    parent_ = labels;
+    for (node_t node = 0; node <= num_nodes_; node++)
+      parent_[node] = node;
+
+    UnionBody unite = { this };
+    ParallelFor(1, num_nodes_ + 1, 4096, &unite);
+    FlattenBody flatten = { this };
+    ParallelFor(1, num_nodes_ + 1, 4096, &flatten);
+
+    parent_[0] = 0;
+    if (invalid_node_) {
+      for (node_t node = 1; node <= num_nodes_; node++) {
+        if (invalid_node_->get_value(node))
+          parent_[node] = 0;
+      }
+    }
+  }
+
+ private:
+  node_t Find(node_t node) {
+    while (1) {
+      node_t parent = AtomicLoad(&parent_[node]);
+      if (parent == node)
+        return node;
+      node_t grandparent = AtomicLoad(&parent_[parent]);
+      if (grandparent != parent)
+        AtomicCas(&parent_[node], parent, grandparent);
+      node = grandparent;
+    }
+  }
+
+  void Union(node_t a, node_t b) {
+    while (1) {
+      a = Find(a);
+      b = Find(b);
+      if (a == b)
+        return;
+      if (a < b)
+        std::swap(a, b);
+      // Fails if a stopped being a root in the meantime
+      if (AtomicCas(&parent_[a], a, b))
+        return;
+    }
+  }
+
+  struct UnionBody {
+    WccSolver *s;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      Graph *graph = s->graph_;
+      for (node_t node = begin; node < end; node++) {
+        if (s->invalid_node_ && s->invalid_node_->get_value(node))
+          continue;
+        node_t *target = &graph->edges[graph->start(node)];
+        node_t *last = &graph->edges[graph->end(node)];
+        for ( ; target < last; target++)
+          s->Union(node, *target);
+      }
+    }
+  };
+  struct FlattenBody {
+    WccSolver *s;
+    void operator()(uint32_t begin, uint32_t end, int thread) {
+      for (node_t node = begin; node < end; node++) {
+        node_t root = s->Find(node);
+        // Other threads may still shorten the path of node
+        node_t parent;
+        while ((parent = AtomicLoad(&s->parent_[node])) != root)
+          AtomicCas(&s->parent_[node], parent, root);
+      }
+    }
+  };
+
+  Graph *graph_;
+  BitArray *invalid_node_;
+  uint32_t num_nodes_;
+  uint32_t *parent_;
+ private:
+  DISALLOW_COPY_AND_ASSIGN(WccSolver);
+};
+
+}  // namespace wikigraph
+
+#endif  // SRC_WCC_H_